@@ -0,0 +1,61 @@
+#pragma once
+#include "LedgerStore.h"
+#include <istream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+class CardAllocator;
+
+// 批量开户导入：流式读取 CSV，每块先多线程校验，再交给存储后端批量写入，
+// 校验下一块与写入上一块同时进行。
+// 列顺序：name,id_card,phone,address,card_number,password,initial_deposit；
+// 首行是表头时跳过，card_number 为空时由服务端分配；字段内不支持换行
+class AccountImporter {
+public:
+    struct Rejected {
+        size_t line;
+        std::string reason;
+    };
+
+    struct Report {
+        size_t total = 0;
+        size_t imported = 0;
+        size_t rejected = 0;
+        std::vector<Rejected> rejects; // 只保留前 maxRejects 条明细
+        double seconds = 0;
+
+        double rowsPerSecond() const { return seconds > 0 ? imported / seconds : 0; }
+        std::string toJson() const;
+    };
+
+    // allocator 可以为空，此时不接受空卡号；threads 为校验线程数
+    AccountImporter(LedgerStore& store, CardAllocator* allocator, size_t chunkRows, int threads);
+
+    Report run(std::istream& in);
+
+    static const size_t maxRejects = 1000;
+
+private:
+    struct Row {
+        size_t line;
+        std::string text;
+        NewAccount account;
+        std::string error; // 非空表示被拒绝
+    };
+
+    LedgerStore& store;
+    CardAllocator* allocator;
+    size_t chunkRows;
+    int threads;
+
+    // 本次导入已出现的卡号和身份证号，用于发现文件内重复
+    std::unordered_set<std::string> seenCards, seenIdCards;
+
+    void validate(Row& row);
+    void validateChunk(std::vector<Row>& rows);
+    void reject(Report& report, const Row& row, const std::string& reason);
+};
+
+// 按 RFC 4180 拆分一行 CSV，支持双引号包裹和 "" 转义
+std::vector<std::string> splitCsvLine(const std::string& line);
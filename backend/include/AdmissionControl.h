@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+
+// 请求优先级：入账 > 认证 > 余额查询 > 流水/收件箱 > 导出导入
+enum RequestClass { ClassPosting = 0, ClassAuth, ClassBalance, ClassHistory, ClassExport, ClassCount };
+
+// 访问存储后端的接口前的自适应并发限制（AIMD）：
+// 耗时没有明显超过基线时每轮加 1，超过基线 tolerance 倍时乘 0.9。
+// 名额按优先级分层：低优先级只能用到上限的一部分，余下的留给入账和认证，后端忙时先挡掉导出和流水查询。
+// 拿不到名额的请求立即拒绝，由路由层回 503；不排队等待，Crow 的中间件和处理函数在 I/O 线程上同步执行，
+// 在这里等会把同一线程上的其他连接（包括 /health 和静态文件）一起卡住
+class AdmissionControl {
+public:
+    struct Options {
+        int minLimit = 1;
+        int maxLimit = 64;
+        int initialLimit = 8;
+        double tolerance = 2.0;
+
+        // 从 BANK_ADMISSION_MIN / BANK_ADMISSION_MAX 读取
+        static Options fromEnv();
+    };
+
+    // 每个优先级的统计，供 /metrics 读取
+    struct ClassStats {
+        std::atomic<uint64_t> completed{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> serviceNanos{0}; // 执行耗时累计
+        std::atomic<double> latencyEwma{0};    // 执行耗时的滑动平均
+    };
+
+    explicit AdmissionControl(const Options& options);
+
+    // 拿到执行名额返回 true；本优先级可用的名额已满时立即返回 false
+    bool acquire(RequestClass cls);
+    // 请求结束时归还名额，service 为执行耗时
+    void release(RequestClass cls, std::chrono::steady_clock::duration service);
+
+    static const char* className(int cls);
+    // 该优先级最多能用到上限的几成
+    static double classShare(int cls);
+
+    double limit() const { return currentLimit.load(); }
+    double baselineSeconds() const { return baseline.load(); }
+    const ClassStats& stats(int cls) const { return classStats[cls]; }
+
+    std::atomic<int> inflight{0};
+
+private:
+    Options options;
+    std::mutex mutex;
+    ClassStats classStats[ClassCount];
+
+    std::atomic<double> currentLimit;
+    std::atomic<double> baseline{0};   // 近期最小耗时，作为无排队时的参考
+    double windowMin = 0;              // 当前窗口内的最小耗时
+    std::chrono::steady_clock::time_point windowStart;
+    std::chrono::steady_clock::time_point lastDecrease;
+};
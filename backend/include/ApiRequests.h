@@ -0,0 +1,205 @@
+#pragma once
+#include "RequestDecoder.h"
+#include "LedgerStore.h"
+#include <string>
+#include <vector>
+
+// 各 POST 接口的请求体及字段表，字段名与前端提交的 JSON 一致；第三个参数为 false 的是可选字段
+
+struct LoginRequest {
+    std::string card_number;
+    std::string password;
+};
+
+template <>
+struct RequestSchema<LoginRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &LoginRequest::card_number),
+            field("password", &LoginRequest::password));
+    }
+};
+
+// 带会话令牌时卡号和旧密码都可以不填
+struct PasswordChangeRequest {
+    std::string card_number;
+    std::string old_password;
+    std::string new_password;
+};
+
+template <>
+struct RequestSchema<PasswordChangeRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &PasswordChangeRequest::card_number, false),
+            field("old_password", &PasswordChangeRequest::old_password, false),
+            field("new_password", &PasswordChangeRequest::new_password));
+    }
+};
+
+struct PasswordResetRequest {
+    std::string card_number;
+    std::string name;
+    std::string phone;
+    std::string new_password;
+};
+
+template <>
+struct RequestSchema<PasswordResetRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &PasswordResetRequest::card_number),
+            field("name", &PasswordResetRequest::name),
+            field("phone", &PasswordResetRequest::phone),
+            field("new_password", &PasswordResetRequest::new_password));
+    }
+};
+
+// 销户验证
+struct AccountCheckRequest {
+    std::string card_number;
+    std::string name;
+    std::string phone;
+};
+
+template <>
+struct RequestSchema<AccountCheckRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &AccountCheckRequest::card_number),
+            field("name", &AccountCheckRequest::name),
+            field("phone", &AccountCheckRequest::phone));
+    }
+};
+
+struct CardRequest {
+    std::string card_number;
+};
+
+template <>
+struct RequestSchema<CardRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(field("card_number", &CardRequest::card_number));
+    }
+};
+
+// 存款、取款共用
+struct AmountRequest {
+    std::string card_number;
+    double amount = 0;
+};
+
+template <>
+struct RequestSchema<AmountRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &AmountRequest::card_number),
+            field("amount", &AmountRequest::amount));
+    }
+};
+
+// 卡号不填时由服务端分配
+struct RegisterRequest {
+    std::string name;
+    std::string id_card;
+    std::string phone;
+    std::string address;
+    std::string card_number;
+    std::string password;
+    double initial_deposit = 0;
+};
+
+template <>
+struct RequestSchema<RegisterRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("name", &RegisterRequest::name),
+            field("id_card", &RegisterRequest::id_card),
+            field("phone", &RegisterRequest::phone),
+            field("address", &RegisterRequest::address),
+            field("card_number", &RegisterRequest::card_number, false),
+            field("password", &RegisterRequest::password),
+            field("initial_deposit", &RegisterRequest::initial_deposit));
+    }
+};
+
+struct UserUpdateRequest {
+    std::string card_number;
+    std::string name;
+    std::string id_card;
+    std::string phone;
+    std::string address;
+};
+
+template <>
+struct RequestSchema<UserUpdateRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &UserUpdateRequest::card_number),
+            field("name", &UserUpdateRequest::name),
+            field("id_card", &UserUpdateRequest::id_card),
+            field("phone", &UserUpdateRequest::phone),
+            field("address", &UserUpdateRequest::address));
+    }
+};
+
+struct TransferRequest {
+    std::string from_card;
+    std::string to_card;
+    double amount = 0;
+    std::string message;
+    bool is_anonymous = false;
+};
+
+template <>
+struct RequestSchema<TransferRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("from_card", &TransferRequest::from_card),
+            field("to_card", &TransferRequest::to_card),
+            field("amount", &TransferRequest::amount),
+            field("message", &TransferRequest::message, false),
+            field("is_anonymous", &TransferRequest::is_anonymous, false));
+    }
+};
+
+// 批量转账的单笔直接解到 TransferLine，缺字段的那笔在入账时判失败，不影响整批解码
+template <>
+struct RequestSchema<TransferLine> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("to_card", &TransferLine::toCard, false),
+            field("amount", &TransferLine::amount, false),
+            field("message", &TransferLine::message, false));
+    }
+};
+
+struct BatchTransferRequest {
+    std::string from_card;
+    bool is_anonymous = false;
+    std::vector<TransferLine> items;
+};
+
+template <>
+struct RequestSchema<BatchTransferRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("from_card", &BatchTransferRequest::from_card),
+            field("is_anonymous", &BatchTransferRequest::is_anonymous, false),
+            field("items", &BatchTransferRequest::items));
+    }
+};
+
+struct MessageReadRequest {
+    std::string card_number;
+    int id = 0;
+};
+
+template <>
+struct RequestSchema<MessageReadRequest> {
+    static constexpr auto fields() {
+        return std::make_tuple(
+            field("card_number", &MessageReadRequest::card_number),
+            field("id", &MessageReadRequest::id));
+    }
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include "crow_all.h"
+#include "LedgerStore.h"
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+// 接口响应：固定不变的响应体启动时序列化一次，所有请求共享同一份，发送时不拷贝；
+// 带变量的响应用 JsonResponse 按字段顺序直接写出 JSON 文本，不经过 crow::json::wvalue。
+// 两者都会带上 Content-Type: application/json。crow_all.h 不能被多个源文件包含，这里全部写在头文件里
+
+class ConstResponse {
+public:
+    ConstResponse(int code, const std::string& body)
+        : code(code), shared(std::make_shared<const std::string>(body)) {}
+
+    crow::response make() const {
+        crow::response response(code);
+        response.set_shared_body(shared);
+        response.add_header("Content-Type", "application/json");
+        return response;
+    }
+
+    const std::string& body() const { return *shared; }
+
+private:
+    int code;
+    std::shared_ptr<const std::string> shared;
+};
+
+// 常用的固定响应，第一次用到时构造
+namespace responses {
+
+#define BANK_CONST_RESPONSE(name, code, body) \
+    inline const ConstResponse& name() {      \
+        static const ConstResponse r(code, body); \
+        return r;                             \
+    }
+
+BANK_CONST_RESPONSE(success, 200, "{\"status\":\"success\"}")
+BANK_CONST_RESPONSE(error, 200, "{\"status\":\"error\"}")
+BANK_CONST_RESPONSE(badParameter, 400, "{\"status\":\"error\",\"message\":\"参数错误\"}")
+BANK_CONST_RESPONSE(queryFailed, 200, "{\"status\":\"error\",\"message\":\"查询失败\"}")
+BANK_CONST_RESPONSE(tooManyRequests, 429, "{\"status\":\"error\",\"message\":\"请求过于频繁，请稍后再试\"}")
+BANK_CONST_RESPONSE(busy, 503, "{\"status\":\"error\",\"message\":\"系统繁忙，请稍后再试\"}")
+BANK_CONST_RESPONSE(sessionExpired, 401, "{\"status\":\"error\",\"message\":\"登录已过期\"}")
+BANK_CONST_RESPONSE(forbidden, 403, "{\"status\":\"error\",\"message\":\"无权限\"}")
+
+#undef BANK_CONST_RESPONSE
+
+}
+
+// 金额字段，以分为单位，输出为两位小数
+struct Money {
+    int64_t cents;
+};
+
+// 已经是合法 JSON 的片段（数组、对象），原样写入
+struct RawJson {
+    const std::string& text;
+};
+
+// 键名只接受字符串字面量，长度在编译期确定；值按类型选择写法，字符串会转义。
+// 拼接过程在请求内存（RequestArena）里完成，make 时一次拷贝成响应体
+class JsonResponse {
+public:
+    explicit JsonResponse(size_t reserve = 128) {
+        out.reserve(reserve);
+        out += '{';
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], const std::string& value) {
+        appendKey(key, N - 1);
+        appendString(value.data(), value.size());
+        return *this;
+    }
+
+    // 没有这个重载时字符串字面量会被当成 bool
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], const char* value) {
+        appendKey(key, N - 1);
+        appendString(value, strlen(value));
+        return *this;
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], Money value) {
+        appendKey(key, N - 1);
+        appendMoney(value.cents);
+        return *this;
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], int64_t value) {
+        appendKey(key, N - 1);
+        appendInteger(value);
+        return *this;
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], int value) {
+        return add(key, (int64_t)value);
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], size_t value) {
+        return add(key, (int64_t)value);
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], bool value) {
+        appendKey(key, N - 1);
+        out.append(value ? "true" : "false");
+        return *this;
+    }
+
+    template <size_t N>
+    JsonResponse& add(const char (&key)[N], RawJson value) {
+        appendKey(key, N - 1);
+        out.append(value.text.data(), value.text.size());
+        return *this;
+    }
+
+    // 收尾并生成响应，之后不能再添加字段
+    crow::response make(int code = 200);
+
+private:
+    ArenaString out;
+
+    void appendKey(const char* key, size_t length) {
+        if (out.size() > 1) out += ',';
+        out += '"';
+        out.append(key, length);
+        out += "\":";
+    }
+
+    void appendString(const char* value, size_t length) {
+        out += '"';
+        appendEscapedJson(out, value, length);
+        out += '"';
+    }
+
+    void appendInteger(int64_t value) {
+        char buf[24];
+        char* p = buf + sizeof(buf);
+        uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+        do {
+            *--p = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+        if (value < 0) *--p = '-';
+        out.append(p, buf + sizeof(buf));
+    }
+
+    void appendMoney(int64_t cents) {
+        uint64_t v = cents < 0 ? 0 - (uint64_t)cents : (uint64_t)cents;
+        if (cents < 0) out += '-';
+        appendInteger((int64_t)(v / 100));
+        out += '.';
+        out += (char)('0' + v % 100 / 10);
+        out += (char)('0' + v % 10);
+    }
+};
+
+// 后端已经拼好的 JSON 文本（用户信息、流水、消息列表等），移入响应并补上 Content-Type
+inline crow::response jsonResponse(std::string body, int code = 200) {
+    crow::response response(code, std::move(body));
+    response.add_header("Content-Type", "application/json");
+    return response;
+}
+
+inline crow::response JsonResponse::make(int code) {
+    out += '}';
+    return jsonResponse(std::string(out.data(), out.size()), code);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "LedgerStore.h"
+#include "ShardedCache.h"
+#include "CardFilter.h"
+#include "WarmCacheFile.h"
+
+// 读穿透缓存层：包在任意存储后端外面，缓存每张卡的资料和余额。
+// 未命中时回源填充，存取款/转账/改资料提交后原地更新，销户时删除。
+// 另有一个带 TTL 的持卡人姓名缓存，供收款人姓名查询和转账时的付款人姓名使用，登录时预热。
+// 可选的卡号过滤器用于直接否定不存在的卡号，不必查库。
+// 缓存内容可以定期连同版本号写进持久化热缓存文件，重启后按版本号核对再用
+class CachedLedger : public LedgerStore {
+public:
+    // capacity 为缓存的最大卡片数，nameTtl 为姓名缓存的有效期
+    CachedLedger(LedgerStore& inner, size_t capacity, std::chrono::seconds nameTtl);
+
+    LedgerStore& backend() { return inner; }
+
+    // 启动时建立卡号过滤器，expected 为预计卡片数，threads 为并行扫描线程数
+    bool enableCardFilter(size_t expected, int threads);
+
+    size_t openWarmCache(const std::string& path) override;
+    bool revalidateWarmCache(int64_t& rows) override;
+    bool saveWarmCache(const std::string& path, int64_t& rows) override;
+
+    void beginHandoff(bool incoming) override;
+    std::string exportWarmState() override;
+    void finishHandoff(const std::string& state, bool complete) override;
+
+    const char* backendName() const override { return inner.backendName(); }
+    bool isConnected() override { return inner.isConnected(); }
+
+    bool verifyLogin(const std::string& cardNumber, const std::string& password) override;
+    std::string getUserInfo(const std::string& cardNumber) override;
+    double getBalance(const std::string& cardNumber) override;
+    bool deposit(const std::string& cardNumber, double amount) override;
+    bool withdraw(const std::string& cardNumber, double amount) override;
+    std::string getTransactionHistory(const std::string& cardNumber) override;
+    std::unique_ptr<TransactionCursor> openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) override;
+    bool isCardNumberExists(const std::string& cardNumber) override;
+    bool createAccount(const std::string& name, const std::string& idCard,
+                       const std::string& phone, const std::string& address,
+                       const std::string& cardNumber, const std::string& password,
+                       double initialDeposit) override;
+    void createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) override;
+
+    std::string getUserName(const std::string& card_number) override;
+    bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) override;
+    void transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) override;
+    std::string getUserMessages(const std::string& card_number) override;
+    bool markMessageRead(const std::string& card_number, int message_id) override;
+    bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) override;
+    bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) override;
+
+    bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) override;
+    bool updatePassword(const std::string& cardNumber, const std::string& newPassword) override;
+
+    bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) override;
+    bool deleteAccount(const std::string& cardNumber) override;
+
+    bool loadAccountProfile(const std::string& cardNumber, AccountProfile& out) override;
+    bool prepareAll() override;
+    bool recentCards(size_t limit, std::vector<std::string>& out) override;
+    bool loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) override;
+    bool loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) override;
+    bool scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) override;
+    bool reserveSequence(const std::string& name, int64_t count, int64_t& first) override;
+    bool scanStatementPartition(int partition, int partitions, const std::string& since,
+                                const std::function<void(const StatementScanRow&)>& fn) override;
+    bool saveStatementSummaries(const std::vector<StatementSummary>& rows) override;
+    bool rollDailyBalances(const std::string& today, int64_t& rows) override;
+    bool balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) override;
+    bool rollupSpending(int64_t& rows) override;
+    bool loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                      std::vector<SpendingBucket>& out) override;
+
+private:
+    LedgerStore& inner;
+    ShardedCache<AccountProfile> accounts;
+    ShardedCache<std::string> names;
+    std::unique_ptr<CardFilter> cardFilter;
+    std::atomic<uint64_t> filterNegatives{0};      // 过滤器直接否定的次数
+    std::atomic<uint64_t> filterFalsePositives{0}; // 过滤器放行但数据库中不存在的次数
+
+    // 热重启接手期间直接访问后端；旧进程没发完新开卡号时过滤器一直不用
+    std::atomic<bool> bypassCache{false};
+    std::atomic<bool> bypassFilter{false};
+    std::mutex handoffMutex;
+    bool trackingCreated = false;
+    std::vector<std::string> createdCards;
+
+    // 启动时映射的热缓存文件，核对完之前未命中的卡先查这里；映射一直保留到退出
+    WarmCacheFile warmFile;
+    std::atomic<bool> warmPending{false};
+    std::atomic<uint64_t> warmHits{0};  // 版本号一致、直接用了文件里的资料
+    std::atomic<uint64_t> warmStale{0}; // 文件里有但已过期
+
+    void recordCreated(const std::string& cardNumber);
+    // 文件里有这张卡且版本号与数据库一致时填入 out
+    bool loadFromWarmFile(const std::string& cardNumber, AccountProfile& out);
+
+    // 过滤器确定卡号不存在时返回 true
+    bool definitelyMissing(const std::string& cardNumber);
+    // 先查缓存再查库，不经过过滤器；调用方已经查过
+    bool cachedProfile(const std::string& cardNumber, AccountProfile& out);
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+class LedgerStore;
+
+// 服务端卡号分配：从后端的 "card" 序列按块预留流水号，块内用原子计数无锁发号。
+// 卡号 = BIN + 补零流水号 + Luhn 校验位，共 16 位。
+// 客户端自选的卡号可能落在同一号段里：发号时已存在的号跳过；发出之后、开户之前被别人抢先用掉的，
+// 开户时由卡号唯一键拒绝，服务端分配的卡号会换一个号重试
+class CardAllocator {
+public:
+    CardAllocator(LedgerStore& store, const std::string& bin, int64_t blockSize);
+
+    // 返回一个尚未开户的卡号，号段用尽或后端出错时返回空串
+    std::string allocate();
+
+    // 计算 digits 末尾应追加的 Luhn 校验位
+    static char luhnDigit(const std::string& digits);
+    static bool luhnValid(const std::string& number);
+    // 卡号格式：16 到 19 位数字。客户端自选的卡号会写进响应头、文件名等处，入库前必须满足
+    static bool wellFormed(const std::string& number);
+
+    std::atomic<uint64_t> allocated{0};
+    std::atomic<uint64_t> blocksReserved{0};
+    std::atomic<uint64_t> skipped{0}; // 与客户端自选卡号冲突而跳过的号
+
+private:
+    struct Block {
+        int64_t end;
+        std::atomic<int64_t> next;
+        Block(int64_t first, int64_t end) : end(end), next(first) {}
+    };
+
+    LedgerStore& store;
+    std::string bin;
+    int64_t blockSize;
+    int64_t maxSerial;
+
+    // 只通过 std::atomic_load/atomic_store 访问；换块后旧块在最后一个读者放手时释放
+    std::shared_ptr<Block> current;
+    std::mutex refillMutex;
+
+    // 当前块仍是 seen 时预留新块；失败返回 false
+    bool refill(const Block* seen);
+    std::string format(int64_t serial) const;
+};
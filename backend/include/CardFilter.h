@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+class LedgerStore;
+
+// 卡号存在性过滤器：4 位计数的 Bloom 过滤器，支持销户时删除。
+// mightContain 返回 false 表示卡号一定不存在，返回 true 才需要查数据库。
+// 前提是所有开户/销户都经过本进程，外部直接写库新增的卡号需要重启重建
+class CardFilter {
+public:
+    // expected 为预计卡片数，按每个卡号约 10 个计数器分配
+    explicit CardFilter(size_t expected);
+
+    // 多线程并行扫描后端全部卡号建立过滤器，失败时过滤器保持不可用
+    bool build(LedgerStore& store, int threads);
+
+    bool ready() const { return built.load(); }
+    bool mightContain(const std::string& cardNumber) const;
+    void add(const std::string& cardNumber);
+    void remove(const std::string& cardNumber);
+
+    size_t keyCount() const { return keys.load(); }
+
+private:
+    static const int kHashes = 7;
+
+    size_t counters;
+    std::unique_ptr<std::atomic<uint64_t>[]> words; // 每个字 16 个 4 位计数器
+    std::atomic<bool> built{false};
+    std::atomic<size_t> keys{0};
+
+    void positions(const std::string& key, size_t out[kHashes]) const;
+    void adjust(size_t pos, int delta);
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// 线程放置：请求处理（I/O）线程数、同时在存储后端里执行的请求数，以及 I/O 线程和后台线程各自用哪些 CPU。
+// I/O 线程按序号各绑一个核（线程比核多时轮流复用）；主线程在创建其他线程之前绑到后台 CPU，
+// 之后的定时任务、预读、写日志等线程都继承这个范围，I/O 线程启动时再改成自己的范围，
+// 不指定 I/O CPU 时恢复成本进程可用的全部 CPU。绑过核的线程内存策略设为本节点优先，
+// 它自己的缓冲区（SQLite 连接的页缓存和语句、请求和响应的缓冲）由它第一次写入，落在所在的 NUMA 节点上
+class CpuPlacement {
+public:
+    struct Options {
+        int ioThreads = 0;          // 0 表示自动：指定了 ioCpus 时每核一个，否则沿用原来的线程数
+        int dbThreads = 0;          // 同时在存储后端里执行的请求数上限，0 表示沿用准入控制的设置
+        std::string ioCpus;         // CPU 列表，如 "0-15,32-47"，也可以写 "node0"；空表示不绑
+        std::string backgroundCpus; // 空时取 ioCpus 以外的可用 CPU，不指定 ioCpus 时不绑
+
+        // 从 BANK_IO_THREADS / BANK_DB_THREADS / BANK_IO_CPUS / BANK_BACKGROUND_CPUS 读取
+        static Options fromEnv();
+    };
+
+    explicit CpuPlacement(const Options& options);
+
+    // 读取 NUMA 拓扑并解析 CPU 列表；列表写错或含本进程不能用的 CPU 时返回 false，原因写进 error
+    bool init(std::string& error);
+    // 多进程时第 index 个工作进程（共 count 个）只用 I/O CPU 中连续的一段，同一进程的线程尽量在同一节点
+    void restrictToWorker(int index, int count);
+
+    // 主线程在创建其他线程之前调用
+    void pinBackground();
+    // I/O 线程启动时调用，index 从 0 开始；不指定 I/O CPU 时撤销从主线程继承的后台 CPU 范围
+    void pinIoThread(int index) const;
+
+    // 实际的 I/O 线程数，fallback 为没有指定时的线程数
+    int ioThreads(int fallback) const;
+    int dbThreads() const { return options.dbThreads; }
+
+    // 启动时打印的拓扑和放置结果，dbLimit 为后端并发上限
+    std::string report(int ioThreadCount, int dbLimit) const;
+
+private:
+    Options options;
+    std::vector<std::vector<int>> nodes; // 各 NUMA 节点的 CPU，读不到时整机算一个节点
+    std::vector<int> allowed;            // 本进程可用的 CPU
+    std::vector<int> io, background;
+
+    bool parseList(const std::string& text, std::vector<int>& out, std::string& error) const;
+    int nodeOf(int cpu) const;
+    // "0-15（node0）, 32-35（node1）"，withNode 为 false 时不标节点
+    std::string describe(const std::vector<int>& cpus, bool withNode = true) const;
+};
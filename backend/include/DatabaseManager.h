@@ -1,4 +1,5 @@
 #pragma once
+#include "LedgerStore.h"
 #include <mysql_driver.h>
 #include <mysql_connection.h>
 #include <cppconn/statement.h>
@@ -9,50 +10,84 @@
 #include <string>
 #include <memory>
 #include <mutex>
+#include <vector>
 
-class DatabaseManager {
+// MySQL 存储后端
+class DatabaseManager : public LedgerStore {
 private:
     sql::mysql::MySQL_Driver* driver;
     std::unique_ptr<sql::Connection> connection;
     std::recursive_mutex db_mutex;
+    // 主连接上预编译好的请求语句，按 DatabaseManager.cpp 里的语句编号存放，换连接时清空
+    std::vector<std::unique_ptr<sql::PreparedStatement>> statements;
 
     DatabaseManager();
     void connect();
+    // 取编号为 id 的请求语句，当前连接上还没准备过时先准备；调用方持有 db_mutex，用完不释放
+    sql::PreparedStatement* statement(int id);
+    // 新建一条独立连接，供并行扫描等不走主连接的场合使用
+    std::unique_ptr<sql::Connection> openConnection();
+    // 在当前事务里用多行 INSERT 写入 rows[begin, end)，出错抛异常
+    void insertAccountChunk(const std::vector<NewAccount>& rows, size_t begin, size_t end);
+    // 在当前事务里处理 lines[begin, end)：付款卡只扣一次，收款卡用一条 UPDATE 入账，流水和消息多行插入
+    void transferChunk(const std::string& from_card, const std::vector<TransferLine>& lines, size_t begin, size_t end,
+                       const std::string& sName, std::vector<bool>& ok);
 
 public:
     static DatabaseManager& getInstance();
 
+    const char* backendName() const override { return "mysql"; }
+
     // 基础功能
-    bool verifyLogin(const std::string& cardNumber, const std::string& password);
-    std::string getUserInfo(const std::string& cardNumber);
-    double getBalance(const std::string& cardNumber);
-    bool deposit(const std::string& cardNumber, double amount);
-    bool withdraw(const std::string& cardNumber, double amount);
-    std::string getTransactionHistory(const std::string& cardNumber);
-    bool isCardNumberExists(const std::string& cardNumber);
+    bool verifyLogin(const std::string& cardNumber, const std::string& password) override;
+    std::string getUserInfo(const std::string& cardNumber) override;
+    double getBalance(const std::string& cardNumber) override;
+    bool deposit(const std::string& cardNumber, double amount) override;
+    bool withdraw(const std::string& cardNumber, double amount) override;
+    std::string getTransactionHistory(const std::string& cardNumber) override;
+    std::unique_ptr<TransactionCursor> openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) override;
+    bool isCardNumberExists(const std::string& cardNumber) override;
     bool createAccount(const std::string& name, const std::string& idCard,
                       const std::string& phone, const std::string& address,
                       const std::string& cardNumber, const std::string& password,
-                      double initialDeposit);
-    bool isConnected();
+                      double initialDeposit) override;
+    void createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) override;
+    bool isConnected() override;
 
     // 进阶功能
-    std::string getUserName(const std::string& card_number);
-    bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous);
-    std::string getUserMessages(const std::string& card_number);
-    bool markMessageRead(int message_id);
-    bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content);
-    bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address);
+    std::string getUserName(const std::string& card_number) override;
+    bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) override;
+    void transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) override;
+    std::string getUserMessages(const std::string& card_number) override;
+    bool markMessageRead(const std::string& card_number, int message_id) override;
+    bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) override;
+    bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) override;
 
     // 密码管理
-    bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone);
-    bool updatePassword(const std::string& cardNumber, const std::string& newPassword);
+    bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) override;
+    bool updatePassword(const std::string& cardNumber, const std::string& newPassword) override;
 
     // === 新增：注销功能 ===
     // 验证销户信息并返回余额
-    bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance);
+    bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) override;
     // 执行彻底删除
-    bool deleteAccount(const std::string& cardNumber);
+    bool deleteAccount(const std::string& cardNumber) override;
+
+    bool loadAccountProfile(const std::string& cardNumber, AccountProfile& out) override;
+    bool prepareAll() override;
+    bool recentCards(size_t limit, std::vector<std::string>& out) override;
+    bool loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) override;
+    bool loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) override;
+    bool scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) override;
+    bool reserveSequence(const std::string& name, int64_t count, int64_t& first) override;
+    bool scanStatementPartition(int partition, int partitions, const std::string& since,
+                                const std::function<void(const StatementScanRow&)>& fn) override;
+    bool saveStatementSummaries(const std::vector<StatementSummary>& rows) override;
+    bool rollDailyBalances(const std::string& today, int64_t& rows) override;
+    bool balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) override;
+    bool rollupSpending(int64_t& rows) override;
+    bool loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                      std::vector<SpendingBucket>& out) override;
 
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
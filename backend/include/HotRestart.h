@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <cstddef>
+
+// 热重启：运行中的进程在 Unix 域套接字上等待接手的新进程，用 SCM_RIGHTS 把监听套接字交给它，端口始终有人在听。
+//   1. 新进程连上来，拿到监听套接字后照常初始化，旧进程继续 accept；
+//   2. 新进程准备好后通知旧进程，旧进程停止 accept，把会话表发过去，新进程导入后开始 accept；
+//   3. 旧进程把已有连接上的请求处理完（最多等 drainTimeoutSec 秒）后，发出期间的会话变化和缓存热点卡号，然后退出。
+// 交接完成后新进程在同一路径上等待下一次热重启。控制套接字只允许同一用户连接
+class HotRestart {
+public:
+    struct Options {
+        std::string socketPath = "bank_server.sock";
+        int drainTimeoutSec = 30;
+
+        // 从 BANK_HANDOFF_SOCKET / BANK_DRAIN_TIMEOUT 读取
+        static Options fromEnv();
+    };
+
+    // 旧进程交接时用到的操作
+    struct Hooks {
+        std::function<void()> begin;                   // 收到接手请求时调用，开始记录交接期间的变化
+        std::function<int()> listenHandle;             // 监听套接字，还没开始监听时返回 -1
+        std::function<void()> stopAccepting;
+        std::function<size_t()> connections;           // 尚未关闭的连接数
+        std::function<std::string(bool)> exportState;  // 参数为 false 时只要会话表，true 时为退出前的全部状态
+        std::function<void()> stop;                    // 停止服务，main 随后返回
+    };
+
+    explicit HotRestart(const Options& options);
+    ~HotRestart();
+
+    // 新进程：向旧进程要监听套接字，失败返回 -1
+    int takeover();
+    // 新进程开始 accept 前调用：旧进程停止 accept 并发来会话表，失败返回 false
+    bool ready(std::string& state);
+    // 新进程开始服务后在后台等旧进程退出，收到最后一份状态时调用 onFinal（没收到时 complete 为 false），
+    // 之后按 hooks 等待下一次热重启
+    void finish(const Hooks& hooks, std::function<void(const std::string& state, bool complete)> onFinal);
+
+    // 在控制套接字上等待接手的新进程；同一路径上已有进程在等时返回 false
+    bool listen(const Hooks& hooks);
+    // 停止等待并回收后台线程，main 返回前调用
+    void shutdown();
+
+private:
+    Options options;
+    Hooks hooks;
+    int peer = -1;      // 新进程：连向旧进程的连接
+    int listener = -1;  // 旧进程：控制套接字
+    bool handedOver = false;
+    std::atomic<bool> closing{false};
+    std::thread worker;
+
+    // 建立控制套接字，路径已被别的进程占用时返回 false
+    bool bindListener();
+    void serve();
+    // 处理一个接手请求；返回 true 表示已交出，本进程随后退出
+    bool handOver(int conn);
+};
@@ -0,0 +1,250 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include "RequestArena.h"
+
+// 卡片与持卡人资料（不含密码），供缓存层按结构保存
+struct AccountProfile {
+    std::string name, idCard, phone, address;
+    std::string createTime;
+    int64_t balanceCents = 0;
+};
+
+// 卡片行的 card_id 和版本号：余额或持卡人资料每改一次版本号加一；
+// 销户后重开的同号卡 card_id 不同，两者都一致才说明资料没变
+struct CardVersion {
+    std::string cardNumber;
+    int64_t cardId = 0;
+    int64_t version = 0;
+};
+
+// 同一次读取得到的卡片资料及其版本
+struct VersionedProfile {
+    CardVersion row;
+    AccountProfile profile;
+};
+
+// 批量开户的一行
+struct NewAccount {
+    std::string name, idCard, phone, address;
+    std::string cardNumber, password;
+    double initialDeposit = 0;
+};
+
+// 批量转账的一行
+struct TransferLine {
+    std::string toCard;
+    double amount = 0;
+    std::string message;
+};
+
+// 导出用的一条流水，金额以“分”为单位
+struct TransactionRow {
+    std::string type;
+    int64_t amountCents = 0;
+    int64_t balanceAfterCents = 0;
+    std::string description;
+    std::string createTime;
+};
+
+// 按时间顺序逐行读取流水的只进游标，读完或出错时 next 返回 false
+class TransactionCursor {
+public:
+    virtual ~TransactionCursor() = default;
+    virtual bool next(TransactionRow& row) = 0;
+};
+
+// 对账单扫描的一行：卡片当前余额，以及该卡自 since 起的一条流水（按卡、时间排序）；
+// 这段时间没有流水的卡也会出现一次，hasTransaction 为 false
+struct StatementScanRow {
+    std::string cardNumber;
+    int64_t balanceCents = 0;
+    bool hasTransaction = false;
+    TransactionRow txn;
+};
+
+// 一张卡一个月的对账单汇总
+struct StatementSummary {
+    std::string cardNumber;
+    std::string period; // YYYY-MM
+    int64_t openingCents = 0;
+    int64_t closingCents = 0;
+    int64_t creditCents = 0; // 开户、存入
+    int64_t debitCents = 0;  // 取出、销户
+    int64_t count = 0;
+};
+
+// 消费统计的类别：转账在流水里记为 withdraw/deposit，靠摘要区分
+enum SpendingCategory { SpendDeposit = 0, SpendWithdraw, SpendTransferIn, SpendTransferOut, SpendCategoryCount };
+
+// 一张卡一个统计周期（日或月）内各类别的金额和笔数
+struct SpendingBucket {
+    std::string period; // YYYY-MM-DD 或 YYYY-MM
+    int64_t cents[SpendCategoryCount] = {0, 0, 0, 0};
+    int64_t count[SpendCategoryCount] = {0, 0, 0, 0};
+};
+
+// 账本存储接口：路由层只依赖这里的操作，具体存储后端在启动时选择
+class LedgerStore {
+public:
+    virtual ~LedgerStore() = default;
+
+    // 启动时选择存储后端（如 "mysql"），未编译进来的后端返回 false。
+    // 多个进程共用同一个数据库时 localCache 传 false，不套进程内的卡片缓存和卡号过滤器，避免读到别的进程改过的旧值
+    static bool select(const std::string& backend, bool localCache = true);
+    static LedgerStore& getInstance();
+    static std::vector<std::string> availableBackends();
+
+    virtual const char* backendName() const = 0;
+    virtual bool isConnected() = 0;
+
+    // 基础功能
+    virtual bool verifyLogin(const std::string& cardNumber, const std::string& password) = 0;
+    virtual std::string getUserInfo(const std::string& cardNumber) = 0;
+    virtual double getBalance(const std::string& cardNumber) = 0;
+    virtual bool deposit(const std::string& cardNumber, double amount) = 0;
+    virtual bool withdraw(const std::string& cardNumber, double amount) = 0;
+    virtual std::string getTransactionHistory(const std::string& cardNumber) = 0;
+    // 打开全量流水游标，from/to 为 "YYYY-MM-DD HH:MM:SS" 格式的闭区间，空串表示不限；出错返回空指针
+    virtual std::unique_ptr<TransactionCursor> openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) = 0;
+    virtual bool isCardNumberExists(const std::string& cardNumber) = 0;
+    virtual bool createAccount(const std::string& name, const std::string& idCard,
+                               const std::string& phone, const std::string& address,
+                               const std::string& cardNumber, const std::string& password,
+                               double initialDeposit) = 0;
+
+    // 批量开户，created[i] 表示第 i 行是否成功。默认逐行调用 createAccount，
+    // 后端可以改写为多行 INSERT 的分块事务
+    virtual void createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created);
+
+    // 进阶功能
+    virtual std::string getUserName(const std::string& card_number) = 0;
+    virtual bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) = 0;
+    // 同一付款卡向多个收款人转账（代发工资），ok[i] 表示第 i 行是否成功；
+    // 余额不够时靠后的行失败。默认逐行调用 transfer
+    virtual void transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok);
+    virtual std::string getUserMessages(const std::string& card_number) = 0;
+    // 只标记发给 card_number 的消息
+    virtual bool markMessageRead(const std::string& card_number, int message_id) = 0;
+    virtual bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) = 0;
+    virtual bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) = 0;
+
+    // 密码管理
+    virtual bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) = 0;
+    virtual bool updatePassword(const std::string& cardNumber, const std::string& newPassword) = 0;
+
+    // 销户
+    virtual bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) = 0;
+    virtual bool deleteAccount(const std::string& cardNumber) = 0;
+
+    // 读取卡片资料，卡号不存在或出错返回 false
+    virtual bool loadAccountProfile(const std::string& cardNumber, AccountProfile& out) = 0;
+
+    // 按 card_id 取模分片遍历全部卡号（第 partition 片，共 partitions 片），出错返回 false。
+    // 不同分片可以由不同线程同时调用
+    virtual bool scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) = 0;
+
+    // 从持久化序列 name 中一次预留 count 个号，first 返回第一个（序列从 1 开始），出错返回 false
+    virtual bool reserveSequence(const std::string& name, int64_t count, int64_t& first) = 0;
+
+    // 对账单批处理：按 card_id 取模扫描一个分片，不同分片可以由不同线程同时调用，出错返回 false
+    virtual bool scanStatementPartition(int partition, int partitions, const std::string& since,
+                                        const std::function<void(const StatementScanRow&)>& fn) = 0;
+    // 写入（覆盖）对账单汇总表；memory 后端没有汇总表，什么都不做，只靠对账单文件
+    virtual bool saveStatementSummaries(const std::vector<StatementSummary>&) { return true; }
+
+    // 把 today 之前尚未做过的日子做成日终余额快照，只给当天有流水的卡写一行，rows 返回写入行数；
+    // memory 后端的流水本身按时间排好在内存里，什么都不做
+    virtual bool rollDailyBalances(const std::string& /*today*/, int64_t& rows) { rows = 0; return true; }
+    // 查询 asOf 时刻（YYYY-MM-DD HH:MM:SS）的余额：最近一个日终快照加上之后的流水，卡号不存在或出错返回 false
+    virtual bool balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) = 0;
+
+    // 把上次之后新增的流水累加进日、月两级消费统计表，rows 返回处理的流水条数；
+    // memory 后端在入账时直接累加，什么都不做
+    virtual bool rollupSpending(int64_t& rows) { rows = 0; return true; }
+    // 读取 [from, to] 内的消费统计（monthly 为 true 时按月，否则按日），只返回有流水的周期，
+    // 按周期升序；卡号不存在或出错返回 false
+    virtual bool loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                              std::vector<SpendingBucket>& out) = 0;
+
+    // 启动预热：建好（调用线程的）连接，把各接口用到的语句预编译好留在连接上，请求直接复用；
+    // 表结构与语句不匹配时在这里报出。出错返回 false
+    virtual bool prepareAll() { return true; }
+    // 最近有流水的卡号，按最近一笔流水从新到旧，最多 limit 个；不支持或出错返回 false
+    virtual bool recentCards(size_t, std::vector<std::string>&) { return false; }
+    // 用 threads 个线程并行读取这些卡的资料和姓名：有缓存层时填进缓存，没有时也能把数据库的缓冲池热起来
+    void preload(const std::vector<std::string>& cards, int threads);
+
+    // 批量读取卡片资料连同 card_id 和版本号，不存在的卡跳过；不支持或出错返回 false
+    virtual bool loadVersionedProfiles(const std::vector<std::string>&, std::vector<VersionedProfile>&) { return false; }
+    // 批量读取卡片当前的 card_id 和版本号，不存在的卡跳过；不支持或出错返回 false
+    virtual bool loadCardVersions(const std::vector<std::string>&, std::vector<CardVersion>&) { return false; }
+
+    // 持久化热缓存（见 WarmCacheFile），只有缓存层实现，其他后端什么都不做。
+    // 启动时映射上次写下的文件，返回其中的卡数；之后未命中的卡先按版本号核对文件里的资料
+    virtual size_t openWarmCache(const std::string&) { return 0; }
+    // 批量核对文件里的卡，版本号一致的放进缓存，rows 返回放入的张数；核对完后不再查文件
+    virtual bool revalidateWarmCache(int64_t& rows) { rows = 0; return true; }
+    // 把缓存中的卡连同版本号重新读一遍写入 path，rows 返回写入的张数
+    virtual bool saveWarmCache(const std::string&, int64_t& rows) { rows = 0; return true; }
+
+    // 热重启交接（见 HotRestart），只有缓存层需要处理，其他后端什么都不做。
+    // incoming 为 true 表示本进程是接手的新进程：交接完成前旧进程仍在写库，不用缓存和卡号过滤器；
+    // 否则是被替换的旧进程，开始记录交接期间新开的卡号
+    virtual void beginHandoff(bool) {}
+    // 旧进程退出前导出缓存中的热点卡号（"H 卡号"）和交接期间新开的卡号（"N 卡号"），每行一条
+    virtual std::string exportWarmState() { return ""; }
+    // 新进程收到旧进程的导出内容后恢复缓存；complete 为 false 表示旧进程没有发完
+    virtual void finishHandoff(const std::string&, bool) {}
+
+    // 转账时查询付款人姓名的入口，缓存层可以换成带缓存的查询
+    void setNameLookup(std::function<std::string(const std::string&)> lookup) { nameLookup = std::move(lookup); }
+
+protected:
+    std::string lookupUserName(const std::string& card_number) {
+        return nameLookup ? nameLookup(card_number) : getUserName(card_number);
+    }
+
+private:
+    static LedgerStore* active;
+    std::function<std::string(const std::string&)> nameLookup;
+};
+
+// 各后端共用的 JSON 字符串转义，保证输出格式一致
+std::string escapeJson(const std::string& s);
+// 转义后直接追加到 out，省掉中间字符串
+void appendEscapedJson(std::string& out, const char* s, size_t length);
+// 后端拼 JSON 列表时先写进请求内存（见 RequestArena.h），拼完一次拷贝成准确大小的结果
+void appendEscapedJson(ArenaString& out, const char* s, size_t length);
+inline void appendEscapedJson(ArenaString& out, const std::string& s) { appendEscapedJson(out, s.data(), s.size()); }
+inline void appendText(ArenaString& out, const std::string& s) { out.append(s.data(), s.size()); }
+// 按 printf 格式追加一个数：std::fixed << setprecision(2) 对应 "%.2f"，默认的 << 对应 "%g"
+template <typename T>
+void appendNumber(ArenaString& out, const char* format, T value) {
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), format, value);
+    if (n > 0) out.append(buf, std::min((size_t)n, sizeof(buf) - 1));
+}
+// 与 getUserInfo 相同格式的成功响应
+std::string formatUserInfo(const std::string& cardNumber, const AccountProfile& profile);
+
+// 按流水类型和摘要归类，未知类型按收入/支出方向归入存取款
+SpendingCategory spendingCategory(const std::string& type, const std::string& description);
+// 类别在统计表里的名字：deposit、withdraw、transfer_in、transfer_out；未知名字反查返回 -1
+const char* spendingCategoryName(int category);
+int spendingCategoryFromName(const std::string& name);
+
+// 金额与“分”互转，对应 DECIMAL(15,2) 的四舍五入
+inline int64_t toCents(double amount) {
+    return (int64_t)std::llround(amount * 100.0);
+}
+
+inline double fromCents(int64_t cents) {
+    return cents / 100.0;
+}
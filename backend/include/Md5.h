@@ -0,0 +1,5 @@
+#pragma once
+#include <string>
+
+// 与 MySQL MD5() 一致的小写十六进制摘要，供非 MySQL 后端保存密码哈希
+std::string md5Hex(const std::string& input);
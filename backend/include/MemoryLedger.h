@@ -0,0 +1,164 @@
+#pragma once
+#include "LedgerStore.h"
+#include "WriteAheadLog.h"
+#include <unordered_map>
+#include <deque>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+
+// 进程内账本引擎：卡号哈希表 + 每卡只追加的流水 + 收件箱，
+// 所有修改先写 WAL（组提交）再返回，定期做快照，启动时从快照和 WAL 恢复
+class MemoryLedger : public LedgerStore {
+public:
+    struct Options {
+        std::string dataDir = "data";
+        int snapshotIntervalSec = 300;         // 距上次快照超过该秒数则做快照
+        uint64_t snapshotEveryRecords = 100000; // 或 WAL 记录数超过该值
+
+        // 从 BANK_DATA_DIR / BANK_SNAPSHOT_INTERVAL / BANK_SNAPSHOT_RECORDS 读取
+        static Options fromEnv();
+    };
+
+    // mirror 非空时，每个成功的修改会异步重放到该后端（用于报表）
+    MemoryLedger(const Options& options, LedgerStore* mirror);
+    ~MemoryLedger();
+
+    // 加载快照、重放 WAL 并启动后台线程
+    bool open();
+    // 立即做一次快照并清理旧日志段
+    bool takeSnapshot();
+
+    const char* backendName() const override { return mirror ? "memory-mirror" : "memory"; }
+    bool isConnected() override { return opened; }
+
+    bool verifyLogin(const std::string& cardNumber, const std::string& password) override;
+    std::string getUserInfo(const std::string& cardNumber) override;
+    double getBalance(const std::string& cardNumber) override;
+    bool deposit(const std::string& cardNumber, double amount) override;
+    bool withdraw(const std::string& cardNumber, double amount) override;
+    std::string getTransactionHistory(const std::string& cardNumber) override;
+    std::unique_ptr<TransactionCursor> openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) override;
+    bool isCardNumberExists(const std::string& cardNumber) override;
+    bool createAccount(const std::string& name, const std::string& idCard,
+                       const std::string& phone, const std::string& address,
+                       const std::string& cardNumber, const std::string& password,
+                       double initialDeposit) override;
+    void createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) override;
+
+    std::string getUserName(const std::string& card_number) override;
+    bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) override;
+    void transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) override;
+    std::string getUserMessages(const std::string& card_number) override;
+    bool markMessageRead(const std::string& card_number, int message_id) override;
+    bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) override;
+    bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) override;
+
+    bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) override;
+    bool updatePassword(const std::string& cardNumber, const std::string& newPassword) override;
+
+    bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) override;
+    bool deleteAccount(const std::string& cardNumber) override;
+
+    bool loadAccountProfile(const std::string& cardNumber, AccountProfile& out) override;
+    bool scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) override;
+    bool reserveSequence(const std::string& name, int64_t count, int64_t& first) override;
+    bool scanStatementPartition(int partition, int partitions, const std::string& since,
+                                const std::function<void(const StatementScanRow&)>& fn) override;
+    bool balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) override;
+    bool loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                      std::vector<SpendingBucket>& out) override;
+
+    MemoryLedger(const MemoryLedger&) = delete;
+    MemoryLedger& operator=(const MemoryLedger&) = delete;
+
+private:
+    // 金额统一以“分”为单位保存，对应 MySQL 的 DECIMAL(15,2)
+    struct Transaction {
+        std::string type;
+        int64_t amount;
+        int64_t balanceAfter;
+        std::string description;
+        std::string createTime;
+    };
+
+    struct Message {
+        int id;
+        std::string senderName;
+        std::string type;
+        int64_t amount;
+        std::string content;
+        bool isRead;
+        std::string createTime;
+    };
+
+    struct Account {
+        int cardId;
+        std::string name, idCard, phone, address;
+        std::string passwordHash;
+        int64_t balance;
+        std::string status;
+        std::string createTime;
+        std::vector<Transaction> history;
+        // 消费统计随流水一起累加，按 YYYY-MM-DD / YYYY-MM 排序；由流水推出，不写入快照
+        std::map<std::string, SpendingBucket> dailySpending, monthlySpending;
+    };
+
+    // 分批在共享锁下读取某张卡的流水，不会长时间占着锁
+    class HistoryCursor;
+
+    enum class Op : uint8_t {
+        Create = 1, Deposit, Withdraw, Transfer, SystemMessage, MarkRead, UpdateUser, Password, Delete, Sequence
+    };
+
+    // 一条逻辑重做记录，不同操作只用到其中部分字段
+    struct Record {
+        Op op;
+        std::string card, otherCard;
+        std::string name, idCard, phone, address;
+        std::string text, passwordHash, time;
+        int64_t cents = 0;
+        int64_t id = 0;
+    };
+
+    Options options;
+    LedgerStore* mirror;
+    bool opened = false;
+
+    mutable std::shared_timed_mutex stateMutex;
+    std::unordered_map<std::string, Account> accounts;
+    std::unordered_map<std::string, std::string> idCardOwner;            // 身份证号唯一，对应 users.id_card UNIQUE
+    std::unordered_map<std::string, std::vector<Message>> inboxes;       // 按收件卡号
+    std::unordered_map<int, std::string> messageOwner;
+    std::unordered_map<std::string, int64_t> sequences;                  // 序列名 -> 下一个可用值
+    int nextCardId = 1;
+    int nextMessageId = 1;
+
+    std::unique_ptr<WriteAheadLog> wal;
+    uint64_t snapshotLsn = 0;
+    std::atomic<uint64_t> recordsSinceSnapshot{0};
+
+    std::mutex snapshotMutex;
+    std::mutex backgroundMutex;
+    std::condition_variable backgroundCv;
+    std::atomic<bool> stopping{false};
+    std::thread snapshotThread;
+
+    std::mutex mirrorMutex;
+    std::condition_variable mirrorCv;
+    std::deque<std::function<bool(LedgerStore&)>> mirrorQueue;
+    std::thread mirrorThread;
+
+    // 在持有写锁时应用并记日志，释放锁后等待组提交落盘
+    void submit(std::unique_lock<std::shared_timed_mutex>& lock, const Record& r, std::function<bool(LedgerStore&)> mirrorOp);
+    // 应用、写日志并把镜像操作入队（调用方持有写锁），返回日志 LSN
+    uint64_t record(const Record& r, std::function<bool(LedgerStore&)> mirrorOp);
+    void apply(const Record& r);
+    // 追加一条流水并累加消费统计
+    static void appendHistory(Account& a, Transaction t);
+
+    bool loadSnapshot();
+    std::string serializeState(uint64_t lsn) const;
+    void snapshotLoop();
+    void mirrorLoop();
+};
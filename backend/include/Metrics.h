@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+
+// 进程内指标登记表：各组件登记读取函数，/metrics 按 Prometheus 文本格式输出
+class Metrics {
+public:
+    static Metrics& getInstance();
+
+    // name 可带标签，如 bank_cache_hits_total{cache="account"}；type 为 counter 或 gauge
+    void add(const std::string& name, const std::string& help, const std::string& type, std::function<double()> read);
+    std::string render();
+
+    // 合并多个进程各自输出的文本：第 i 份的样本加上 label="i" 标签，同名指标归到一起只保留一份 HELP/TYPE
+    static std::string merge(const std::vector<std::string>& texts, const std::string& label);
+
+private:
+    struct Entry {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::function<double()> read;
+    };
+    std::mutex mutex;
+    std::vector<Entry> entries;
+
+    Metrics() = default;
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+
+// 后台线程：启动时先跑一次，之后每隔 intervalSec 秒跑一次 step（日终余额快照、消费统计追尾等）。
+// step 返回是否成功，rows 为本次处理的行数
+class PeriodicJob {
+public:
+    PeriodicJob(std::function<bool(int64_t& rows)> step, int intervalSec);
+    ~PeriodicJob();
+
+    void start();
+    void stop();
+
+    std::atomic<uint64_t> rowsWritten{0};
+    std::atomic<uint64_t> failures{0};
+
+private:
+    std::function<bool(int64_t&)> step;
+    int intervalSec;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread worker;
+
+    void loop();
+};
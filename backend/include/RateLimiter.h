@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// 按键（客户端 IP、卡号）限流的令牌桶表，无锁：固定大小的开放寻址表，
+// 每个桶的令牌数和上次补充时间打包在一个 64 位原子量里，用 CAS 更新。
+// 回满的桶由 sweep 定期清掉腾出位置；表满时放行并计数，不阻塞请求
+class RateLimiter {
+public:
+    // slots 向上取 2 的幂；burst 为桶容量，perSecond 为每秒补充的令牌数
+    RateLimiter(size_t slots, double burst, double perSecond);
+
+    // 取一个令牌：成功返回 0，否则返回建议的重试等待秒数（至少 1）
+    int acquire(const std::string& key);
+
+    // 清掉已经回满的桶，返回清理个数
+    int64_t sweep();
+
+    std::atomic<uint64_t> allowed{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> overflow{0}; // 探测范围内没有空位而放行的次数
+    std::atomic<int64_t> keys{0};
+
+private:
+    static const int kProbe = 8;
+    static const uint64_t kScale = 256; // 令牌以 1/256 为单位保存
+
+    struct Slot {
+        std::atomic<uint64_t> key{0};   // 键的哈希，0 表示空位
+        std::atomic<uint64_t> state{0}; // 高 40 位为毫秒时间，低 24 位为令牌数；0 表示满桶
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    uint64_t capacity;   // 以 1/256 令牌计
+    double refillPerMs;  // 以 1/256 令牌计
+    std::chrono::steady_clock::time_point start;
+
+    uint64_t nowMs() const;
+    // 按经过的时间补充后的令牌数
+    uint64_t refill(uint64_t state, uint64_t now) const;
+    int take(Slot& slot);
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 请求内的临时内存：每个请求处理线程一份，按顺序往后分配，请求结束时整体复位，不逐个释放。
+// 响应 JSON、请求体解码和后端拼列表用的中间字符串从这里分配（见 ArenaString），
+// 请求之外或本请求用量超过上限时退回普通堆分配。内存块在线程内留着给下一个请求用，
+// 只有单个请求用得特别多时多出来的块才在复位时还回去。
+// 这里分出去的内存不能活过请求本身：请求结束后同一块会被下一个请求覆盖
+class RequestArena {
+public:
+    static const size_t kBlockBytes = 64 * 1024;
+    // 每个线程复位后保留的内存
+    static const size_t kKeepBytes = 256 * 1024;
+
+    // 当前线程的实例
+    static RequestArena& local();
+
+    // 单个请求最多从这里分配多少字节，超过的部分走堆；0 表示不用，全部走堆。启动时设置一次
+    static void setLimit(size_t bytes);
+
+    // 请求开始、结束时调用（见 main.cpp 的 RequestArenaMiddleware）；上一个请求没有 end 时 begin 会先复位
+    void begin();
+    void end();
+
+    void* allocate(size_t bytes, size_t align);
+    // 本请求内分配的不用释放，最后一次分配的会退回去给下次用；堆上的直接释放
+    void deallocate(void* p, size_t bytes);
+
+    ~RequestArena();
+
+    // 所有线程累计，请求结束时汇总进来
+    static std::atomic<uint64_t> requests;
+    static std::atomic<uint64_t> arenaBytes;        // 从 arena 分配的字节数
+    static std::atomic<uint64_t> heapFallbacks;     // 请求内因超过上限改走堆的次数
+    static std::atomic<uint64_t> heapFallbackBytes;
+    static std::atomic<uint64_t> peakBytes;         // 单个请求用量的最大值
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;     // 正在用的块
+    size_t used = 0;        // 当前块已用字节
+    char* last = nullptr;   // 最后一次分配的起点
+    bool inRequest = false;
+    // 本请求的统计，end 时汇总
+    uint64_t bytes = 0, fallbacks = 0, fallbackBytes = 0;
+
+    bool owns(const void* p) const;
+    void* allocateSlow(size_t bytes, size_t align);
+};
+
+// 从当前线程的 RequestArena 分配的 STL 分配器，无状态，所有实例可以互相释放
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator() = default;
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(RequestArena::local().allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        RequestArena::local().deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>&) const { return false; }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
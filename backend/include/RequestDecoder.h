@@ -0,0 +1,182 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <initializer_list>
+#include <cstdint>
+#include <cstring>
+#include "RequestArena.h"
+
+// 请求体解码：每种请求是一个普通结构体，特化 RequestSchema<T> 给出编译期字段表，
+// 解码时单遍扫描 JSON 文本，键名按字段表匹配后直接写进对应成员，不建中间 DOM。
+// 未知字段跳过；格式错误、类型不符或缺少必填字段时返回 false 并给出错误说明
+
+// 扫描器只负责词法，字段匹配在下面的模板里完成
+class JsonScanner {
+public:
+    explicit JsonScanner(const std::string& text);
+
+    // 跳过空白后若下一个字符是 c 则吃掉并返回 true
+    bool consume(char c);
+    bool atEnd();
+
+    // 不含转义时整段一次拷贝，否则先解码到请求内存再拷贝成准确大小
+    bool readString(std::string& out);
+    // 键名不含转义时直接指向原文，否则解码到内部缓冲区（请求内存）
+    bool readKey(const char*& key, size_t& length);
+    bool readNumber(double& out);
+    bool readInteger(int64_t& out);
+    bool readBool(bool& out);
+    // 跳过一个任意类型的值（未知字段）
+    bool skipValue();
+
+    // 记下第一条错误，始终返回 false
+    bool fail(const std::string& message);
+    bool typeError(const char* field);
+    const std::string& error() const { return message; }
+
+private:
+    const char* p;
+    const char* end;
+    ArenaString keyBuffer;
+    std::string message;
+    int depth = 0;
+
+    void skipSpace();
+    // 从 p 解码到结束引号（含）为止，追加到 out
+    template <typename S>
+    bool unescape(S& out);
+    // 扫描一个 JSON 数字，返回是否含小数或指数
+    bool scanNumber(const char*& begin, bool& fractional);
+};
+
+template <typename T, typename M>
+struct FieldSpec {
+    const char* name;
+    size_t length;
+    M T::* member;
+    bool required;
+};
+
+template <typename T, typename M, size_t N>
+constexpr FieldSpec<T, M> field(const char (&name)[N], M T::* member, bool required = true) {
+    return FieldSpec<T, M>{name, N - 1, member, required};
+}
+
+// 每种请求结构体特化，提供 static constexpr auto fields()
+template <typename T>
+struct RequestSchema;
+
+inline bool decodeValue(JsonScanner& in, std::string& out, const char* name) {
+    return in.readString(out) || in.typeError(name);
+}
+
+inline bool decodeValue(JsonScanner& in, double& out, const char* name) {
+    return in.readNumber(out) || in.typeError(name);
+}
+
+inline bool decodeValue(JsonScanner& in, int64_t& out, const char* name) {
+    return in.readInteger(out) || in.typeError(name);
+}
+
+inline bool decodeValue(JsonScanner& in, int& out, const char* name) {
+    int64_t v = 0;
+    if (!in.readInteger(v) || v < INT32_MIN || v > INT32_MAX) return in.typeError(name);
+    out = (int)v;
+    return true;
+}
+
+inline bool decodeValue(JsonScanner& in, bool& out, const char* name) {
+    return in.readBool(out) || in.typeError(name);
+}
+
+template <typename T>
+bool decodeObject(JsonScanner& in, T& out);
+
+template <typename T>
+bool decodeValue(JsonScanner& in, T& out, const char* name) {
+    (void)name;
+    return decodeObject(in, out);
+}
+
+template <typename E>
+bool decodeValue(JsonScanner& in, std::vector<E>& out, const char* name) {
+    if (!in.consume('[')) return in.typeError(name);
+    out.clear();
+    if (in.consume(']')) return true;
+    do {
+        out.emplace_back();
+        if (!decodeValue(in, out.back(), name)) return false;
+    } while (in.consume(','));
+    return in.consume(']') || in.fail("JSON 格式错误");
+}
+
+namespace request_detail {
+
+// 键名匹配上返回 1，没匹配返回 0，值解码失败返回 -1
+template <typename T, typename M>
+int matchField(JsonScanner& in, T& out, const FieldSpec<T, M>& f, size_t index,
+               const char* key, size_t length, uint64_t& seen) {
+    if (f.length != length || memcmp(f.name, key, length) != 0) return 0;
+    if (!decodeValue(in, out.*f.member, f.name)) return -1;
+    seen |= 1ull << index;
+    return 1;
+}
+
+template <typename T, typename Fields, size_t... I>
+int matchAny(JsonScanner& in, T& out, const Fields& fields, const char* key, size_t length,
+             uint64_t& seen, std::index_sequence<I...>) {
+    int result = 0;
+    (void)std::initializer_list<int>{
+        (result == 0 ? (result = matchField(in, out, std::get<I>(fields), I, key, length, seen)) : 0)...};
+    return result;
+}
+
+template <typename T, typename M>
+bool checkRequired(JsonScanner& in, const FieldSpec<T, M>& f, size_t index, uint64_t seen) {
+    if (!f.required || (seen & (1ull << index))) return true;
+    return in.fail(std::string("缺少字段 ") + f.name);
+}
+
+template <typename Fields, size_t... I>
+bool checkAll(JsonScanner& in, const Fields& fields, uint64_t seen, std::index_sequence<I...>) {
+    bool ok = true;
+    (void)std::initializer_list<int>{(ok = ok && checkRequired(in, std::get<I>(fields), I, seen), 0)...};
+    return ok;
+}
+
+}
+
+template <typename T>
+bool decodeObject(JsonScanner& in, T& out) {
+    constexpr auto fields = RequestSchema<T>::fields();
+    constexpr size_t count = std::tuple_size<decltype(fields)>::value;
+    static_assert(count <= 64, "字段表最多 64 项");
+    auto indexes = std::make_index_sequence<count>();
+
+    if (!in.consume('{')) return in.fail("请求体应为 JSON 对象");
+    uint64_t seen = 0;
+    if (!in.consume('}')) {
+        do {
+            const char* key;
+            size_t length;
+            if (!in.readKey(key, length)) return in.fail("JSON 格式错误");
+            if (!in.consume(':')) return in.fail("JSON 格式错误");
+            int matched = request_detail::matchAny(in, out, fields, key, length, seen, indexes);
+            if (matched < 0) return false;
+            if (matched == 0 && !in.skipValue()) return false;
+        } while (in.consume(','));
+        if (!in.consume('}')) return in.fail("JSON 格式错误");
+    }
+    return request_detail::checkAll(in, fields, seen, indexes);
+}
+
+// 解码整个请求体，失败时 error 为给客户端看的说明
+template <typename T>
+bool decodeRequest(const std::string& body, T& out, std::string& error) {
+    JsonScanner in(body);
+    if (decodeObject(in, out) && (in.atEnd() || in.fail("JSON 格式错误"))) return true;
+    error = in.error();
+    return false;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// 登录会话表：登录成功后发随机令牌，之后的请求只查内存，不再访问数据库。
+// 按令牌哈希分片加锁；每个分片用两级时间轮管理过期，空闲 ttl 秒后失效，
+// 使用时只更新到期时间，槽位到期时再检查并按新的到期时间重新挂入
+class SessionStore {
+public:
+    explicit SessionStore(int ttlSec);
+
+    // 为卡号创建会话，返回 32 位十六进制令牌；取不到随机数时返回空串
+    std::string create(const std::string& cardNumber);
+    // 令牌有效时返回 true 并给出卡号，同时把到期时间顺延 ttl
+    bool validate(const std::string& token, std::string& cardNumber);
+    void revoke(const std::string& token);
+    // 改密码、销户后作废该卡的其他会话（遍历全部分片，只用于这类低频操作）
+    void revokeCard(const std::string& cardNumber, const std::string& exceptToken);
+
+    // 推进时间轮，清理已过期的会话，返回清理条数；由后台任务每秒调用
+    int64_t sweep();
+
+    int ttl() const { return ttlSec; }
+
+    // 热重启交接：beginHandoff 之后记下注销的令牌和作废过会话的卡号，导出时一并带上，
+    // 使对方进程导入时不会把已注销的会话加回来。endHandoff 停止记录
+    void beginHandoff();
+    void endHandoff();
+    // 每行一条："S 令牌 卡号 剩余秒数"、"T 令牌"（已注销）、"C 卡号 保留的令牌"（作废该卡其他会话）
+    std::string exportState();
+    // 导入对方导出的内容，返回新增的会话数；本进程交接期间注销过的令牌、作废过的卡不再加回，其他行忽略
+    size_t importState(const std::string& state);
+
+    std::atomic<int64_t> active{0};
+    std::atomic<uint64_t> created{0};
+    std::atomic<uint64_t> expired{0};
+    std::atomic<uint64_t> sweepEntries{0}; // 时间轮到期时检查过的条目数
+    std::atomic<uint64_t> sweepNanos{0};   // 清理累计耗时
+
+private:
+    static const int kShards = 64;
+    static const int kNearSlots = 256; // 第一级：每槽 1 秒
+    static const int kFarSlots = 64;   // 第二级：每槽 256 秒，共约 4.6 小时
+
+    struct Session {
+        std::string cardNumber;
+        uint64_t expiresAt; // 以 tick（秒）计
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Session> sessions;
+        std::vector<std::string> nearWheel[kNearSlots];
+        std::vector<std::string> farWheel[kFarSlots];
+        uint64_t tick = 0; // 下一个要处理的 tick
+    };
+
+    int ttlSec;
+    std::chrono::steady_clock::time_point start;
+    Shard shards[kShards];
+
+    std::mutex handoffMutex;
+    bool tracking = false;
+    std::unordered_set<std::string> revokedTokens;
+    std::vector<std::pair<std::string, std::string>> revokedCards; // 卡号、保留的令牌
+
+    uint64_t now() const;
+    Shard& shardFor(const std::string& token);
+    // 调用方持有分片锁
+    void schedule(Shard& shard, const std::string& token, uint64_t deadline);
+    int64_t advance(Shard& shard, uint64_t until);
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+// 按键哈希分片的 LRU 缓存，每个分片一把锁，容量按分片均分；ttl 为 0 表示不过期。
+// 读穿透回填与写操作之间的竞争用分片序号处理：写操作开始和结束都会推进序号，
+// 回填前后序号不一致（或期间有写操作未结束）就放弃写入，避免把旧值或重复累加的值留在缓存里
+template <typename V>
+class ShardedCache {
+public:
+    ShardedCache(size_t capacity, size_t shardCount = 64, std::chrono::milliseconds ttl = std::chrono::milliseconds(0))
+        : shards(shardCount), perShard(capacity / shardCount > 0 ? capacity / shardCount : 1), ttl(ttl) {}
+
+    // 命中返回 true 并拷贝出值
+    bool get(const std::string& key, V& out) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (lookupLocked(s, key, out)) {
+            hits++;
+            return true;
+        }
+        misses++;
+        return false;
+    }
+
+    // 未命中时调用 loader(V&) 读取后端；loader 返回 false 表示不存在，不做缓存
+    bool getOrLoad(const std::string& key, V& out, const std::function<bool(V&)>& loader) {
+        Shard& s = shardFor(key);
+        uint64_t seq;
+        bool clean;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (lookupLocked(s, key, out)) {
+                hits++;
+                return true;
+            }
+            seq = s.seq;
+            clean = s.writers == 0;
+        }
+        misses++;
+        if (!loader(out)) return false;
+        if (clean) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.seq == seq) insertLocked(s, key, out);
+        }
+        return true;
+    }
+
+    // 直接写入（用于预热或外部已确认的新值）
+    void put(const std::string& key, const V& value) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        insertLocked(s, key, value);
+    }
+
+    // 分两步的回填，用于批量读取：读后端之前取 stamp，读完用 fillIfUnchanged 写入。
+    // 期间有写操作或该键已在缓存里时不写入，返回是否写入
+    uint64_t stamp(const std::string& key) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.writers > 0) return kDirty;
+        return s.seq;
+    }
+
+    bool fillIfUnchanged(const std::string& key, const V& value, uint64_t stamp) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (stamp == kDirty || s.seq != stamp || s.index.count(key)) return false;
+        insertLocked(s, key, value);
+        return true;
+    }
+
+    void erase(const std::string& key) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        eraseLocked(s, key);
+    }
+
+    // 写操作提交前调用
+    void beginWrite(const std::string& key) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.seq++;
+        s.writers++;
+    }
+
+    // 写操作结束后调用；apply(V&) 在缓存值上原地修改，返回 false 表示删除该项
+    void endWrite(const std::string& key, const std::function<bool(V&)>& apply) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.seq++;
+        s.writers--;
+        auto it = s.index.find(key);
+        if (it == s.index.end() || !apply) return;
+        if (!apply(it->second->value)) eraseLocked(s, key);
+    }
+
+    // 遍历当前所有未过期项（持有分片锁，fn 内不要再访问本缓存）
+    void forEach(const std::function<void(const std::string&, const V&)>& fn) {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (const auto& e : s.lru) {
+                if (ttl.count() > 0 && now >= e.expires) continue;
+                fn(e.key, e.value);
+            }
+        }
+    }
+
+    size_t size() const { return entries.load(); }
+    size_t capacity() const { return perShard * shards.size(); }
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+private:
+    static const uint64_t kDirty = ~(uint64_t)0;
+
+    struct Entry {
+        std::string key;
+        V value;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru; // 头部最近使用
+        std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+        uint64_t seq = 0;
+        int writers = 0;
+    };
+
+    std::vector<Shard> shards;
+    size_t perShard;
+    std::chrono::milliseconds ttl;
+    std::atomic<size_t> entries{0};
+
+    Shard& shardFor(const std::string& key) {
+        return shards[std::hash<std::string>()(key) % shards.size()];
+    }
+
+    bool lookupLocked(Shard& s, const std::string& key, V& out) {
+        auto it = s.index.find(key);
+        if (it == s.index.end()) return false;
+        if (ttl.count() > 0 && std::chrono::steady_clock::now() >= it->second->expires) {
+            eraseLocked(s, key);
+            return false;
+        }
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        out = it->second->value;
+        return true;
+    }
+
+    void insertLocked(Shard& s, const std::string& key, const V& value) {
+        auto expires = std::chrono::steady_clock::now() + ttl;
+        auto it = s.index.find(key);
+        if (it != s.index.end()) {
+            it->second->value = value;
+            it->second->expires = expires;
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            return;
+        }
+        if (s.index.size() >= perShard) {
+            s.index.erase(s.lru.back().key);
+            s.lru.pop_back();
+            entries--;
+            evictions++;
+        }
+        s.lru.push_front({key, value, expires});
+        s.index[key] = s.lru.begin();
+        entries++;
+    }
+
+    void eraseLocked(Shard& s, const std::string& key) {
+        auto it = s.index.find(key);
+        if (it == s.index.end()) return;
+        s.lru.erase(it->second);
+        s.index.erase(it);
+        entries--;
+    }
+};
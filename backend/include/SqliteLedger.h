@@ -0,0 +1,86 @@
+#pragma once
+#include "LedgerStore.h"
+#include <sqlite3.h>
+#include <unordered_map>
+#include <memory>
+#include <stdexcept>
+
+// SQLite 存储后端：WAL 模式，每个工作线程一个连接并缓存预编译语句，
+// 涉及余额的操作用 BEGIN IMMEDIATE 事务
+class SqliteLedger : public LedgerStore {
+public:
+    explicit SqliteLedger(const std::string& path);
+
+    // 建表并检查数据库可以打开
+    bool open();
+
+    const char* backendName() const override { return "sqlite"; }
+    bool isConnected() override { return opened; }
+
+    bool verifyLogin(const std::string& cardNumber, const std::string& password) override;
+    std::string getUserInfo(const std::string& cardNumber) override;
+    double getBalance(const std::string& cardNumber) override;
+    bool deposit(const std::string& cardNumber, double amount) override;
+    bool withdraw(const std::string& cardNumber, double amount) override;
+    std::string getTransactionHistory(const std::string& cardNumber) override;
+    std::unique_ptr<TransactionCursor> openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) override;
+    bool isCardNumberExists(const std::string& cardNumber) override;
+    bool createAccount(const std::string& name, const std::string& idCard,
+                       const std::string& phone, const std::string& address,
+                       const std::string& cardNumber, const std::string& password,
+                       double initialDeposit) override;
+    void createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) override;
+
+    std::string getUserName(const std::string& card_number) override;
+    bool transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) override;
+    void transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) override;
+    std::string getUserMessages(const std::string& card_number) override;
+    bool markMessageRead(const std::string& card_number, int message_id) override;
+    bool sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) override;
+    bool updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) override;
+
+    bool verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) override;
+    bool updatePassword(const std::string& cardNumber, const std::string& newPassword) override;
+
+    bool checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) override;
+    bool deleteAccount(const std::string& cardNumber) override;
+
+    bool loadAccountProfile(const std::string& cardNumber, AccountProfile& out) override;
+    bool prepareAll() override;
+    bool recentCards(size_t limit, std::vector<std::string>& out) override;
+    bool loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) override;
+    bool loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) override;
+    bool scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) override;
+    bool reserveSequence(const std::string& name, int64_t count, int64_t& first) override;
+    bool scanStatementPartition(int partition, int partitions, const std::string& since,
+                                const std::function<void(const StatementScanRow&)>& fn) override;
+    bool saveStatementSummaries(const std::vector<StatementSummary>& rows) override;
+    bool rollDailyBalances(const std::string& today, int64_t& rows) override;
+    bool balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) override;
+    bool rollupSpending(int64_t& rows) override;
+    bool loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                      std::vector<SpendingBucket>& out) override;
+
+    // 单个线程持有的连接及其语句缓存
+    struct Connection {
+        sqlite3* db = nullptr;
+        std::vector<sqlite3_stmt*> byId;                      // 固定语句表里的语句，按编号
+        std::unordered_map<std::string, sqlite3_stmt*> bySql; // 其他语句，以 SQL 文本为键
+        ~Connection();
+        sqlite3_stmt* prepare(int id);
+        sqlite3_stmt* prepare(const std::string& sql);
+        void exec(const char* sql);
+    };
+
+private:
+    std::string path;
+    bool opened = false;
+
+    Connection& connection();
+    // 出错时抛异常，由调用方决定返回值
+    bool readProfile(const std::string& cardNumber, AccountProfile& out);
+    // 在调用方的事务里写入一个账户，卡号已存在返回 false，其他错误抛异常
+    bool insertAccount(Connection& conn, const NewAccount& a);
+    // 在调用方的事务里用多行 INSERT 写入从 begin 起的一整批账户，任何一行出错都抛异常
+    void insertAccountBatch(Connection& conn, const std::vector<NewAccount>& rows, size_t begin);
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "LedgerStore.h"
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+
+// 月度对账单批处理：按 card_id 取模把卡分成若干片，工作线程各自领取分片，
+// 每片只扫描一次“当前余额 + 期初以来的流水”，倒推出期初/期末余额。
+// 输出 <dir>/<YYYY-MM>/part-NNNN 文件并写入 statements 汇总表；
+// 完成的分片记在 checkpoint 文件里，中断后重跑会跳过它们
+class StatementJob {
+public:
+    struct Report {
+        int partitions = 0;
+        int skipped = 0;   // 上次已完成、本次跳过的分片
+        int failed = 0;
+        size_t cards = 0;
+        size_t transactions = 0;
+        double seconds = 0;
+    };
+
+    StatementJob(LedgerStore& store, const std::string& dir, int threads);
+
+    // period 格式为 YYYY-MM，格式错误时返回 false
+    bool run(const std::string& period, Report& report);
+
+    // "2026-09" -> ["2026-09-01 00:00:00", "2026-10-01 00:00:00")
+    static bool periodRange(const std::string& period, std::string& begin, std::string& end);
+
+private:
+    LedgerStore& store;
+    std::string dir;
+    int threads;
+
+    std::mutex checkpointMutex;
+
+    // 生成一个分片的对账单文件和汇总，成功后才记入 checkpoint
+    bool runPartition(int partition, int partitions, const std::string& period, const std::string& outDir,
+                      const std::string& begin, const std::string& end, size_t& cards, size_t& transactions);
+    bool loadCheckpoint(const std::string& path, int& partitions, std::set<int>& done);
+    bool markDone(const std::string& path, int partition);
+};
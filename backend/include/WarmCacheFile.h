@@ -0,0 +1,60 @@
+#pragma once
+#include "LedgerStore.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 持久化热缓存文件：按卡号排好序的定长索引加一段字符串区，映射进内存后直接二分查找，不用解析。
+//   头部: 魔数 "BWC1"、卡数、字符串区字节数
+//   索引: 每张卡 64 字节，卡号（不足补 0）、card_id、版本号、余额（分）、资料在字符串区的偏移和长度
+//   字符串区: 每张卡的姓名、身份证号、电话、地址、开户时间，以 '\0' 分隔
+// 写入时先写临时文件再改名，已经映射旧文件的进程不受影响
+class WarmCacheFile {
+public:
+    WarmCacheFile() = default;
+    ~WarmCacheFile();
+    WarmCacheFile(const WarmCacheFile&) = delete;
+    WarmCacheFile& operator=(const WarmCacheFile&) = delete;
+
+    // 写入（覆盖）path，卡号过长的行跳过；出错返回 false，原文件保持不变
+    static bool write(const std::string& path, std::vector<VersionedProfile> rows);
+
+    // 只读映射 path，文件不存在或格式不对返回 false
+    bool open(const std::string& path);
+
+    size_t size() const { return count; }
+    // 第 i 张卡（按卡号排序）
+    std::string cardNumber(size_t i) const;
+    bool read(size_t i, VersionedProfile& out) const;
+    // 二分查找卡号，找到时填入 out
+    bool find(const std::string& cardNumber, VersionedProfile& out) const;
+
+private:
+    static const size_t kCardBytes = 24;
+
+    struct Header {
+        char magic[4];
+        uint32_t count;
+        uint64_t textBytes;
+    };
+    struct Entry {
+        char card[kCardBytes];
+        int64_t cardId;
+        int64_t version;
+        int64_t balanceCents;
+        uint64_t textOffset;
+        uint32_t textLength;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Entry) == 64, "索引项应为 64 字节");
+
+    void* mapped = nullptr;
+    size_t mappedBytes = 0;
+    const Entry* entries = nullptr;
+    const char* text = nullptr;
+    size_t count = 0;
+    uint64_t textBytes = 0;
+
+    int compare(size_t i, const std::string& cardNumber) const;
+};
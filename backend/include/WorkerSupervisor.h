@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+
+// 多进程模式：父进程只负责看护，fork 出若干工作进程，各自连接存储后端并以 SO_REUSEPORT 监听同一端口，
+// 由内核在进程间分配连接。工作进程异常退出后按退避间隔重新拉起；父进程收到 SIGINT/SIGTERM 时
+// 通知所有工作进程正常退出并等待它们结束。
+// 各工作进程定期把自己的指标文本写进 fork 前建立的共享内存，任一进程的 /metrics 都能汇总全部进程
+class WorkerSupervisor {
+public:
+    static const int kMaxWorkers = 64;
+
+    explicit WorkerSupervisor(int workers);
+    ~WorkerSupervisor();
+
+    // 父进程在这里一直运行到收到退出信号且工作进程全部结束，返回 -1；
+    // 工作进程立即返回自己的编号（从 0 开始），之后照常初始化并监听
+    int run();
+
+    int workerCount() const { return workers; }
+
+    // 工作进程发布自己当前的指标文本，超出槽位大小的部分截掉
+    void publish(int index, const std::string& metrics);
+    // 汇总所有工作进程的指标，样本带 worker 标签，另附看护进程自己的指标
+    std::string collect() const;
+
+private:
+    static const size_t kSlotBytes = 64 * 1024;
+
+    // 每个工作进程一个槽，写入时 seq 为奇数，读取方发现 seq 变化就重读
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        uint32_t length;
+        char text[kSlotBytes];
+    };
+    struct Shared {
+        std::atomic<uint64_t> restarts;
+        std::atomic<int> alive;
+        Slot slots[kMaxWorkers];
+    };
+
+    int workers;
+    Shared* shared = nullptr;
+    pid_t supervisorPid;
+
+    // 在子进程中返回 0，父进程中返回子进程 pid，失败返回 -1
+    pid_t spawn();
+};
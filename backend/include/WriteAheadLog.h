@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+// 预写日志：按起始 LSN 命名的分段文件，后台线程组提交（一批记录一次 fdatasync）
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& dir);
+    ~WriteAheadLog();
+
+    // 按顺序重放所有日志段中 LSN 大于 afterLsn 的记录，返回最后一条有效记录的 LSN
+    uint64_t replay(uint64_t afterLsn, const std::function<void(uint64_t, const std::string&)>& apply);
+    // 从 nextLsn 开始新建日志段并启动组提交线程
+    bool open(uint64_t nextLsn);
+    void close();
+
+    // 追加一条记录到内存缓冲，返回其 LSN；调用方按需 waitDurable
+    uint64_t append(const std::string& payload);
+    // 阻塞直到该 LSN 及之前的记录全部落盘
+    void waitDurable(uint64_t lsn);
+    // 刷盘并切换到新日志段，返回旧段中最后的 LSN；调用方需保证期间没有新的 append
+    uint64_t rotate();
+    // 删除起始 LSN 小于当前段的旧日志段（快照已覆盖）
+    void removeOldSegments();
+
+    uint64_t syncCount() const { return syncs.load(); }
+
+    static uint32_t checksum(const char* data, size_t len);
+
+private:
+    std::string dir;
+    int fd = -1;
+    uint64_t segmentStart = 0;
+    uint64_t appendedLsn = 0;
+    uint64_t durableLsn = 0;
+    std::string pending;
+    bool writing = false;
+    bool stopping = false;
+    std::atomic<uint64_t> syncs{0};
+
+    std::mutex mutex;
+    std::condition_variable pendingCv;
+    std::condition_variable durableCv;
+    std::thread writer;
+
+    void writerLoop();
+    bool openSegment(uint64_t startLsn);
+    std::vector<std::pair<uint64_t, std::string>> listSegments() const;
+};
@@ -2955,6 +2955,17 @@ namespace crow
         bool skip_body = false;            ///< Whether this is a response to a HEAD request.
         bool manual_length_header = false; ///< Whether Crow should automatically add a "Content-Length" header.
 
+        /// Produces the body piece by piece for a chunked response.
+
+        ///
+        /// Called repeatedly after the headers are sent; append the next piece to the string
+        /// and return false once the body is complete. Each piece is written before the next call,
+        /// so memory use stays bounded by the size of one piece.
+        std::function<bool(std::string&)> body_producer;
+
+        /// A body shared between responses (e.g. a pre-serialized constant); sent without copying when set.
+        std::shared_ptr<const std::string> shared_body;
+
         /// Set the value of an existing header in the response.
         void set_header(std::string key, std::string value)
         {
@@ -3022,6 +3033,8 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            body_producer = std::move(r.body_producer);
+            shared_body = std::move(r.shared_body);
             return *this;
         }
 
@@ -3038,6 +3051,8 @@ namespace crow
             headers.clear();
             completed_ = false;
             file_info = static_file_info{};
+            body_producer = nullptr;
+            shared_body.reset();
         }
 
         /// Return a "Temporary Redirect" response.
@@ -3093,8 +3108,9 @@ namespace crow
                 completed_ = true;
                 if (skip_body)
                 {
-                    set_header("Content-Length", std::to_string(body.size()));
+                    set_header("Content-Length", std::to_string(body_size()));
                     body = "";
+                    shared_body.reset();
                     manual_length_header = true;
                 }
                 if (complete_request_handler_)
@@ -3123,6 +3139,32 @@ namespace crow
             return file_info.path.size();
         }
 
+        /// Send the body with chunked transfer encoding, generated by the producer.
+        void set_body_producer(std::function<bool(std::string&)> producer)
+        {
+            body_producer = std::move(producer);
+            set_header("Transfer-Encoding", "chunked");
+        }
+
+        /// Send a shared, immutable body; the string is kept alive until it has been written.
+        void set_shared_body(std::shared_ptr<const std::string> shared)
+        {
+            shared_body = std::move(shared);
+            body.clear();
+        }
+
+        /// Size of the body that will be sent.
+        size_t body_size() const
+        {
+            return shared_body ? shared_body->size() : body.size();
+        }
+
+        /// Check whether the response body comes from a producer.
+        bool is_chunked_type()
+        {
+            return static_cast<bool>(body_producer);
+        }
+
         /// This constains metadata (coming from the `stat` command) related to any static files associated with this response.
 
         ///
@@ -5198,7 +5240,7 @@ reexecute:
         if (ch == ' ') break;
 
         CROW_MARK(url);
-        CROW_MARK(url_start);
+        url_start_mark = p; // each pipelined message starts its own url
         if (parser->method == (unsigned)HTTPMethod::Connect) {
           parser->state = s_req_server_start;
         }
@@ -11176,6 +11218,7 @@ namespace crow
 #include <atomic>
 #include <chrono>
 #include <vector>
+#include <deque>
 
 
 
@@ -11288,12 +11331,23 @@ namespace crow
         }
 
         void handle()
+        {
+            if (is_writing)
+            {
+                // A pipelined request arrived while the previous response is still being written; handled once it is done
+                deferred_requests_.push_back(parser_.to_request());
+                return;
+            }
+            req_ = std::move(parser_.to_request());
+            handle_request();
+        }
+
+        void handle_request()
         {
             cancel_deadline_timer();
             bool is_invalid_request = false;
             add_keep_alive_ = false;
 
-            req_ = std::move(parser_.to_request());
             request& req = req_;
 
             req.remote_ip_address = adaptor_.remote_endpoint().address().to_string();
@@ -11443,6 +11497,10 @@ namespace crow
             {
                 do_write_static();
             }
+            else if (res.is_chunked_type())
+            {
+                do_write_chunked();
+            }
             else
             {
                 do_write_general();
@@ -11519,7 +11577,7 @@ namespace crow
                 buffers_.emplace_back(status.data(), status.size());
             }
 
-            if (res.code >= 400 && res.body.empty())
+            if (res.code >= 400 && res.body.empty() && !res.shared_body)
                 res.body = statusCodes[res.code].substr(9);
 
             for (auto& kv : res.headers)
@@ -11530,9 +11588,9 @@ namespace crow
                 buffers_.emplace_back(crlf.data(), crlf.size());
             }
 
-            if (!res.manual_length_header && !res.headers.count("content-length"))
+            if (!res.manual_length_header && !res.headers.count("content-length") && !res.is_chunked_type())
             {
-                content_length_ = std::to_string(res.body.size());
+                content_length_ = std::to_string(res.body_size());
                 static std::string content_length_tag = "Content-Length: ";
                 buffers_.emplace_back(content_length_tag.data(), content_length_tag.size());
                 buffers_.emplace_back(content_length_.data(), content_length_.size());
@@ -11593,9 +11651,154 @@ namespace crow
             buffers_.clear();
         }
 
+        void do_write_chunked()
+        {
+            // Each piece is written with async_write under the connection timeout, so a slow client
+            // never blocks the I/O thread; reading the next request waits until the body is done
+            is_writing = true;
+            streaming_ = true;
+            chunk_finished_ = false;
+            start_deadline();
+            boost::asio::async_write(
+              adaptor_.socket(), buffers_,
+              [this](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) {
+                  write_next_chunk(ec);
+              });
+        }
+
+        void write_next_chunk(const boost::system::error_code& ec)
+        {
+            if (ec || chunk_finished_)
+            {
+                finish_chunked(ec);
+                return;
+            }
+            chunk_piece_.clear();
+            bool more = !res.skip_body;
+            while (more && chunk_piece_.empty())
+                more = res.body_producer(chunk_piece_);
+
+            chunk_buffers_.clear();
+            if (!chunk_piece_.empty())
+            {
+                int n = snprintf(chunk_size_line_, sizeof(chunk_size_line_), "%zx\r\n", chunk_piece_.size());
+                chunk_buffers_.push_back(boost::asio::buffer(chunk_size_line_, n));
+                chunk_buffers_.push_back(boost::asio::buffer(chunk_piece_));
+                chunk_buffers_.push_back(boost::asio::buffer(crlf));
+            }
+            if (!more)
+            {
+                chunk_finished_ = true;
+                static const std::string last_chunk = "0\r\n\r\n";
+                if (!res.skip_body)
+                    chunk_buffers_.push_back(boost::asio::buffer(last_chunk));
+            }
+            if (chunk_buffers_.empty())
+            {
+                finish_chunked(ec);
+                return;
+            }
+            start_deadline();
+            boost::asio::async_write(
+              adaptor_.socket(), chunk_buffers_,
+              [this](const boost::system::error_code& ec, std::size_t /*bytes_transferred*/) {
+                  write_next_chunk(ec);
+              });
+        }
+
+        void finish_chunked(const boost::system::error_code& ec)
+        {
+            // Releasing the producer also releases whatever it holds (cursor, admission slot)
+            res.body_producer = nullptr;
+            chunk_piece_.clear();
+            chunk_piece_.shrink_to_fit();
+            is_writing = false;
+            streaming_ = false;
+            if (ec)
+            {
+                CROW_LOG_ERROR << ec << " - happened while sending chunked body";
+            }
+
+            res.end();
+            res.clear();
+            buffers_.clear();
+
+            if (!close_connection_ && !ec && adaptor_.is_open())
+            {
+                handle_deferred();
+                if (streaming_)
+                    return;
+                if (close_connection_)
+                {
+                    // The last deferred request asked to close; a pending write closes the connection when it completes
+                    if (need_to_start_read_after_complete_)
+                    {
+                        need_to_start_read_after_complete_ = false;
+                        is_reading = false;
+                    }
+                    if (!is_writing)
+                    {
+                        adaptor_.shutdown_readwrite();
+                        adaptor_.close();
+                        check_destroy();
+                    }
+                    return;
+                }
+                if (need_to_start_read_after_complete_)
+                {
+                    need_to_start_read_after_complete_ = false;
+                    start_deadline();
+                    do_read();
+                }
+                return;
+            }
+            deferred_requests_.clear();
+
+            if (close_connection_ || ec || !adaptor_.is_open())
+            {
+                cancel_deadline_timer();
+                adaptor_.shutdown_readwrite();
+                adaptor_.close();
+                if (need_to_start_read_after_complete_)
+                {
+                    need_to_start_read_after_complete_ = false;
+                    is_reading = false;
+                }
+                CROW_LOG_DEBUG << this << " from write (chunked)";
+                check_destroy();
+                return;
+            }
+        }
+
+        /// Handle pipelined requests queued while a response was being written, until one of them writes asynchronously.
+        void handle_deferred()
+        {
+            while (!deferred_requests_.empty() && !is_writing && adaptor_.is_open())
+            {
+                req_ = std::move(deferred_requests_.front());
+                deferred_requests_.pop_front();
+                handle_request();
+            }
+        }
+
         void do_write_general()
         {
-            if (res.body.length() < res_stream_threshold_)
+            if (res.shared_body)
+            {
+                // Hold a reference of our own: res may be reused by a pipelined request before the write finishes
+                res_shared_body_ = std::move(res.shared_body);
+                buffers_.emplace_back(res_shared_body_->data(), res_shared_body_->size());
+
+                do_write();
+
+                if (need_to_start_read_after_complete_)
+                {
+                    need_to_start_read_after_complete_ = false;
+                    start_deadline();
+                    do_read();
+                }
+            }
+            else if (res.body.length() < res_stream_threshold_)
             {
                 res_body_copy_.swap(res.body);
                 buffers_.emplace_back(res_body_copy_.data(), res_body_copy_.size());
@@ -11686,14 +11889,14 @@ namespace crow
                       check_destroy();
                       // adaptor will close after write
                   }
-                  else if (!need_to_call_after_handlers_)
+                  else if (!need_to_call_after_handlers_ && !streaming_)
                   {
                       start_deadline();
                       do_read();
                   }
                   else
                   {
-                      // res will be completed later by user
+                      // res will be completed later by user, or a chunked body is still being written
                       need_to_start_read_after_complete_ = true;
                   }
               });
@@ -11709,15 +11912,21 @@ namespace crow
                   is_writing = false;
                   res.clear();
                   res_body_copy_.clear();
+                  res_shared_body_.reset();
                   if (!ec)
                   {
                       if (close_connection_)
                       {
+                          deferred_requests_.clear();
                           adaptor_.shutdown_write();
                           adaptor_.close();
                           CROW_LOG_DEBUG << this << " from write(1)";
                           check_destroy();
                       }
+                      else
+                      {
+                          handle_deferred();
+                      }
                   }
                   else
                   {
@@ -11795,6 +12004,7 @@ namespace crow
         std::string content_length_;
         std::string date_str_;
         std::string res_body_copy_;
+        std::shared_ptr<const std::string> res_shared_body_;
 
         detail::task_timer::identifier_type task_id_;
 
@@ -11804,6 +12014,14 @@ namespace crow
         bool need_to_start_read_after_complete_{};
         bool add_keep_alive_{};
 
+        // Chunked body state (see do_write_chunked)
+        bool streaming_{};
+        bool chunk_finished_{};
+        std::string chunk_piece_;
+        char chunk_size_line_[24];
+        std::vector<boost::asio::const_buffer> chunk_buffers_;
+        std::deque<request> deferred_requests_;
+
         std::tuple<Middlewares...>* middlewares_;
         detail::context<Middlewares...> ctx_;
 
@@ -11851,8 +12069,8 @@ namespace crow
     class Server
     {
     public:
-        Server(Handler* handler, std::string bindaddr, uint16_t port, std::string server_name = std::string("Crow/") + VERSION, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, uint8_t timeout = 5, typename Adaptor::context* adaptor_ctx = nullptr):
-          acceptor_(io_service_, tcp::endpoint(boost::asio::ip::address::from_string(bindaddr), port)),
+        Server(Handler* handler, std::string bindaddr, uint16_t port, std::string server_name = std::string("Crow/") + VERSION, std::tuple<Middlewares...>* middlewares = nullptr, uint16_t concurrency = 1, uint8_t timeout = 5, typename Adaptor::context* adaptor_ctx = nullptr, bool reuse_port = false, int listen_fd = -1):
+          acceptor_(open_acceptor(io_service_, tcp::endpoint(boost::asio::ip::address::from_string(bindaddr), port), reuse_port, listen_fd)),
           signals_(io_service_),
           tick_timer_(io_service_),
           handler_(handler),
@@ -11872,6 +12090,12 @@ namespace crow
             tick_function_ = f;
         }
 
+        /// Called at the start of every worker thread with its index, before the thread allocates anything
+        void set_thread_init(std::function<void(int)> f)
+        {
+            thread_init_ = std::move(f);
+        }
+
         void on_tick()
         {
             tick_function_();
@@ -11897,6 +12121,8 @@ namespace crow
                 v.push_back(
                   std::async(
                     std::launch::async, [this, i, &init_count] {
+                        if (thread_init_) thread_init_(i);
+
                         // thread local date string get function
                         auto last = std::chrono::steady_clock::now();
 
@@ -11991,6 +12217,30 @@ namespace crow
                 io_service->stop();
         }
 
+        /// Close the listening socket of this process; open connections keep being served
+        void stop_accepting()
+        {
+            io_service_.post([this] {
+                boost::system::error_code ec;
+                acceptor_.close(ec);
+            });
+        }
+
+        /// Native handle of the listening socket, so that it can be passed to another process
+        int listen_handle()
+        {
+            return acceptor_.native_handle();
+        }
+
+        /// Number of connections not yet closed (including one pending accept while accepting)
+        size_t connection_count()
+        {
+            size_t count = 0;
+            for (auto& length : task_queue_length_pool_)
+                count += length;
+            return count;
+        }
+
         void signal_clear()
         {
             signals_.clear();
@@ -12042,12 +12292,38 @@ namespace crow
                       task_queue_length_pool_[service_idx]--;
                       CROW_LOG_DEBUG << &is << " {" << service_idx << "} queue length: " << task_queue_length_pool_[service_idx];
                       delete p;
+                      if (!acceptor_.is_open())
+                          return;
                   }
                   do_accept();
               });
         }
 
     private:
+        /// Same as the endpoint constructor of tcp::acceptor, optionally setting SO_REUSEPORT before bind
+        /// so that several processes can listen on the same port and let the kernel spread connections.
+        /// When listen_fd is given, adopt that already listening socket (inherited from another process) instead.
+        static tcp::acceptor open_acceptor(asio::io_service& io_service, const tcp::endpoint& endpoint, bool reuse_port, int listen_fd)
+        {
+            tcp::acceptor acceptor(io_service);
+            if (listen_fd >= 0)
+            {
+                acceptor.assign(endpoint.protocol(), listen_fd);
+                return acceptor;
+            }
+            acceptor.open(endpoint.protocol());
+            acceptor.set_option(tcp::acceptor::reuse_address(true));
+            if (reuse_port)
+            {
+                int one = 1;
+                if (setsockopt(acceptor.native_handle(), SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0)
+                    throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()), "SO_REUSEPORT");
+            }
+            acceptor.bind(endpoint);
+            acceptor.listen();
+            return acceptor;
+        }
+
         asio::io_service io_service_;
         std::vector<std::unique_ptr<asio::io_service>> io_service_pool_;
         std::vector<detail::task_timer*> task_timer_pool_;
@@ -12058,6 +12334,7 @@ namespace crow
 
         Handler* handler_;
         uint16_t concurrency_{2};
+        std::function<void(int)> thread_init_;
         std::uint8_t timeout_;
         std::string server_name_;
         uint16_t port_;
@@ -12236,6 +12513,27 @@ namespace crow
             return *this;
         }
 
+        /// Set SO_REUSEPORT on the listening socket so several processes can share the port
+        self_t& reuse_port(bool enabled)
+        {
+            reuse_port_ = enabled;
+            return *this;
+        }
+
+        /// Serve on an already listening socket (e.g. handed over by the process being replaced) instead of binding the port
+        self_t& listen_fd(int fd)
+        {
+            listen_fd_ = fd;
+            return *this;
+        }
+
+        /// Run f(index) at the start of every worker thread (e.g. to pin it to a CPU)
+        self_t& thread_init(std::function<void(int)> f)
+        {
+            thread_init_ = std::move(f);
+            return *this;
+        }
+
         /// Run the server on multiple threads using all available threads
         self_t& multithreaded()
         {
@@ -12382,8 +12680,9 @@ namespace crow
             else
 #endif
             {
-                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, server_name_, &middlewares_, concurrency_, timeout_, nullptr)));
+                server_ = std::move(std::unique_ptr<server_t>(new server_t(this, bindaddr_, port_, server_name_, &middlewares_, concurrency_, timeout_, nullptr, reuse_port_, listen_fd_)));
                 server_->set_tick_function(tick_interval_, tick_function_);
+                server_->set_thread_init(thread_init_);
                 server_->signal_clear();
                 for (auto snum : signals_)
                 {
@@ -12417,6 +12716,24 @@ namespace crow
             }
         }
 
+        /// Stop accepting new connections while the open ones are still served (plain HTTP server only)
+        void stop_accepting()
+        {
+            if (server_) { server_->stop_accepting(); }
+        }
+
+        /// Native handle of the listening socket, -1 before the server has started
+        int listen_handle()
+        {
+            return server_ ? server_->listen_handle() : -1;
+        }
+
+        /// Number of open connections of the plain HTTP server
+        size_t connection_count()
+        {
+            return server_ ? server_->connection_count() : 0;
+        }
+
         /// Print the routing paths defined for each HTTP method
         void debug_print()
         {
@@ -12525,6 +12842,9 @@ namespace crow
         bool validated_ = false;
         std::string server_name_ = std::string("Crow/") + VERSION;
         std::string bindaddr_ = "0.0.0.0";
+        bool reuse_port_ = false;
+        int listen_fd_ = -1;
+        std::function<void(int)> thread_init_;
         size_t res_stream_threshold_ = 1048576;
         Router router_;
 
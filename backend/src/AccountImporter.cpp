@@ -0,0 +1,175 @@
+#include "../include/AccountImporter.h"
+#include "../include/CardAllocator.h"
+#include <chrono>
+#include <future>
+#include <sstream>
+#include <thread>
+#include <cstdlib>
+
+std::vector<std::string> splitCsvLine(const std::string& line) {
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if (quoted) {
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                fields.back() += '"';
+                i++;
+            } else if (c == '"') {
+                quoted = false;
+            } else {
+                fields.back() += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.emplace_back();
+        } else if (c != '\r') {
+            fields.back() += c;
+        }
+    }
+    return fields;
+}
+
+namespace {
+
+bool allDigits(const std::string& s) {
+    if (s.empty()) return false;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
+
+}
+
+std::string AccountImporter::Report::toJson() const {
+    std::stringstream ss;
+    ss << "{\"status\":\"success\",\"total\":" << total
+       << ",\"imported\":" << imported
+       << ",\"rejected\":" << rejected
+       << ",\"seconds\":" << seconds
+       << ",\"rows_per_second\":" << (long long)rowsPerSecond()
+       << ",\"rejects\":[";
+    for (size_t i = 0; i < rejects.size(); i++) {
+        if (i) ss << ",";
+        ss << "{\"line\":" << rejects[i].line << ",\"reason\":\"" << escapeJson(rejects[i].reason) << "\"}";
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+AccountImporter::AccountImporter(LedgerStore& store, CardAllocator* allocator, size_t chunkRows, int threads)
+    : store(store), allocator(allocator), chunkRows(chunkRows > 0 ? chunkRows : 1000), threads(threads > 0 ? threads : 1) {}
+
+void AccountImporter::validate(Row& row) {
+    std::vector<std::string> f = splitCsvLine(row.text);
+    if (f.size() != 7) {
+        row.error = "列数应为 7";
+        return;
+    }
+    NewAccount& a = row.account;
+    a.name = f[0]; a.idCard = f[1]; a.phone = f[2]; a.address = f[3];
+    a.cardNumber = f[4]; a.password = f[5];
+    char* end = nullptr;
+    a.initialDeposit = strtod(f[6].c_str(), &end);
+
+    // 与开户页面的前端校验规则一致
+    if (a.name.empty()) row.error = "姓名为空";
+    else if (a.idCard.size() != 18) row.error = "身份证号应为18位";
+    else if (a.phone.size() != 11 || !allDigits(a.phone)) row.error = "手机号应为11位数字";
+    else if (a.password.size() < 6) row.error = "密码至少6位";
+    else if (f[6].empty() || *end != '\0' || a.initialDeposit < 0) row.error = "初始存款无效";
+    else if (!a.cardNumber.empty() && !CardAllocator::wellFormed(a.cardNumber)) row.error = "卡号应为16到19位数字";
+    if (!row.error.empty()) return;
+
+    if (a.cardNumber.empty()) {
+        if (!allocator) row.error = "卡号为空";
+        else if ((a.cardNumber = allocator->allocate()).empty()) row.error = "卡号分配失败";
+    } else if (store.isCardNumberExists(a.cardNumber)) {
+        row.error = "卡号已存在";
+    }
+}
+
+void AccountImporter::validateChunk(std::vector<Row>& rows) {
+    // 各线程处理互不重叠的一段
+    size_t per = (rows.size() + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (size_t begin = 0; begin < rows.size(); begin += per) {
+        size_t end = std::min(rows.size(), begin + per);
+        workers.emplace_back([this, &rows, begin, end] {
+            for (size_t i = begin; i < end; i++) validate(rows[i]);
+        });
+    }
+    for (auto& t : workers) t.join();
+
+    // 文件内重复只能按顺序判断
+    for (auto& row : rows) {
+        if (!row.error.empty()) continue;
+        if (!seenCards.insert(row.account.cardNumber).second) row.error = "卡号在文件中重复";
+        else if (!seenIdCards.insert(row.account.idCard).second) row.error = "身份证号在文件中重复";
+    }
+}
+
+void AccountImporter::reject(Report& report, const Row& row, const std::string& reason) {
+    report.rejected++;
+    if (report.rejects.size() < maxRejects) report.rejects.push_back({row.line, reason});
+}
+
+AccountImporter::Report AccountImporter::run(std::istream& in) {
+    Report report;
+    auto start = std::chrono::steady_clock::now();
+    seenCards.clear();
+    seenIdCards.clear();
+
+    // 把一块的合法行交给后端写入，返回后端的结果
+    auto write = [this](std::vector<Row> rows) {
+        std::vector<NewAccount> batch;
+        std::vector<size_t> index;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (!rows[i].error.empty()) continue;
+            batch.push_back(rows[i].account);
+            index.push_back(i);
+        }
+        std::vector<bool> created;
+        if (!batch.empty()) store.createAccounts(batch, created);
+        for (size_t j = 0; j < index.size(); j++) {
+            if (!created[j]) rows[index[j]].error = "写入失败（身份证号已存在或数据库错误）";
+        }
+        return rows;
+    };
+    auto collect = [&](const std::vector<Row>& rows) {
+        for (const auto& row : rows) {
+            if (row.error.empty()) report.imported++;
+            else reject(report, row, row.error);
+        }
+    };
+
+    std::future<std::vector<Row>> pending;
+    std::string line;
+    size_t lineNo = 0;
+    bool eof = false;
+    while (!eof) {
+        std::vector<Row> rows;
+        rows.reserve(chunkRows);
+        while (rows.size() < chunkRows) {
+            if (!std::getline(in, line)) {
+                eof = true;
+                break;
+            }
+            lineNo++;
+            if (line.empty() || line == "\r") continue;
+            if (lineNo == 1 && line.compare(0, 5, "name,") == 0) continue;
+            rows.push_back({lineNo, line, NewAccount(), ""});
+        }
+        report.total += rows.size();
+        validateChunk(rows);
+
+        if (pending.valid()) collect(pending.get());
+        pending = std::async(std::launch::async, write, std::move(rows));
+    }
+    if (pending.valid()) collect(pending.get());
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
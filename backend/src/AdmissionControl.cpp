@@ -0,0 +1,81 @@
+#include "../include/AdmissionControl.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+// 基线每分钟取一次窗口最小值，后端长期变慢或变快后能跟上
+const auto kBaselineWindow = std::chrono::seconds(60);
+// 两次收缩之间至少间隔这么久，避免同一波慢请求把限制连续砍到底
+const auto kDecreaseInterval = std::chrono::milliseconds(100);
+
+const char* const kClassNames[ClassCount] = {"posting", "auth", "balance", "history", "export"};
+const double kClassShares[ClassCount] = {1.0, 1.0, 0.9, 0.75, 0.5};
+
+}
+
+AdmissionControl::Options AdmissionControl::Options::fromEnv() {
+    Options o;
+    if (const char* v = getenv("BANK_ADMISSION_MIN")) o.minLimit = std::max(1, atoi(v));
+    if (const char* v = getenv("BANK_ADMISSION_MAX")) o.maxLimit = atoi(v);
+    o.maxLimit = std::max(o.maxLimit, o.minLimit);
+    o.initialLimit = std::min(std::max(o.initialLimit, o.minLimit), o.maxLimit);
+    return o;
+}
+
+AdmissionControl::AdmissionControl(const Options& options)
+    : options(options), currentLimit(options.initialLimit),
+      windowStart(std::chrono::steady_clock::now()), lastDecrease(windowStart) {}
+
+const char* AdmissionControl::className(int cls) {
+    return kClassNames[cls];
+}
+
+double AdmissionControl::classShare(int cls) {
+    return kClassShares[cls];
+}
+
+bool AdmissionControl::acquire(RequestClass cls) {
+    int allowed = std::max(1, (int)(currentLimit.load() * kClassShares[cls]));
+    int current = inflight.load();
+    while (current < allowed) {
+        if (inflight.compare_exchange_weak(current, current + 1)) return true;
+    }
+    classStats[cls].rejected++;
+    return false;
+}
+
+void AdmissionControl::release(RequestClass cls, std::chrono::steady_clock::duration service) {
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(service).count();
+
+    ClassStats& st = classStats[cls];
+    st.completed++;
+    st.serviceNanos += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(service).count();
+    double ewma = st.latencyEwma.load();
+    st.latencyEwma = ewma == 0 ? seconds : ewma * 0.9 + seconds * 0.1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    bool saturated = inflight.load() >= (int)currentLimit.load();
+    inflight--;
+
+    if (windowMin == 0 || seconds < windowMin) windowMin = seconds;
+    if (baseline.load() == 0 || seconds < baseline.load()) baseline = seconds;
+    if (now - windowStart >= kBaselineWindow) {
+        baseline = windowMin;
+        windowMin = 0;
+        windowStart = now;
+    }
+
+    double limit = currentLimit.load();
+    if (seconds > options.tolerance * baseline.load()) {
+        if (now - lastDecrease >= kDecreaseInterval) {
+            limit = std::max((double)options.minLimit, limit * 0.9);
+            lastDecrease = now;
+        }
+    } else if (saturated) {
+        // 只有名额真的用满时才放大，空闲时不会无限增长
+        limit = std::min((double)options.maxLimit, limit + 1.0 / limit);
+    }
+    currentLimit = limit;
+}
@@ -0,0 +1,439 @@
+#include "../include/CachedLedger.h"
+#include "../include/Metrics.h"
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+template <typename V>
+void registerCacheMetrics(const std::string& cache, ShardedCache<V>& c) {
+    Metrics& m = Metrics::getInstance();
+    std::string label = "{cache=\"" + cache + "\"}";
+    m.add("bank_cache_hits_total" + label, "缓存命中次数", "counter", [&c] { return (double)c.hits; });
+    m.add("bank_cache_misses_total" + label, "缓存未命中次数", "counter", [&c] { return (double)c.misses; });
+    m.add("bank_cache_evictions_total" + label, "因容量淘汰的缓存项", "counter", [&c] { return (double)c.evictions; });
+    m.add("bank_cache_entries" + label, "当前缓存项数", "gauge", [&c] { return (double)c.size(); });
+    m.add("bank_cache_capacity" + label, "缓存容量上限", "gauge", [&c] { return (double)c.capacity(); });
+}
+
+}
+
+CachedLedger::CachedLedger(LedgerStore& inner, size_t capacity, std::chrono::seconds nameTtl)
+    : inner(inner), accounts(capacity), names(capacity, 64, nameTtl) {
+    registerCacheMetrics("account", accounts);
+    registerCacheMetrics("name", names);
+    Metrics& m = Metrics::getInstance();
+    m.add("bank_warm_cache_hits_total", "核对版本号后直接使用热缓存文件的次数", "counter", [this] { return (double)warmHits; });
+    m.add("bank_warm_cache_stale_total", "热缓存文件中已过期的卡", "counter", [this] { return (double)warmStale; });
+    // 后端在转账事务里查付款人姓名时也走姓名缓存
+    inner.setNameLookup([this](const std::string& card) { return getUserName(card); });
+}
+
+bool CachedLedger::enableCardFilter(size_t expected, int threads) {
+    std::unique_ptr<CardFilter> filter(new CardFilter(expected));
+    if (!filter->build(inner, threads)) return false;
+    cardFilter = std::move(filter);
+    CardFilter* f = cardFilter.get();
+    Metrics& m = Metrics::getInstance();
+    m.add("bank_card_filter_keys", "卡号过滤器中的卡号数", "gauge", [f] { return (double)f->keyCount(); });
+    m.add("bank_card_filter_negatives_total", "卡号过滤器直接否定、未查数据库的次数", "counter", [this] { return (double)filterNegatives; });
+    m.add("bank_card_filter_false_positives_total", "卡号过滤器放行但卡号不存在的次数", "counter", [this] { return (double)filterFalsePositives; });
+    return true;
+}
+
+bool CachedLedger::definitelyMissing(const std::string& cardNumber) {
+    if (!cardFilter || bypassFilter || cardFilter->mightContain(cardNumber)) return false;
+    filterNegatives++;
+    return true;
+}
+
+std::string CachedLedger::getUserName(const std::string& card_number) {
+    std::string name;
+    if (definitelyMissing(card_number)) return name;
+    if (bypassCache) return inner.getUserName(card_number);
+    names.getOrLoad(card_number, name, [&](std::string& loaded) {
+        loaded = inner.getUserName(card_number);
+        return !loaded.empty();
+    });
+    return name;
+}
+
+bool CachedLedger::verifyLogin(const std::string& cardNumber, const std::string& password) {
+    bool ok = inner.verifyLogin(cardNumber, password);
+    // 登录后很快会显示姓名或发起转账，提前把姓名放进缓存
+    if (ok) getUserName(cardNumber);
+    return ok;
+}
+
+bool CachedLedger::loadAccountProfile(const std::string& cardNumber, AccountProfile& out) {
+    return !definitelyMissing(cardNumber) && cachedProfile(cardNumber, out);
+}
+
+bool CachedLedger::cachedProfile(const std::string& cardNumber, AccountProfile& out) {
+    if (bypassCache) return inner.loadAccountProfile(cardNumber, out);
+    return accounts.getOrLoad(cardNumber, out, [&](AccountProfile& loaded) {
+        return (warmPending && loadFromWarmFile(cardNumber, loaded)) || inner.loadAccountProfile(cardNumber, loaded);
+    });
+}
+
+bool CachedLedger::loadFromWarmFile(const std::string& cardNumber, AccountProfile& out) {
+    VersionedProfile saved;
+    if (!warmFile.find(cardNumber, saved)) return false;
+    std::vector<CardVersion> current;
+    if (!inner.loadCardVersions({cardNumber}, current)) return false;
+    if (current.size() != 1 || current[0].cardId != saved.row.cardId || current[0].version != saved.row.version) {
+        warmStale++;
+        return false;
+    }
+    warmHits++;
+    out = std::move(saved.profile);
+    return true;
+}
+
+size_t CachedLedger::openWarmCache(const std::string& path) {
+    if (bypassCache || !warmFile.open(path)) return 0;
+    warmPending = warmFile.size() > 0;
+    return warmFile.size();
+}
+
+bool CachedLedger::revalidateWarmCache(int64_t& rows) {
+    rows = 0;
+    if (!warmPending) return true;
+    const size_t chunk = 1000;
+    uint64_t stale = 0;
+    for (size_t begin = 0; begin < warmFile.size(); begin += chunk) {
+        size_t end = std::min(warmFile.size(), begin + chunk);
+        // 先取分片序号再查版本号，期间有写操作的卡不放进缓存
+        std::vector<std::string> cards;
+        std::vector<uint64_t> accountStamps, nameStamps;
+        for (size_t i = begin; i < end; i++) {
+            cards.push_back(warmFile.cardNumber(i));
+            accountStamps.push_back(accounts.stamp(cards.back()));
+            nameStamps.push_back(names.stamp(cards.back()));
+        }
+        std::vector<CardVersion> current;
+        if (!inner.loadCardVersions(cards, current)) return false;
+        std::unordered_map<std::string, const CardVersion*> byCard;
+        for (const auto& v : current) byCard[v.cardNumber] = &v;
+        for (size_t i = begin; i < end; i++) {
+            VersionedProfile saved;
+            auto it = byCard.find(cards[i - begin]);
+            if (!warmFile.read(i, saved) || it == byCard.end() || it->second->cardId != saved.row.cardId || it->second->version != saved.row.version) {
+                stale++;
+                continue;
+            }
+            names.fillIfUnchanged(saved.row.cardNumber, saved.profile.name, nameStamps[i - begin]);
+            if (accounts.fillIfUnchanged(saved.row.cardNumber, saved.profile, accountStamps[i - begin])) rows++;
+        }
+    }
+    warmStale += stale;
+    warmPending = false;
+    return true;
+}
+
+bool CachedLedger::saveWarmCache(const std::string& path, int64_t& rows) {
+    rows = 0;
+    if (bypassCache) return true;
+    std::vector<std::string> cards;
+    std::unordered_set<std::string> seen;
+    accounts.forEach([&](const std::string& card, const AccountProfile&) {
+        if (seen.insert(card).second) cards.push_back(card);
+    });
+    names.forEach([&](const std::string& card, const std::string&) {
+        if (seen.insert(card).second) cards.push_back(card);
+    });
+    // 缓存是空的（刚启动、数据库不可用）时保留上一份文件
+    if (cards.empty()) return true;
+    // 缓存里的余额是原地累加的，不知道对应哪个版本号，连同版本号重新读一遍
+    std::vector<VersionedProfile> fresh;
+    if (!inner.loadVersionedProfiles(cards, fresh)) return false;
+    rows = (int64_t)fresh.size();
+    return WarmCacheFile::write(path, std::move(fresh));
+}
+
+std::string CachedLedger::getUserInfo(const std::string& cardNumber) {
+    if (definitelyMissing(cardNumber)) return "{\"status\":\"error\",\"message\":\"用户不存在\"}";
+    AccountProfile profile;
+    if (cachedProfile(cardNumber, profile)) return formatUserInfo(cardNumber, profile);
+    // 不存在或数据库错误，交给后端生成对应的错误信息
+    return inner.getUserInfo(cardNumber);
+}
+
+double CachedLedger::getBalance(const std::string& cardNumber) {
+    AccountProfile profile;
+    if (loadAccountProfile(cardNumber, profile)) return fromCents(profile.balanceCents);
+    return -1.0;
+}
+
+bool CachedLedger::deposit(const std::string& cardNumber, double amount) {
+    accounts.beginWrite(cardNumber);
+    bool ok = inner.deposit(cardNumber, amount);
+    accounts.endWrite(cardNumber, [&](AccountProfile& p) {
+        if (ok) p.balanceCents += toCents(amount);
+        return true;
+    });
+    return ok;
+}
+
+bool CachedLedger::withdraw(const std::string& cardNumber, double amount) {
+    accounts.beginWrite(cardNumber);
+    bool ok = inner.withdraw(cardNumber, amount);
+    accounts.endWrite(cardNumber, [&](AccountProfile& p) {
+        if (ok) p.balanceCents -= toCents(amount);
+        return true;
+    });
+    return ok;
+}
+
+bool CachedLedger::transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) {
+    // 收款卡号输错是最常见的失败，不必开事务
+    if (definitelyMissing(to_card) || definitelyMissing(from_card)) return false;
+    accounts.beginWrite(from_card);
+    accounts.beginWrite(to_card);
+    bool ok = inner.transfer(from_card, to_card, amount, message, is_anonymous);
+    accounts.endWrite(from_card, [&](AccountProfile& p) {
+        if (ok) p.balanceCents -= toCents(amount);
+        return true;
+    });
+    accounts.endWrite(to_card, [&](AccountProfile& p) {
+        if (ok) p.balanceCents += toCents(amount);
+        return true;
+    });
+    return ok;
+}
+
+void CachedLedger::transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) {
+    ok.assign(lines.size(), false);
+    if (definitelyMissing(from_card)) return;
+    // 过滤器能否定的收款卡直接判失败，不交给后端
+    std::vector<TransferLine> forward;
+    std::vector<size_t> index;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (definitelyMissing(lines[i].toCard)) continue;
+        forward.push_back(lines[i]);
+        index.push_back(i);
+    }
+    accounts.beginWrite(from_card);
+    for (const auto& line : forward) accounts.beginWrite(line.toCard);
+    std::vector<bool> done;
+    inner.transferBatch(from_card, forward, is_anonymous, done);
+    int64_t debit = 0;
+    for (size_t j = 0; j < forward.size(); j++) {
+        if (done[j]) debit += toCents(forward[j].amount);
+        accounts.endWrite(forward[j].toCard, [&](AccountProfile& p) {
+            if (done[j]) p.balanceCents += toCents(forward[j].amount);
+            return true;
+        });
+        ok[index[j]] = done[j];
+    }
+    accounts.endWrite(from_card, [&](AccountProfile& p) {
+        p.balanceCents -= debit;
+        return true;
+    });
+}
+
+bool CachedLedger::updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) {
+    accounts.beginWrite(cardNumber);
+    names.beginWrite(cardNumber);
+    bool ok = inner.updateUserInfo(cardNumber, name, idCard, phone, address);
+    accounts.endWrite(cardNumber, [&](AccountProfile& p) {
+        if (ok) {
+            p.name = name; p.idCard = idCard; p.phone = phone; p.address = address;
+        }
+        return true;
+    });
+    names.endWrite(cardNumber, [&](std::string&) { return !ok; });
+    return ok;
+}
+
+bool CachedLedger::deleteAccount(const std::string& cardNumber) {
+    accounts.beginWrite(cardNumber);
+    names.beginWrite(cardNumber);
+    bool ok = inner.deleteAccount(cardNumber);
+    accounts.endWrite(cardNumber, [&](AccountProfile&) { return !ok; });
+    names.endWrite(cardNumber, [&](std::string&) { return !ok; });
+    if (ok && cardFilter) cardFilter->remove(cardNumber);
+    return ok;
+}
+
+bool CachedLedger::isCardNumberExists(const std::string& cardNumber) {
+    if (definitelyMissing(cardNumber)) return false;
+    bool exists = inner.isCardNumberExists(cardNumber);
+    if (!exists && cardFilter) filterFalsePositives++;
+    return exists;
+}
+
+bool CachedLedger::createAccount(const std::string& name, const std::string& idCard,
+                                 const std::string& phone, const std::string& address,
+                                 const std::string& cardNumber, const std::string& password,
+                                 double initialDeposit) {
+    // 先加入过滤器再提交，避免新卡刚开户时被误判为不存在
+    if (cardFilter) cardFilter->add(cardNumber);
+    bool ok = inner.createAccount(name, idCard, phone, address, cardNumber, password, initialDeposit);
+    // 失败且卡号确实不存在时才撤回；卡号已存在导致的失败保留计数，只会多报“可能存在”
+    if (!ok && cardFilter && !inner.isCardNumberExists(cardNumber)) cardFilter->remove(cardNumber);
+    if (ok) recordCreated(cardNumber);
+    return ok;
+}
+
+void CachedLedger::createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) {
+    if (cardFilter) {
+        for (const auto& a : rows) cardFilter->add(a.cardNumber);
+    }
+    inner.createAccounts(rows, created);
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (created[i]) recordCreated(rows[i].cardNumber);
+    }
+    if (!cardFilter) return;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (!created[i] && !inner.isCardNumberExists(rows[i].cardNumber)) cardFilter->remove(rows[i].cardNumber);
+    }
+}
+
+void CachedLedger::recordCreated(const std::string& cardNumber) {
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    if (trackingCreated) createdCards.push_back(cardNumber);
+}
+
+void CachedLedger::beginHandoff(bool incoming) {
+    if (incoming) {
+        bypassCache = true;
+        bypassFilter = cardFilter != nullptr;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    trackingCreated = true;
+    createdCards.clear();
+}
+
+std::string CachedLedger::exportWarmState() {
+    std::string out;
+    std::unordered_set<std::string> seen;
+    accounts.forEach([&](const std::string& card, const AccountProfile&) {
+        seen.insert(card);
+        out += "H " + card + "\n";
+    });
+    names.forEach([&](const std::string& card, const std::string&) {
+        if (!seen.count(card)) out += "H " + card + "\n";
+    });
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    for (const auto& card : createdCards) out += "N " + card + "\n";
+    trackingCreated = false;
+    createdCards.clear();
+    return out;
+}
+
+void CachedLedger::finishHandoff(const std::string& state, bool complete) {
+    std::vector<std::string> hot;
+    std::istringstream in(state);
+    std::string tag, card;
+    size_t created = 0;
+    while (in >> tag >> card) {
+        if (tag == "H") {
+            hot.push_back(card);
+        } else if (tag == "N" && cardFilter) {
+            cardFilter->add(card);
+            created++;
+        }
+    }
+    // 没收到旧进程新开的卡号时过滤器可能漏掉这些卡，宁可一直查库
+    if (complete) {
+        bypassFilter = false;
+    } else if (bypassFilter) {
+        std::cerr << "热重启: 没有收到旧进程交接期间新开的卡号，卡号过滤器停用" << std::endl;
+    }
+    bypassCache = false;
+    auto begin = std::chrono::steady_clock::now();
+    preload(hot, 4);
+    std::cout << "热重启: 补入新开卡号 " << created << " 个, 预热缓存 " << hot.size() << " 张卡, 用时 "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() << "ms" << std::endl;
+}
+
+bool CachedLedger::prepareAll() {
+    return inner.prepareAll();
+}
+
+bool CachedLedger::recentCards(size_t limit, std::vector<std::string>& out) {
+    return inner.recentCards(limit, out);
+}
+
+bool CachedLedger::loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) {
+    return inner.loadVersionedProfiles(cards, out);
+}
+
+bool CachedLedger::loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) {
+    return inner.loadCardVersions(cards, out);
+}
+
+bool CachedLedger::scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) {
+    return inner.scanCardNumbers(partition, partitions, fn);
+}
+
+// 以下操作不影响缓存内容，直接交给后端
+
+std::string CachedLedger::getTransactionHistory(const std::string& cardNumber) {
+    return inner.getTransactionHistory(cardNumber);
+}
+
+std::unique_ptr<TransactionCursor> CachedLedger::openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) {
+    return inner.openTransactionCursor(cardNumber, from, to);
+}
+
+std::string CachedLedger::getUserMessages(const std::string& card_number) {
+    return inner.getUserMessages(card_number);
+}
+
+bool CachedLedger::markMessageRead(const std::string& card_number, int message_id) {
+    return inner.markMessageRead(card_number, message_id);
+}
+
+bool CachedLedger::sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) {
+    return inner.sendSystemMessage(to_card, title, content);
+}
+
+bool CachedLedger::verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) {
+    return inner.verifyIdentity(cardNumber, name, phone);
+}
+
+bool CachedLedger::updatePassword(const std::string& cardNumber, const std::string& newPassword) {
+    return inner.updatePassword(cardNumber, newPassword);
+}
+
+bool CachedLedger::checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) {
+    return inner.checkAccountForDeletion(cardNumber, name, phone, outBalance);
+}
+
+bool CachedLedger::reserveSequence(const std::string& name, int64_t count, int64_t& first) {
+    return inner.reserveSequence(name, count, first);
+}
+
+bool CachedLedger::scanStatementPartition(int partition, int partitions, const std::string& since,
+                                          const std::function<void(const StatementScanRow&)>& fn) {
+    return inner.scanStatementPartition(partition, partitions, since, fn);
+}
+
+bool CachedLedger::saveStatementSummaries(const std::vector<StatementSummary>& rows) {
+    return inner.saveStatementSummaries(rows);
+}
+
+bool CachedLedger::rollDailyBalances(const std::string& today, int64_t& rows) {
+    return inner.rollDailyBalances(today, rows);
+}
+
+bool CachedLedger::balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) {
+    if (definitelyMissing(cardNumber)) return false;
+    return inner.balanceAsOf(cardNumber, asOf, cents);
+}
+
+bool CachedLedger::rollupSpending(int64_t& rows) {
+    return inner.rollupSpending(rows);
+}
+
+bool CachedLedger::loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                                std::vector<SpendingBucket>& out) {
+    if (definitelyMissing(cardNumber)) return false;
+    return inner.loadSpending(cardNumber, monthly, from, to, out);
+}
@@ -0,0 +1,85 @@
+#include "../include/CardAllocator.h"
+#include "../include/LedgerStore.h"
+#include <iostream>
+#include <algorithm>
+
+CardAllocator::CardAllocator(LedgerStore& store, const std::string& bin, int64_t blockSize)
+    : store(store), bin(bin), blockSize(blockSize > 0 ? blockSize : 1) {
+    maxSerial = 1;
+    for (size_t i = bin.size() + 1; i < 16; i++) maxSerial *= 10;
+    maxSerial -= 1;
+}
+
+char CardAllocator::luhnDigit(const std::string& digits) {
+    // 从右往左，紧挨校验位的那一位开始隔位乘 2
+    int sum = 0;
+    bool dbl = true;
+    for (auto it = digits.rbegin(); it != digits.rend(); ++it) {
+        int d = *it - '0';
+        if (dbl) {
+            d *= 2;
+            if (d > 9) d -= 9;
+        }
+        sum += d;
+        dbl = !dbl;
+    }
+    return (char)('0' + (10 - sum % 10) % 10);
+}
+
+bool CardAllocator::luhnValid(const std::string& number) {
+    if (number.size() < 2) return false;
+    for (char c : number) {
+        if (c < '0' || c > '9') return false;
+    }
+    return luhnDigit(number.substr(0, number.size() - 1)) == number.back();
+}
+
+bool CardAllocator::wellFormed(const std::string& number) {
+    if (number.size() < 16 || number.size() > 19) return false;
+    for (char c : number) {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
+
+std::string CardAllocator::format(int64_t serial) const {
+    std::string digits = std::to_string(serial);
+    std::string body = bin + std::string(15 - bin.size() - digits.size(), '0') + digits;
+    return body + luhnDigit(body);
+}
+
+bool CardAllocator::refill(const Block* seen) {
+    std::lock_guard<std::mutex> guard(refillMutex);
+    if (std::atomic_load(&current).get() != seen) return true; // 其他线程已经换过块
+    int64_t first = 0;
+    if (!store.reserveSequence("card", blockSize, first)) {
+        std::cerr << "预留卡号段失败" << std::endl;
+        return false;
+    }
+    if (first > maxSerial) {
+        std::cerr << "卡号段已用尽: BIN " << bin << std::endl;
+        return false;
+    }
+    std::atomic_store(&current, std::make_shared<Block>(first, std::min(first + blockSize, maxSerial + 1)));
+    blocksReserved++;
+    return true;
+}
+
+std::string CardAllocator::allocate() {
+    while (true) {
+        std::shared_ptr<Block> block = std::atomic_load(&current);
+        int64_t serial = block ? block->next.fetch_add(1) : 0;
+        if (!block || serial >= block->end) {
+            if (!refill(block.get())) return "";
+            continue;
+        }
+        std::string card = format(serial);
+        // 旧数据里可能有客户端自选的同号卡；有卡号过滤器时这一步通常不用查库
+        if (store.isCardNumberExists(card)) {
+            skipped++;
+            continue;
+        }
+        allocated++;
+        return card;
+    }
+}
@@ -0,0 +1,87 @@
+#include "../include/CardFilter.h"
+#include "../include/LedgerStore.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+CardFilter::CardFilter(size_t expected) {
+    counters = expected * 10;
+    if (counters < 1024) counters = 1024;
+    counters = (counters + 15) / 16 * 16;
+    words.reset(new std::atomic<uint64_t>[counters / 16]);
+    for (size_t i = 0; i < counters / 16; i++) words[i].store(0, std::memory_order_relaxed);
+}
+
+void CardFilter::positions(const std::string& key, size_t out[kHashes]) const {
+    // 双重哈希：h1 + i*h2，h2 用 FNV-1a 且保证为奇数
+    uint64_t h1 = std::hash<std::string>()(key);
+    uint64_t h2 = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        h2 ^= c;
+        h2 *= 1099511628211ULL;
+    }
+    h2 |= 1;
+    for (int i = 0; i < kHashes; i++) out[i] = (size_t)((h1 + (uint64_t)i * h2) % counters);
+}
+
+void CardFilter::adjust(size_t pos, int delta) {
+    std::atomic<uint64_t>& word = words[pos / 16];
+    int shift = (int)(pos % 16) * 4;
+    uint64_t old = word.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t count = (old >> shift) & 0xf;
+        // 计数饱和后不再增减，宁可多报“可能存在”
+        if (count == 0xf || (delta < 0 && count == 0)) return;
+        uint64_t next = (old & ~(0xfULL << shift)) | ((count + delta) << shift);
+        if (word.compare_exchange_weak(old, next, std::memory_order_relaxed)) return;
+    }
+}
+
+bool CardFilter::mightContain(const std::string& cardNumber) const {
+    if (!built.load(std::memory_order_acquire)) return true;
+    size_t pos[kHashes];
+    positions(cardNumber, pos);
+    for (int i = 0; i < kHashes; i++) {
+        if (((words[pos[i] / 16].load(std::memory_order_relaxed) >> ((pos[i] % 16) * 4)) & 0xf) == 0) return false;
+    }
+    return true;
+}
+
+void CardFilter::add(const std::string& cardNumber) {
+    size_t pos[kHashes];
+    positions(cardNumber, pos);
+    for (int i = 0; i < kHashes; i++) adjust(pos[i], 1);
+    keys++;
+}
+
+void CardFilter::remove(const std::string& cardNumber) {
+    size_t pos[kHashes];
+    positions(cardNumber, pos);
+    for (int i = 0; i < kHashes; i++) adjust(pos[i], -1);
+    keys--;
+}
+
+bool CardFilter::build(LedgerStore& store, int threads) {
+    auto start = std::chrono::steady_clock::now();
+    if (threads < 1) threads = 1;
+    std::vector<std::thread> workers;
+    std::atomic<bool> ok{true};
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&, i] {
+            if (!store.scanCardNumbers(i, threads, [this](const std::string& card) { add(card); })) ok = false;
+        });
+    }
+    for (auto& t : workers) t.join();
+    if (!ok) {
+        std::cerr << "卡号过滤器构建失败，存在性检查将直接查询数据库" << std::endl;
+        return false;
+    }
+    built.store(true, std::memory_order_release);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "卡号过滤器已建立: " << keys.load() << " 个卡号, " << threads << " 个线程, 用时 " << ms << "ms" << std::endl;
+    if (keys.load() * 10 > counters) {
+        std::cerr << "卡号数超过过滤器预计容量，误判率会升高，请调大 BANK_CARD_FILTER_CAPACITY" << std::endl;
+    }
+    return true;
+}
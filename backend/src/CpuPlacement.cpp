@@ -0,0 +1,218 @@
+#include "../include/CpuPlacement.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace {
+
+// <numaif.h> 里的 MPOL_DEFAULT、MPOL_LOCAL；直接走系统调用，不依赖 libnuma
+const int kMpolDefault = 0;
+const int kMpolLocal = 4;
+
+bool parseInt(const std::string& text, int& out) {
+    if (text.empty() || text.size() > 6 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    out = atoi(text.c_str());
+    return true;
+}
+
+// 解析 sysfs 里 "0-3,8-11" 格式的 CPU 列表
+std::vector<int> parseRanges(const std::string& text) {
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        size_t dash = part.find('-');
+        int lo, hi;
+        if (dash == std::string::npos) {
+            if (!parseInt(part, lo)) continue;
+            hi = lo;
+        } else if (!parseInt(part.substr(0, dash), lo) || !parseInt(part.substr(dash + 1), hi)) {
+            continue;
+        }
+        for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+bool setAffinity(int cpuCount, const int* cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < cpuCount; i++) CPU_SET(cpus[i], &set);
+    // pid 为 0 时只作用于调用线程
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+}
+
+CpuPlacement::Options CpuPlacement::Options::fromEnv() {
+    Options o;
+    if (const char* v = getenv("BANK_IO_THREADS")) o.ioThreads = std::max(0, atoi(v));
+    if (const char* v = getenv("BANK_DB_THREADS")) o.dbThreads = std::max(0, atoi(v));
+    if (const char* v = getenv("BANK_IO_CPUS")) o.ioCpus = v;
+    if (const char* v = getenv("BANK_BACKGROUND_CPUS")) o.backgroundCpus = v;
+    return o;
+}
+
+CpuPlacement::CpuPlacement(const Options& options) : options(options) {}
+
+bool CpuPlacement::init(std::string& error) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) allowed.push_back(c);
+        }
+    }
+    for (int node = 0;; node++) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string line;
+        if (!in || !std::getline(in, line)) break;
+        nodes.push_back(parseRanges(line));
+    }
+    if (nodes.empty()) nodes.push_back(allowed);
+
+    if (!parseList(options.ioCpus, io, error) || !parseList(options.backgroundCpus, background, error)) return false;
+    if (options.backgroundCpus.empty() && !io.empty()) {
+        for (int c : allowed) {
+            if (!std::binary_search(io.begin(), io.end(), c)) background.push_back(c);
+        }
+    }
+    return true;
+}
+
+bool CpuPlacement::parseList(const std::string& text, std::vector<int>& out, std::string& error) const {
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        if (part.empty()) continue;
+        int lo, hi;
+        size_t dash = part.find('-');
+        if (part.compare(0, 4, "node") == 0) {
+            int node;
+            if (!parseInt(part.substr(4), node) || node >= (int)nodes.size()) {
+                error = "没有 NUMA 节点 " + part;
+                return false;
+            }
+            // 只取本节点中本进程能用的 CPU
+            for (int c : nodes[node]) {
+                if (std::binary_search(allowed.begin(), allowed.end(), c)) out.push_back(c);
+            }
+            continue;
+        }
+        if (dash == std::string::npos) {
+            if (!parseInt(part, lo)) {
+                error = "CPU 列表格式不对: " + part;
+                return false;
+            }
+            hi = lo;
+        } else if (!parseInt(part.substr(0, dash), lo) || !parseInt(part.substr(dash + 1), hi) || lo > hi) {
+            error = "CPU 列表格式不对: " + part;
+            return false;
+        }
+        for (int c = lo; c <= hi; c++) out.push_back(c);
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    for (int c : out) {
+        if (!std::binary_search(allowed.begin(), allowed.end(), c)) {
+            error = "CPU " + std::to_string(c) + " 不在本进程可用的范围内";
+            return false;
+        }
+    }
+    return true;
+}
+
+void CpuPlacement::restrictToWorker(int index, int count) {
+    if (io.empty() || count <= 1) return;
+    size_t n = io.size();
+    if ((size_t)count >= n) {
+        io = {io[(size_t)index % n]};
+        return;
+    }
+    size_t begin = n * (size_t)index / (size_t)count;
+    size_t end = n * (size_t)(index + 1) / (size_t)count;
+    io = std::vector<int>(io.begin() + begin, io.begin() + end);
+}
+
+void CpuPlacement::pinBackground() {
+    if (background.empty()) return;
+    if (!setAffinity((int)background.size(), background.data())) {
+        std::cerr << "后台线程绑核失败: " << strerror(errno) << std::endl;
+        return;
+    }
+    if (nodes.size() > 1) syscall(SYS_set_mempolicy, kMpolLocal, nullptr, 0);
+}
+
+void CpuPlacement::pinIoThread(int index) const {
+    if (io.empty()) {
+        // 没有指定 I/O CPU 时不绑核，但 I/O 线程由已绑到后台 CPU 的主线程创建，要恢复成整个可用范围和默认内存策略
+        if (background.empty() || allowed.empty()) return;
+        if (!setAffinity((int)allowed.size(), allowed.data())) {
+            std::cerr << "I/O 线程 " << index << " 恢复 CPU 范围失败: " << strerror(errno) << std::endl;
+            return;
+        }
+        if (nodes.size() > 1) syscall(SYS_set_mempolicy, kMpolDefault, nullptr, 0);
+        return;
+    }
+    int cpu = io[(size_t)index % io.size()];
+    if (!setAffinity(1, &cpu)) {
+        std::cerr << "I/O 线程 " << index << " 绑定 CPU " << cpu << " 失败: " << strerror(errno) << std::endl;
+        return;
+    }
+    // 内核太旧不支持时保持原来的策略
+    if (nodes.size() > 1) syscall(SYS_set_mempolicy, kMpolLocal, nullptr, 0);
+}
+
+int CpuPlacement::ioThreads(int fallback) const {
+    if (options.ioThreads > 0) return options.ioThreads;
+    if (!io.empty()) return (int)io.size();
+    return std::max(1, fallback);
+}
+
+int CpuPlacement::nodeOf(int cpu) const {
+    for (size_t n = 0; n < nodes.size(); n++) {
+        if (std::find(nodes[n].begin(), nodes[n].end(), cpu) != nodes[n].end()) return (int)n;
+    }
+    return -1;
+}
+
+std::string CpuPlacement::describe(const std::vector<int>& cpus, bool withNode) const {
+    std::string out;
+    size_t i = 0;
+    while (i < cpus.size()) {
+        // 同一节点内的连续编号合成一段
+        size_t j = i;
+        int node = nodeOf(cpus[i]);
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1 && nodeOf(cpus[j + 1]) == node) j++;
+        if (!out.empty()) out += ", ";
+        out += std::to_string(cpus[i]);
+        if (j > i) out += "-" + std::to_string(cpus[j]);
+        if (withNode && nodes.size() > 1) out += "（node" + std::to_string(node) + "）";
+        i = j + 1;
+    }
+    return out;
+}
+
+std::string CpuPlacement::report(int ioThreadCount, int dbLimit) const {
+    std::ostringstream out;
+    out << "CPU 拓扑: " << nodes.size() << " 个 NUMA 节点";
+    for (size_t n = 0; n < nodes.size(); n++) out << ", node" << n << ": " << describe(nodes[n], false);
+    out << "; 本进程可用 " << describe(allowed) << "\n";
+    out << "I/O 线程 " << ioThreadCount << " 个, ";
+    if (io.empty()) {
+        out << "不绑核";
+    } else {
+        out << "依次绑定 " << describe(io);
+        if ((size_t)ioThreadCount > io.size()) out << "（线程比核多，轮流复用）";
+    }
+    out << "\n后台线程: " << (background.empty() ? "不绑核" : describe(background)) << "\n";
+    out << "后端并发上限: " << dbLimit << "\n";
+    return out.str();
+}
@@ -1,16 +1,151 @@
 #include "../include/DatabaseManager.h"
-#include <sstream>
-#include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <map>
+#include <tuple>
 
-std::string escapeJson(const std::string& s) {
-    std::ostringstream o;
-    for (auto c : s) {
-        if (c == '"') o << "\\\"";
-        else if (c == '\\') o << "\\\\";
-        else if ((unsigned char)c < 0x20) o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c;
-        else o << c;
+namespace {
+
+// "(?, ?, ?),(?, ?, ?)..." 形式的多行占位符
+std::string valuesList(const std::string& row, size_t count) {
+    std::string out;
+    out.reserve((row.size() + 1) * count);
+    for (size_t i = 0; i < count; i++) {
+        if (i) out += ',';
+        out += row;
+    }
+    return out;
+}
+
+// 只允许日期时间和卡号里出现的字符，可以直接拼进 SQL
+bool plainValue(const std::string& v) {
+    return v.find_first_not_of("0123456789-: ") == std::string::npos;
+}
+
+// 消费统计追尾时，空号后面的流水写入超过这么久仍没有补上，就认为占号的事务已回滚
+const int kRollupGraceSeconds = 300;
+
+// 主连接上请求路径用到的固定语句，按编号取 SQL；prepareAll 在启动时全部准备好，之后请求直接复用（见 statement）
+enum StatementId {
+    kVerifyLogin,
+    kUserInfo,
+    kAccountProfile,
+    kReserveInit,
+    kReserveNext,
+    kBalance,
+    kDepositUpdate,
+    kCardBalance,
+    kDepositLog,
+    kWithdrawCheck,
+    kWithdrawUpdate,
+    kWithdrawLog,
+    kHistory,
+    kCardId,
+    kSnapshotBefore,
+    kBalanceAfter,
+    kSpending,
+    kCreateUser,
+    kCreateCard,
+    kOpenLog,
+    kLockPayer,
+    kDebitCard,
+    kCreditCard,
+    kTransferOutLog,
+    kTransferInLog,
+    kTransferMessage,
+    kUserName,
+    kMessages,
+    kMarkRead,
+    kSystemMessage,
+    kUserIdByCard,
+    kUpdateUser,
+    kBumpUserCards,
+    kVerifyIdentity,
+    kUpdatePassword,
+    kDeletionCheck,
+    kLockForDelete,
+    kDeleteMessages,
+    kDeleteTransactions,
+    kDeleteCard,
+    kDeleteUser,
+    kStatementCount
+};
+
+const char* const kStatements[kStatementCount] = {
+    "SELECT card_id FROM cards WHERE card_number = ? AND password_hash = MD5(?) AND status = 'active'",
+    "SELECT u.name, u.id_card, u.phone, u.address, c.card_number, c.balance, c.create_time FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?",
+    "SELECT u.name, u.id_card, u.phone, u.address, c.balance, c.create_time FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?",
+    "INSERT IGNORE INTO sequences (name, next_value) VALUES (?, 1)",
+    "UPDATE sequences SET next_value = LAST_INSERT_ID(next_value + ?) WHERE name = ?",
+    "SELECT balance FROM cards WHERE card_number = ?",
+    "UPDATE cards SET balance = balance + ?, version = version + 1 WHERE card_number = ?",
+    "SELECT card_id, balance FROM cards WHERE card_number = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'deposit', ?, ?, '存款')",
+    "SELECT balance, card_id FROM cards WHERE card_number = ? FOR UPDATE",
+    "UPDATE cards SET balance = balance - ?, version = version + 1 WHERE card_number = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) SELECT card_id, 'withdraw', ?, balance, '取款' FROM cards WHERE card_number = ?",
+    "SELECT t.type, t.amount, t.balance_after, t.description, t.create_time FROM transactions t JOIN cards c ON t.card_id = c.card_id WHERE c.card_number = ? ORDER BY t.create_time DESC LIMIT 20",
+    "SELECT card_id FROM cards WHERE card_number = ?",
+    "SELECT snapshot_date, balance FROM daily_balances WHERE card_id = ? AND snapshot_date < ? ORDER BY snapshot_date DESC LIMIT 1",
+    "SELECT balance_after FROM transactions WHERE card_id = ? AND create_time > ? AND create_time <= ? ORDER BY create_time DESC, transaction_id DESC LIMIT 1",
+    "SELECT c.card_id, r.period, r.category, r.total, r.count FROM cards c LEFT JOIN spending_rollups r ON r.card_id = c.card_id AND r.granularity = ? AND r.period >= ? AND r.period <= ? WHERE c.card_number = ? ORDER BY r.period",
+    "INSERT INTO users (name, id_card, phone, address) VALUES (?, ?, ?, ?)",
+    "INSERT INTO cards (user_id, card_number, password_hash, balance) VALUES (?, ?, MD5(?), ?)",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'open', ?, ?, '开户')",
+    "SELECT card_id, balance FROM cards WHERE card_number = ? FOR UPDATE",
+    "UPDATE cards SET balance = balance - ?, version = version + 1 WHERE card_id = ?",
+    "UPDATE cards SET balance = balance + ?, version = version + 1 WHERE card_id = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'withdraw', ?, (SELECT balance FROM cards WHERE card_id=?), ?)",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'deposit', ?, (SELECT balance FROM cards WHERE card_id=?), ?)",
+    "INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, ?, 'transfer', ?, ?)",
+    "SELECT u.name FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?",
+    "SELECT id, sender_name, type, amount, content, is_read, create_time FROM messages WHERE recipient_card = ? ORDER BY create_time DESC",
+    "UPDATE messages SET is_read = 1 WHERE id = ? AND recipient_card = ?",
+    "INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, '系统通知', 'system', 0, ?)",
+    "SELECT user_id FROM cards WHERE card_number = ?",
+    "UPDATE users SET name = ?, id_card = ?, phone = ?, address = ? WHERE user_id = ?",
+    "UPDATE cards SET version = version + 1 WHERE user_id = ?",
+    "SELECT c.card_id FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?",
+    "UPDATE cards SET password_hash = MD5(?) WHERE card_number = ?",
+    "SELECT c.balance FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?",
+    "SELECT card_id, user_id FROM cards WHERE card_number = ? FOR UPDATE",
+    "DELETE FROM messages WHERE recipient_card = ?",
+    "DELETE FROM transactions WHERE card_id = ?",
+    "DELETE FROM cards WHERE card_id = ?",
+    "DELETE FROM users WHERE user_id = ?",
+};
+
+// 导出游标独占一条连接，结果集以 TYPE_FORWARD_ONLY 逐行从服务器读取而不是整体缓存
+class MysqlTransactionCursor : public TransactionCursor {
+public:
+    MysqlTransactionCursor(std::unique_ptr<sql::Connection> conn, const std::string& query) : conn(std::move(conn)) {
+        stmt.reset(this->conn->createStatement());
+        stmt->setResultSetType(sql::ResultSet::TYPE_FORWARD_ONLY);
+        res.reset(stmt->executeQuery(query));
+    }
+
+    bool next(TransactionRow& row) override {
+        try {
+            if (!res->next()) return false;
+            row.type = res->getString(1);
+            row.amountCents = toCents(res->getDouble(2));
+            row.balanceAfterCents = toCents(res->getDouble(3));
+            row.description = res->getString(4);
+            row.createTime = res->getString(5);
+            return true;
+        } catch (sql::SQLException& e) {
+            std::cerr << "导出读取失败: " << e.what() << std::endl;
+            return false;
+        }
     }
-    return o.str();
+
+private:
+    std::unique_ptr<sql::Connection> conn;
+    std::unique_ptr<sql::Statement> stmt;
+    std::unique_ptr<sql::ResultSet> res;
+};
+
 }
 
 DatabaseManager::DatabaseManager() {
@@ -23,6 +158,7 @@ DatabaseManager::DatabaseManager() {
 }
 
 DatabaseManager::~DatabaseManager() {
+    statements.clear();
     if (connection) connection->close();
 }
 
@@ -31,10 +167,17 @@ DatabaseManager& DatabaseManager::getInstance() {
     return instance;
 }
 
+std::unique_ptr<sql::Connection> DatabaseManager::openConnection() {
+    std::unique_ptr<sql::Connection> conn(driver->connect("tcp://127.0.0.1:3306", "bank_admin", "BankAdmin123!"));
+    conn->setSchema("bank_system");
+    return conn;
+}
+
 void DatabaseManager::connect() {
     try {
-        connection.reset(driver->connect("tcp://127.0.0.1:3306", "bank_admin", "BankAdmin123!"));
-        connection->setSchema("bank_system");
+        // 预编译语句属于旧连接，换连接时一起作废，用到时在新连接上重新准备
+        statements.clear();
+        connection = openConnection();
         std::cout << "数据库连接成功!" << std::endl;
     } catch (sql::SQLException& e) {
         std::cerr << "连接失败: " << e.what() << std::endl;
@@ -51,9 +194,7 @@ bool DatabaseManager::verifyLogin(const std::string& cardNumber, const std::stri
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            connection->prepareStatement("SELECT card_id FROM cards WHERE card_number = ? AND password_hash = MD5(?) AND status = 'active'")
-        );
+        sql::PreparedStatement* pstmt = statement(kVerifyLogin);
         pstmt->setString(1, cardNumber);
         pstmt->setString(2, password);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
@@ -66,33 +207,200 @@ std::string DatabaseManager::getUserInfo(const std::string& cardNumber) {
     try {
         if (!isConnected()) connect();
         if (!connection) return "{\"status\":\"error\",\"message\":\"数据库未连接\"}";
-        std::unique_ptr<sql::PreparedStatement> pstmt(
-            connection->prepareStatement("SELECT u.name, u.id_card, u.phone, u.address, c.card_number, c.balance, c.create_time FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?")
-        );
+        sql::PreparedStatement* pstmt = statement(kUserInfo);
         pstmt->setString(1, cardNumber);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         if (res->next()) {
-            std::stringstream ss;
-            ss << "{\"status\":\"success\","
-               << "\"name\":\"" << escapeJson(res->getString("name")) << "\","
-               << "\"id_card\":\"" << escapeJson(res->getString("id_card")) << "\","
-               << "\"card_number\":\"" << res->getString("card_number") << "\","
-               << "\"phone\":\"" << res->getString("phone") << "\","
-               << "\"address\":\"" << escapeJson(res->getString("address")) << "\","
-               << "\"balance\":" << std::fixed << std::setprecision(2) << res->getDouble("balance") << ","
-               << "\"create_time\":\"" << res->getString("create_time") << "\"}";
-            return ss.str();
+            ArenaString out;
+            out.reserve(256);
+            out += "{\"status\":\"success\",\"name\":\"";
+            appendEscapedJson(out, res->getString("name"));
+            out += "\",\"id_card\":\"";
+            appendEscapedJson(out, res->getString("id_card"));
+            out += "\",\"card_number\":\"";
+            appendText(out, res->getString("card_number"));
+            out += "\",\"phone\":\"";
+            appendText(out, res->getString("phone"));
+            out += "\",\"address\":\"";
+            appendEscapedJson(out, res->getString("address"));
+            out += "\",\"balance\":";
+            appendNumber(out, "%.2f", (double)res->getDouble("balance"));
+            out += ",\"create_time\":\"";
+            appendText(out, res->getString("create_time"));
+            out += "\"}";
+            return std::string(out.data(), out.size());
         }
         return "{\"status\":\"error\",\"message\":\"用户不存在\"}";
     } catch (...) { return "{\"status\":\"error\",\"message\":\"数据库错误\"}"; }
 }
 
+bool DatabaseManager::loadAccountProfile(const std::string& cardNumber, AccountProfile& out) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        sql::PreparedStatement* pstmt = statement(kAccountProfile);
+        pstmt->setString(1, cardNumber);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (!res->next()) return false;
+        out.name = res->getString("name");
+        out.idCard = res->getString("id_card");
+        out.phone = res->getString("phone");
+        out.address = res->getString("address");
+        out.balanceCents = toCents(res->getDouble("balance"));
+        out.createTime = res->getString("create_time");
+        return true;
+    } catch (...) { return false; }
+}
+
+sql::PreparedStatement* DatabaseManager::statement(int id) {
+    if (statements.empty()) statements.resize(kStatementCount);
+    std::unique_ptr<sql::PreparedStatement>& stmt = statements[id];
+    if (!stmt) stmt.reset(connection->prepareStatement(kStatements[id]));
+    return stmt.get();
+}
+
+bool DatabaseManager::prepareAll() {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        for (int id = 0; id < kStatementCount; id++) statement(id);
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "预编译失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::recentCards(size_t limit, std::vector<std::string>& out) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        // 只看最近 limit 的几倍条流水，不扫全表
+        std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement(
+            "SELECT c.card_number FROM (SELECT card_id, MAX(transaction_id) AS last_id FROM "
+            "(SELECT card_id, transaction_id FROM transactions ORDER BY transaction_id DESC LIMIT ?) t GROUP BY card_id) r "
+            "JOIN cards c ON c.card_id = r.card_id ORDER BY r.last_id DESC LIMIT ?"));
+        pstmt->setInt64(1, (int64_t)limit * 4);
+        pstmt->setInt64(2, (int64_t)limit);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) out.push_back(res->getString(1));
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "热点卡查询失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) {
+    const size_t chunk = 500;
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        for (size_t begin = 0; begin < cards.size(); begin += chunk) {
+            size_t n = std::min(chunk, cards.size() - begin);
+            std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement(
+                "SELECT c.card_number, c.card_id, c.version, u.name, u.id_card, u.phone, u.address, c.balance, c.create_time "
+                "FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number IN (" + valuesList("?", n) + ")"));
+            for (size_t i = 0; i < n; i++) pstmt->setString((int)i + 1, cards[begin + i]);
+            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+            while (res->next()) {
+                VersionedProfile v;
+                v.row.cardNumber = res->getString("card_number");
+                v.row.cardId = res->getInt64("card_id");
+                v.row.version = res->getInt64("version");
+                v.profile.name = res->getString("name");
+                v.profile.idCard = res->getString("id_card");
+                v.profile.phone = res->getString("phone");
+                v.profile.address = res->getString("address");
+                v.profile.balanceCents = toCents(res->getDouble("balance"));
+                v.profile.createTime = res->getString("create_time");
+                out.push_back(std::move(v));
+            }
+        }
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "读取卡片版本失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) {
+    const size_t chunk = 500;
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        for (size_t begin = 0; begin < cards.size(); begin += chunk) {
+            size_t n = std::min(chunk, cards.size() - begin);
+            std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement(
+                "SELECT card_number, card_id, version FROM cards WHERE card_number IN (" + valuesList("?", n) + ")"));
+            for (size_t i = 0; i < n; i++) pstmt->setString((int)i + 1, cards[begin + i]);
+            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+            while (res->next()) {
+                CardVersion v;
+                v.cardNumber = res->getString(1);
+                v.cardId = res->getInt64(2);
+                v.version = res->getInt64(3);
+                out.push_back(std::move(v));
+            }
+        }
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "读取卡片版本失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) {
+    // 扫描线程各用一条独立连接，不占用主连接的锁
+    driver->threadInit();
+    struct ThreadEnd { sql::Driver* d; ~ThreadEnd() { d->threadEnd(); } } threadEnd{driver};
+    try {
+        std::unique_ptr<sql::Connection> conn = openConnection();
+        std::unique_ptr<sql::PreparedStatement> pstmt(conn->prepareStatement("SELECT card_number FROM cards WHERE card_id % ? = ?"));
+        pstmt->setInt(1, partitions);
+        pstmt->setInt(2, partition);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        while (res->next()) fn(res->getString(1));
+        conn->close();
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "卡号扫描失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::reserveSequence(const std::string& name, int64_t count, int64_t& first) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        sql::PreparedStatement* init = statement(kReserveInit);
+        init->setString(1, name);
+        init->executeUpdate();
+        // LAST_INSERT_ID(expr) 按连接保存，单条 UPDATE 即可原子地取号
+        sql::PreparedStatement* upd = statement(kReserveNext);
+        upd->setInt64(1, count);
+        upd->setString(2, name);
+        if (upd->executeUpdate() != 1) return false;
+        std::unique_ptr<sql::Statement> stmt(connection->createStatement());
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT LAST_INSERT_ID()"));
+        if (!res->next()) return false;
+        first = res->getInt64(1) - count;
+        return true;
+    } catch (...) { return false; }
+}
+
 double DatabaseManager::getBalance(const std::string& cardNumber) {
     std::lock_guard<std::recursive_mutex> lock(db_mutex);
     try {
         if (!isConnected()) connect();
         if (!connection) return -1.0;
-        std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement("SELECT balance FROM cards WHERE card_number = ?"));
+        sql::PreparedStatement* pstmt = statement(kBalance);
         pstmt->setString(1, cardNumber);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         if (res->next()) return res->getDouble("balance");
@@ -108,17 +416,17 @@ bool DatabaseManager::deposit(const std::string& cardNumber, double amount) {
         connection->setAutoCommit(false);
         int cardId = 0; double newBalance = 0.0;
         {
-            std::unique_ptr<sql::PreparedStatement> upd(connection->prepareStatement("UPDATE cards SET balance = balance + ? WHERE card_number = ?"));
+            sql::PreparedStatement* upd = statement(kDepositUpdate);
             upd->setDouble(1, amount); upd->setString(2, cardNumber);
             if (upd->executeUpdate() == 0) throw sql::SQLException("Card not found");
-            std::unique_ptr<sql::PreparedStatement> sel(connection->prepareStatement("SELECT card_id, balance FROM cards WHERE card_number = ?"));
+            sql::PreparedStatement* sel = statement(kCardBalance);
             sel->setString(1, cardNumber);
             std::unique_ptr<sql::ResultSet> res(sel->executeQuery());
             res->next();
             cardId = res->getInt("card_id");
             newBalance = res->getDouble("balance");
         }
-        std::unique_ptr<sql::PreparedStatement> log(connection->prepareStatement("INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'deposit', ?, ?, '存款')"));
+        sql::PreparedStatement* log = statement(kDepositLog);
         log->setInt(1, cardId); log->setDouble(2, amount); log->setDouble(3, newBalance);
         log->executeUpdate();
         connection->commit(); connection->setAutoCommit(true);
@@ -137,17 +445,17 @@ bool DatabaseManager::withdraw(const std::string& cardNumber, double amount) {
         connection->setAutoCommit(false);
         int cardId = 0;
         {
-            std::unique_ptr<sql::PreparedStatement> check(connection->prepareStatement("SELECT balance, card_id FROM cards WHERE card_number = ? FOR UPDATE"));
+            sql::PreparedStatement* check = statement(kWithdrawCheck);
             check->setString(1, cardNumber);
             std::unique_ptr<sql::ResultSet> res(check->executeQuery());
             if (!res->next()) throw sql::SQLException("Not found");
             if (res->getDouble("balance") < amount) throw sql::SQLException("Low balance");
             cardId = res->getInt("card_id");
         }
-        std::unique_ptr<sql::PreparedStatement> upd(connection->prepareStatement("UPDATE cards SET balance = balance - ? WHERE card_number = ?"));
+        sql::PreparedStatement* upd = statement(kWithdrawUpdate);
         upd->setDouble(1, amount); upd->setString(2, cardNumber);
         upd->executeUpdate();
-        std::unique_ptr<sql::PreparedStatement> log(connection->prepareStatement("INSERT INTO transactions (card_id, type, amount, balance_after, description) SELECT card_id, 'withdraw', ?, balance, '取款' FROM cards WHERE card_number = ?"));
+        sql::PreparedStatement* log = statement(kWithdrawLog);
         log->setDouble(1, amount); log->setString(2, cardNumber);
         log->executeUpdate();
         connection->commit(); connection->setAutoCommit(true);
@@ -163,27 +471,334 @@ std::string DatabaseManager::getTransactionHistory(const std::string& cardNumber
     try {
         if (!isConnected()) connect();
         if (!connection) return "{\"status\":\"error\",\"message\":\"数据库未连接\"}";
-        std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement("SELECT t.type, t.amount, t.balance_after, t.description, t.create_time FROM transactions t JOIN cards c ON t.card_id = c.card_id WHERE c.card_number = ? ORDER BY t.create_time DESC LIMIT 20"));
+        sql::PreparedStatement* pstmt = statement(kHistory);
         pstmt->setString(1, cardNumber);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-        std::stringstream ss; ss << "{\"status\":\"success\",\"transactions\":[";
+        // 逐行拼进请求内存，最后一次拷贝
+        ArenaString out;
+        out.reserve(4096);
+        out += "{\"status\":\"success\",\"transactions\":[";
         bool f = true;
         while (res->next()) {
-            if (!f) ss << ",";
-            ss << "{\"type\":\"" << res->getString("type") << "\",\"amount\":" << std::fixed << std::setprecision(2) << res->getDouble("amount") << ",\"balance_after\":" << std::fixed << std::setprecision(2) << res->getDouble("balance_after") << ",\"description\":\"" << escapeJson(res->getString("description")) << "\",\"create_time\":\"" << res->getString("create_time") << "\"}";
+            if (!f) out += ',';
+            out += "{\"type\":\"";
+            appendText(out, res->getString("type"));
+            out += "\",\"amount\":";
+            appendNumber(out, "%.2f", (double)res->getDouble("amount"));
+            out += ",\"balance_after\":";
+            appendNumber(out, "%.2f", (double)res->getDouble("balance_after"));
+            out += ",\"description\":\"";
+            appendEscapedJson(out, res->getString("description"));
+            out += "\",\"create_time\":\"";
+            appendText(out, res->getString("create_time"));
+            out += "\"}";
             f = false;
         }
-        ss << "]}";
-        return ss.str();
+        out += "]}";
+        return std::string(out.data(), out.size());
     } catch (...) { return "{\"status\":\"error\"}"; }
 }
 
+std::unique_ptr<TransactionCursor> DatabaseManager::openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) {
+    // 只进结果集不支持预编译参数，参数先校验字符集再拼接
+    if (!plainValue(cardNumber) || !plainValue(from) || !plainValue(to)) return nullptr;
+    std::string query = "SELECT t.type, t.amount, t.balance_after, t.description, t.create_time FROM transactions t JOIN cards c ON t.card_id = c.card_id WHERE c.card_number = '" + cardNumber + "'";
+    if (!from.empty()) query += " AND t.create_time >= '" + from + "'";
+    if (!to.empty()) query += " AND t.create_time <= '" + to + "'";
+    query += " ORDER BY t.create_time, t.transaction_id";
+    try {
+        return std::unique_ptr<TransactionCursor>(new MysqlTransactionCursor(openConnection(), query));
+    } catch (sql::SQLException& e) {
+        std::cerr << "打开导出游标失败: " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+bool DatabaseManager::scanStatementPartition(int partition, int partitions, const std::string& since,
+                                             const std::function<void(const StatementScanRow&)>& fn) {
+    if (!plainValue(since)) return false;
+    // 每个分片独占一条连接，单条语句保证余额和流水来自同一个一致性读视图
+    driver->threadInit();
+    struct ThreadEnd { sql::Driver* d; ~ThreadEnd() { d->threadEnd(); } } threadEnd{driver};
+    try {
+        std::unique_ptr<sql::Connection> conn = openConnection();
+        std::unique_ptr<sql::Statement> stmt(conn->createStatement());
+        stmt->setResultSetType(sql::ResultSet::TYPE_FORWARD_ONLY);
+        std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(
+            "SELECT c.card_number, c.balance, t.type, t.amount, t.balance_after, t.description, t.create_time "
+            "FROM cards c LEFT JOIN transactions t ON t.card_id = c.card_id AND t.create_time >= '" + since + "' "
+            "WHERE c.card_id % " + std::to_string(partitions) + " = " + std::to_string(partition) + " "
+            "ORDER BY c.card_id, t.create_time, t.transaction_id"));
+        StatementScanRow row;
+        while (res->next()) {
+            row.cardNumber = res->getString(1);
+            row.balanceCents = toCents(res->getDouble(2));
+            row.hasTransaction = !res->isNull(3);
+            if (row.hasTransaction) {
+                row.txn.type = res->getString(3);
+                row.txn.amountCents = toCents(res->getDouble(4));
+                row.txn.balanceAfterCents = toCents(res->getDouble(5));
+                row.txn.description = res->getString(6);
+                row.txn.createTime = res->getString(7);
+            }
+            fn(row);
+        }
+        conn->close();
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "对账单扫描失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::saveStatementSummaries(const std::vector<StatementSummary>& rows) {
+    const size_t chunk = 500;
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        for (size_t begin = 0; begin < rows.size(); begin += chunk) {
+            size_t end = std::min(rows.size(), begin + chunk);
+            std::unique_ptr<sql::PreparedStatement> upsert(connection->prepareStatement(
+                "INSERT INTO statements (card_number, period, opening_balance, closing_balance, total_credit, total_debit, transaction_count) VALUES "
+                + valuesList("(?, ?, ?, ?, ?, ?, ?)", end - begin)
+                + " ON DUPLICATE KEY UPDATE opening_balance = VALUES(opening_balance), closing_balance = VALUES(closing_balance),"
+                  " total_credit = VALUES(total_credit), total_debit = VALUES(total_debit), transaction_count = VALUES(transaction_count), create_time = NOW()"));
+            int idx = 1;
+            for (size_t i = begin; i < end; i++) {
+                const StatementSummary& r = rows[i];
+                upsert->setString(idx++, r.cardNumber); upsert->setString(idx++, r.period);
+                upsert->setDouble(idx++, fromCents(r.openingCents)); upsert->setDouble(idx++, fromCents(r.closingCents));
+                upsert->setDouble(idx++, fromCents(r.creditCents)); upsert->setDouble(idx++, fromCents(r.debitCents));
+                upsert->setInt64(idx++, r.count);
+            }
+            upsert->executeUpdate();
+        }
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "写入对账单汇总失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::rollDailyBalances(const std::string& today, int64_t& rows) {
+    rows = 0;
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        // 从最后一个快照日的次日做起，每张卡每天取当天最后一条流水的余额
+        std::string from = "1000-01-01";
+        {
+            std::unique_ptr<sql::Statement> stmt(connection->createStatement());
+            std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT DATE_ADD(MAX(snapshot_date), INTERVAL 1 DAY) FROM daily_balances"));
+            if (res->next() && !res->isNull(1)) from = res->getString(1);
+        }
+        std::unique_ptr<sql::PreparedStatement> roll(connection->prepareStatement(
+            "INSERT INTO daily_balances (card_id, snapshot_date, balance) "
+            "SELECT t.card_id, DATE(t.create_time), t.balance_after FROM transactions t "
+            "JOIN (SELECT MAX(transaction_id) AS id FROM transactions WHERE create_time >= ? AND create_time < ? "
+            "      GROUP BY card_id, DATE(create_time)) last ON t.transaction_id = last.id "
+            "ON DUPLICATE KEY UPDATE balance = VALUES(balance)"));
+        roll->setString(1, from);
+        roll->setString(2, today);
+        rows = roll->executeUpdate();
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "日终余额快照失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        int cardId = 0;
+        {
+            sql::PreparedStatement* card = statement(kCardId);
+            card->setString(1, cardNumber);
+            std::unique_ptr<sql::ResultSet> res(card->executeQuery());
+            if (!res->next()) return false;
+            cardId = res->getInt(1);
+        }
+        // asOf 当天的快照是日终余额，只能用前一天及更早的
+        std::string after = "1000-01-01 00:00:00";
+        cents = 0;
+        {
+            sql::PreparedStatement* snap = statement(kSnapshotBefore);
+            snap->setInt(1, cardId);
+            snap->setString(2, asOf.substr(0, 10));
+            std::unique_ptr<sql::ResultSet> res(snap->executeQuery());
+            if (res->next()) {
+                after = res->getString(1) + " 23:59:59";
+                cents = toCents(res->getDouble(2));
+            }
+        }
+        sql::PreparedStatement* delta = statement(kBalanceAfter);
+        delta->setInt(1, cardId);
+        delta->setString(2, after);
+        delta->setString(3, asOf);
+        std::unique_ptr<sql::ResultSet> res(delta->executeQuery());
+        if (res->next()) cents = toCents(res->getDouble(1));
+        return true;
+    } catch (sql::SQLException& e) {
+        std::cerr << "查询历史余额失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DatabaseManager::rollupSpending(int64_t& rows) {
+    const int batch = 10000;
+    const size_t chunk = 500;
+    rows = 0;
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        for (;;) {
+            connection->setAutoCommit(false);
+            int64_t next = 1;
+            {
+                std::unique_ptr<sql::Statement> stmt(connection->createStatement());
+                stmt->executeUpdate("INSERT IGNORE INTO sequences (name, next_value) VALUES ('spending_rollup', 1)");
+                std::unique_ptr<sql::ResultSet> res(stmt->executeQuery("SELECT next_value FROM sequences WHERE name = 'spending_rollup' FOR UPDATE"));
+                if (res->next()) next = res->getInt64(1);
+            }
+            // 按 transaction_id 追尾。自增编号在插入时分配、提交时才可见，别的连接上编号较小的事务可能晚提交，
+            // 所以 next 只推进到“之前的编号都已计入或确定不会再出现”为止，next 之后已计入的编号记在
+            // spending_rollup_seen 里，每次从 next 重新扫描，跳过已计入的
+            std::map<std::tuple<int, char, std::string, int>, std::pair<int64_t, int64_t>> sums;
+            std::vector<int64_t> counted;
+            int seen = 0;
+            {
+                std::unique_ptr<sql::PreparedStatement> tail(connection->prepareStatement(
+                    "SELECT transaction_id, card_id, type, amount, description, create_time FROM transactions t "
+                    "WHERE transaction_id >= ? AND NOT EXISTS (SELECT 1 FROM spending_rollup_seen s WHERE s.transaction_id = t.transaction_id) "
+                    "ORDER BY transaction_id LIMIT ?"));
+                tail->setInt64(1, next);
+                tail->setInt(2, batch);
+                std::unique_ptr<sql::ResultSet> res(tail->executeQuery());
+                while (res->next()) {
+                    counted.push_back(res->getInt64(1));
+                    int category = spendingCategory(res->getString(3), res->getString(5));
+                    std::string time = res->getString(6);
+                    int64_t cents = toCents(res->getDouble(4));
+                    for (char g : {'D', 'M'}) {
+                        auto& sum = sums[std::make_tuple(res->getInt(2), g, time.substr(0, g == 'D' ? 10 : 7), category)];
+                        sum.first += cents;
+                        sum.second++;
+                    }
+                    seen++;
+                }
+            }
+            // 推进 next：越过已计入的编号；遇到空号时，只有它后面那条流水已写入超过 kRollupGraceSeconds 秒，
+            // 才认为占着空号的事务已回滚（或自增步长跳过），否则停在空号处，下次再看
+            int64_t settled = next;
+            {
+                std::unique_ptr<sql::PreparedStatement> walk(connection->prepareStatement(
+                    "SELECT transaction_id, create_time < NOW() - INTERVAL " + std::to_string(kRollupGraceSeconds) + " SECOND, "
+                    "EXISTS (SELECT 1 FROM spending_rollup_seen s WHERE s.transaction_id = t.transaction_id) "
+                    "FROM transactions t WHERE transaction_id >= ? ORDER BY transaction_id LIMIT ?"));
+                walk->setInt64(1, next);
+                walk->setInt(2, batch * 2);
+                std::unique_ptr<sql::ResultSet> res(walk->executeQuery());
+                while (res->next()) {
+                    int64_t id = res->getInt64(1);
+                    if (id != settled && res->getInt(2) == 0) break;
+                    if (res->getInt(3) == 0 && !std::binary_search(counted.begin(), counted.end(), id)) break;
+                    settled = id + 1;
+                }
+            }
+            if (seen == 0 && settled == next) {
+                connection->commit(); connection->setAutoCommit(true);
+                return true;
+            }
+            auto it = sums.begin();
+            while (it != sums.end()) {
+                size_t n = std::min(chunk, (size_t)std::distance(it, sums.end()));
+                std::unique_ptr<sql::PreparedStatement> upsert(connection->prepareStatement(
+                    "INSERT INTO spending_rollups (card_id, granularity, period, category, total, count) VALUES "
+                    + valuesList("(?, ?, ?, ?, ?, ?)", n)
+                    + " ON DUPLICATE KEY UPDATE total = total + VALUES(total), count = count + VALUES(count)"));
+                int idx = 1;
+                for (size_t i = 0; i < n; i++, ++it) {
+                    upsert->setInt(idx++, std::get<0>(it->first));
+                    upsert->setString(idx++, std::string(1, std::get<1>(it->first)));
+                    upsert->setString(idx++, std::get<2>(it->first));
+                    upsert->setString(idx++, spendingCategoryName(std::get<3>(it->first)));
+                    upsert->setDouble(idx++, fromCents(it->second.first));
+                    upsert->setInt64(idx++, it->second.second);
+                }
+                upsert->executeUpdate();
+            }
+            // 新的 next 之前的由进度覆盖，之后的记下来，下次扫描时跳过
+            for (size_t i = std::lower_bound(counted.begin(), counted.end(), settled) - counted.begin(); i < counted.size();) {
+                size_t n = std::min(chunk, counted.size() - i);
+                std::unique_ptr<sql::PreparedStatement> mark(connection->prepareStatement(
+                    "INSERT INTO spending_rollup_seen (transaction_id) VALUES " + valuesList("(?)", n)));
+                for (size_t k = 0; k < n; k++) mark->setInt64((int)k + 1, counted[i++]);
+                mark->executeUpdate();
+            }
+            std::unique_ptr<sql::PreparedStatement> forget(connection->prepareStatement(
+                "DELETE FROM spending_rollup_seen WHERE transaction_id < ?"));
+            forget->setInt64(1, settled);
+            forget->executeUpdate();
+            std::unique_ptr<sql::PreparedStatement> progress(connection->prepareStatement(
+                "UPDATE sequences SET next_value = ? WHERE name = 'spending_rollup'"));
+            progress->setInt64(1, settled);
+            progress->executeUpdate();
+            connection->commit(); connection->setAutoCommit(true);
+            rows += seen;
+            if (seen < batch) return true;
+        }
+    } catch (sql::SQLException& e) {
+        std::cerr << "消费统计汇总失败: " << e.what() << std::endl;
+        if (connection) try { connection->rollback(); connection->setAutoCommit(true); } catch (...) {}
+        return false;
+    }
+}
+
+bool DatabaseManager::loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                                   std::vector<SpendingBucket>& out) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    try {
+        if (!isConnected()) connect();
+        if (!connection) return false;
+        sql::PreparedStatement* q = statement(kSpending);
+        q->setString(1, monthly ? "M" : "D");
+        q->setString(2, from);
+        q->setString(3, to);
+        q->setString(4, cardNumber);
+        std::unique_ptr<sql::ResultSet> res(q->executeQuery());
+        bool found = false;
+        while (res->next()) {
+            found = true;
+            if (res->isNull(2)) continue;
+            std::string period = res->getString(2);
+            int category = spendingCategoryFromName(res->getString(3));
+            if (category < 0) continue;
+            if (out.empty() || out.back().period != period) {
+                out.emplace_back();
+                out.back().period = period;
+            }
+            out.back().cents[category] = toCents(res->getDouble(4));
+            out.back().count[category] = res->getInt64(5);
+        }
+        return found;
+    } catch (sql::SQLException& e) {
+        std::cerr << "读取消费统计失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 bool DatabaseManager::isCardNumberExists(const std::string& cardNumber) {
     std::lock_guard<std::recursive_mutex> lock(db_mutex);
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> pstmt(connection->prepareStatement("SELECT card_id FROM cards WHERE card_number = ?"));
+        sql::PreparedStatement* pstmt = statement(kCardId);
         pstmt->setString(1, cardNumber);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         return res->next();
@@ -200,7 +815,7 @@ bool DatabaseManager::createAccount(const std::string& name, const std::string&
         if (!connection) return false;
         connection->setAutoCommit(false);
         if (isCardNumberExists(cardNumber)) throw sql::SQLException("Exists");
-        std::unique_ptr<sql::PreparedStatement> user(connection->prepareStatement("INSERT INTO users (name, id_card, phone, address) VALUES (?, ?, ?, ?)"));
+        sql::PreparedStatement* user = statement(kCreateUser);
         user->setString(1, name); user->setString(2, idCard); user->setString(3, phone); user->setString(4, address);
         user->executeUpdate();
         int uid = 0;
@@ -209,7 +824,7 @@ bool DatabaseManager::createAccount(const std::string& name, const std::string&
             std::unique_ptr<sql::ResultSet> uidRes(stmt->executeQuery("SELECT LAST_INSERT_ID()"));
             uidRes->next(); uid = uidRes->getInt(1);
         }
-        std::unique_ptr<sql::PreparedStatement> card(connection->prepareStatement("INSERT INTO cards (user_id, card_number, password_hash, balance) VALUES (?, ?, MD5(?), ?)"));
+        sql::PreparedStatement* card = statement(kCreateCard);
         card->setInt(1, uid); card->setString(2, cardNumber); card->setString(3, password); card->setDouble(4, initialDeposit);
         card->executeUpdate();
         int cid = 0;
@@ -218,7 +833,7 @@ bool DatabaseManager::createAccount(const std::string& name, const std::string&
             std::unique_ptr<sql::ResultSet> cidRes(stmt->executeQuery("SELECT LAST_INSERT_ID()"));
             cidRes->next(); cid = cidRes->getInt(1);
         }
-        std::unique_ptr<sql::PreparedStatement> trans(connection->prepareStatement("INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'open', ?, ?, '开户')"));
+        sql::PreparedStatement* trans = statement(kOpenLog);
         trans->setInt(1, cid); trans->setDouble(2, initialDeposit); trans->setDouble(3, initialDeposit);
         trans->executeUpdate();
         connection->commit(); connection->setAutoCommit(true);
@@ -229,6 +844,84 @@ bool DatabaseManager::createAccount(const std::string& name, const std::string&
     }
 }
 
+void DatabaseManager::insertAccountChunk(const std::vector<NewAccount>& rows, size_t begin, size_t end) {
+    size_t n = end - begin;
+    std::string in = "(" + valuesList("?", n) + ")";
+
+    std::unique_ptr<sql::PreparedStatement> users(connection->prepareStatement(
+        "INSERT INTO users (name, id_card, phone, address) VALUES " + valuesList("(?, ?, ?, ?)", n)));
+    for (size_t i = 0; i < n; i++) {
+        const NewAccount& a = rows[begin + i];
+        users->setString(i * 4 + 1, a.name); users->setString(i * 4 + 2, a.idCard);
+        users->setString(i * 4 + 3, a.phone); users->setString(i * 4 + 4, a.address);
+    }
+    users->executeUpdate();
+
+    // 多行插入的自增 ID 不保证连续，按唯一键查回
+    std::unordered_map<std::string, int> userIds;
+    {
+        std::unique_ptr<sql::PreparedStatement> sel(connection->prepareStatement("SELECT user_id, id_card FROM users WHERE id_card IN " + in));
+        for (size_t i = 0; i < n; i++) sel->setString(i + 1, rows[begin + i].idCard);
+        std::unique_ptr<sql::ResultSet> res(sel->executeQuery());
+        while (res->next()) userIds[res->getString(2)] = res->getInt(1);
+    }
+
+    std::unique_ptr<sql::PreparedStatement> cards(connection->prepareStatement(
+        "INSERT INTO cards (user_id, card_number, password_hash, balance) VALUES " + valuesList("(?, ?, MD5(?), ?)", n)));
+    for (size_t i = 0; i < n; i++) {
+        const NewAccount& a = rows[begin + i];
+        cards->setInt(i * 4 + 1, userIds.at(a.idCard)); cards->setString(i * 4 + 2, a.cardNumber);
+        cards->setString(i * 4 + 3, a.password); cards->setDouble(i * 4 + 4, a.initialDeposit);
+    }
+    cards->executeUpdate();
+
+    std::unordered_map<std::string, int> cardIds;
+    {
+        std::unique_ptr<sql::PreparedStatement> sel(connection->prepareStatement("SELECT card_id, card_number FROM cards WHERE card_number IN " + in));
+        for (size_t i = 0; i < n; i++) sel->setString(i + 1, rows[begin + i].cardNumber);
+        std::unique_ptr<sql::ResultSet> res(sel->executeQuery());
+        while (res->next()) cardIds[res->getString(2)] = res->getInt(1);
+    }
+
+    std::unique_ptr<sql::PreparedStatement> trans(connection->prepareStatement(
+        "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES " + valuesList("(?, 'open', ?, ?, '开户')", n)));
+    for (size_t i = 0; i < n; i++) {
+        const NewAccount& a = rows[begin + i];
+        trans->setInt(i * 3 + 1, cardIds.at(a.cardNumber));
+        trans->setDouble(i * 3 + 2, a.initialDeposit); trans->setDouble(i * 3 + 3, a.initialDeposit);
+    }
+    trans->executeUpdate();
+}
+
+void DatabaseManager::createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) {
+    const size_t chunk = 500;
+    created.assign(rows.size(), false);
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    for (size_t begin = 0; begin < rows.size(); begin += chunk) {
+        size_t end = std::min(rows.size(), begin + chunk);
+        bool ok = false;
+        try {
+            if (!isConnected()) connect();
+            if (!connection) return;
+            connection->setAutoCommit(false);
+            insertAccountChunk(rows, begin, end);
+            connection->commit(); connection->setAutoCommit(true);
+            ok = true;
+        } catch (...) {
+            if (connection) try { connection->rollback(); connection->setAutoCommit(true); } catch (...) {}
+        }
+        if (ok) {
+            for (size_t i = begin; i < end; i++) created[i] = true;
+            continue;
+        }
+        // 整块失败（通常是卡号或身份证号已存在），逐行重试找出具体失败的行
+        for (size_t i = begin; i < end; i++) {
+            const NewAccount& a = rows[i];
+            created[i] = createAccount(a.name, a.idCard, a.phone, a.address, a.cardNumber, a.password, a.initialDeposit);
+        }
+    }
+}
+
 bool DatabaseManager::transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) {
     std::lock_guard<std::recursive_mutex> lock(db_mutex);
     if (from_card == to_card || amount <= 0) return false;
@@ -241,7 +934,7 @@ bool DatabaseManager::transfer(const std::string& from_card, const std::string&
         int dstId = 0;
 
         {
-            std::unique_ptr<sql::PreparedStatement> src(connection->prepareStatement("SELECT card_id, balance FROM cards WHERE card_number = ? FOR UPDATE"));
+            sql::PreparedStatement* src = statement(kLockPayer);
             src->setString(1, from_card);
             std::unique_ptr<sql::ResultSet> rs(src->executeQuery());
             if (!rs->next()) throw sql::SQLException("付款人不存在");
@@ -249,22 +942,22 @@ bool DatabaseManager::transfer(const std::string& from_card, const std::string&
             srcId = rs->getInt("card_id");
         }
         {
-            std::unique_ptr<sql::PreparedStatement> dst(connection->prepareStatement("SELECT card_id FROM cards WHERE card_number = ?"));
+            sql::PreparedStatement* dst = statement(kCardId);
             dst->setString(1, to_card);
             std::unique_ptr<sql::ResultSet> rd(dst->executeQuery());
             if (!rd->next()) throw sql::SQLException("收款人不存在");
             dstId = rd->getInt("card_id");
         }
-        std::unique_ptr<sql::PreparedStatement> upd1(connection->prepareStatement("UPDATE cards SET balance = balance - ? WHERE card_id = ?"));
+        sql::PreparedStatement* upd1 = statement(kDebitCard);
         upd1->setDouble(1, amount); upd1->setInt(2, srcId); upd1->executeUpdate();
-        std::unique_ptr<sql::PreparedStatement> upd2(connection->prepareStatement("UPDATE cards SET balance = balance + ? WHERE card_id = ?"));
+        sql::PreparedStatement* upd2 = statement(kCreditCard);
         upd2->setDouble(1, amount); upd2->setInt(2, dstId); upd2->executeUpdate();
-        std::unique_ptr<sql::PreparedStatement> log1(connection->prepareStatement("INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'withdraw', ?, (SELECT balance FROM cards WHERE card_id=?), ?)"));
+        sql::PreparedStatement* log1 = statement(kTransferOutLog);
         log1->setInt(1, srcId); log1->setDouble(2, amount); log1->setInt(3, srcId); log1->setString(4, "转账给 " + to_card); log1->executeUpdate();
-        std::string sName = is_anonymous ? "匿名用户" : getUserName(from_card);
-        std::unique_ptr<sql::PreparedStatement> log2(connection->prepareStatement("INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'deposit', ?, (SELECT balance FROM cards WHERE card_id=?), ?)"));
+        std::string sName = is_anonymous ? "匿名用户" : lookupUserName(from_card);
+        sql::PreparedStatement* log2 = statement(kTransferInLog);
         log2->setInt(1, dstId); log2->setDouble(2, amount); log2->setInt(3, dstId); log2->setString(4, "收到 " + sName + " 转账"); log2->executeUpdate();
-        std::unique_ptr<sql::PreparedStatement> msg(connection->prepareStatement("INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, ?, 'transfer', ?, ?)"));
+        sql::PreparedStatement* msg = statement(kTransferMessage);
         msg->setString(1, to_card); msg->setString(2, sName); msg->setDouble(3, amount); msg->setString(4, message); msg->executeUpdate();
         connection->commit(); connection->setAutoCommit(true);
         return true;
@@ -275,12 +968,121 @@ bool DatabaseManager::transfer(const std::string& from_card, const std::string&
     }
 }
 
+void DatabaseManager::transferChunk(const std::string& from_card, const std::vector<TransferLine>& lines, size_t begin, size_t end,
+                                    const std::string& sName, std::vector<bool>& ok) {
+    int srcId = 0;
+    int64_t srcBalance = 0;
+    {
+        sql::PreparedStatement* src = statement(kLockPayer);
+        src->setString(1, from_card);
+        std::unique_ptr<sql::ResultSet> rs(src->executeQuery());
+        if (!rs->next()) return;
+        srcId = rs->getInt("card_id");
+        srcBalance = toCents(rs->getDouble("balance"));
+    }
+
+    // 收款卡按 card_id 顺序加锁，和其他批次不会互相死锁
+    struct Payee { int id; int64_t balance; int64_t credit; };
+    std::unordered_map<std::string, Payee> payees;
+    {
+        std::vector<std::string> cards;
+        std::unordered_set<std::string> seen;
+        for (size_t i = begin; i < end; i++) {
+            if (lines[i].toCard != from_card && seen.insert(lines[i].toCard).second) cards.push_back(lines[i].toCard);
+        }
+        if (cards.empty()) return;
+        std::unique_ptr<sql::PreparedStatement> sel(connection->prepareStatement(
+            "SELECT card_id, card_number, balance FROM cards WHERE card_number IN (" + valuesList("?", cards.size()) + ") ORDER BY card_id FOR UPDATE"));
+        for (size_t i = 0; i < cards.size(); i++) sel->setString(i + 1, cards[i]);
+        std::unique_ptr<sql::ResultSet> rs(sel->executeQuery());
+        while (rs->next()) payees[rs->getString(2)] = Payee{rs->getInt(1), toCents(rs->getDouble(3)), 0};
+    }
+
+    // 按顺序逐行记账，余额不足的行跳过
+    struct Posting { size_t line; Payee* payee; int64_t cents, srcAfter, dstAfter; };
+    std::vector<Posting> postings;
+    int64_t debit = 0;
+    for (size_t i = begin; i < end; i++) {
+        int64_t cents = toCents(lines[i].amount);
+        auto it = payees.find(lines[i].toCard);
+        if (cents <= 0 || it == payees.end() || srcBalance - debit < cents) continue;
+        debit += cents;
+        it->second.credit += cents;
+        postings.push_back({i, &it->second, cents, srcBalance - debit, it->second.balance + it->second.credit});
+    }
+    if (postings.empty()) return;
+
+    {
+        sql::PreparedStatement* upd = statement(kDebitCard);
+        upd->setDouble(1, fromCents(debit)); upd->setInt(2, srcId); upd->executeUpdate();
+    }
+    {
+        std::vector<const Payee*> credited;
+        for (const auto& kv : payees) {
+            if (kv.second.credit) credited.push_back(&kv.second);
+        }
+        std::string cases;
+        for (size_t i = 0; i < credited.size(); i++) cases += " WHEN ? THEN ?";
+        std::unique_ptr<sql::PreparedStatement> upd(connection->prepareStatement(
+            "UPDATE cards SET balance = balance + CASE card_id" + cases + " END, version = version + 1 WHERE card_id IN (" + valuesList("?", credited.size()) + ")"));
+        int idx = 1;
+        for (const Payee* p : credited) { upd->setInt(idx++, p->id); upd->setDouble(idx++, fromCents(p->credit)); }
+        for (const Payee* p : credited) upd->setInt(idx++, p->id);
+        upd->executeUpdate();
+    }
+    {
+        std::unique_ptr<sql::PreparedStatement> log(connection->prepareStatement(
+            "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES " + valuesList("(?, ?, ?, ?, ?)", postings.size() * 2)));
+        int idx = 1;
+        for (const Posting& p : postings) {
+            log->setInt(idx++, srcId); log->setString(idx++, "withdraw"); log->setDouble(idx++, fromCents(p.cents));
+            log->setDouble(idx++, fromCents(p.srcAfter)); log->setString(idx++, "转账给 " + lines[p.line].toCard);
+            log->setInt(idx++, p.payee->id); log->setString(idx++, "deposit"); log->setDouble(idx++, fromCents(p.cents));
+            log->setDouble(idx++, fromCents(p.dstAfter)); log->setString(idx++, "收到 " + sName + " 转账");
+        }
+        log->executeUpdate();
+    }
+    {
+        std::unique_ptr<sql::PreparedStatement> msg(connection->prepareStatement(
+            "INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES " + valuesList("(?, ?, 'transfer', ?, ?)", postings.size())));
+        int idx = 1;
+        for (const Posting& p : postings) {
+            msg->setString(idx++, lines[p.line].toCard); msg->setString(idx++, sName);
+            msg->setDouble(idx++, fromCents(p.cents)); msg->setString(idx++, lines[p.line].message);
+        }
+        msg->executeUpdate();
+    }
+    for (const Posting& p : postings) ok[p.line] = true;
+}
+
+void DatabaseManager::transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) {
+    const size_t chunk = 1000;
+    ok.assign(lines.size(), false);
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    std::string sName = is_anonymous ? "匿名用户" : lookupUserName(from_card);
+    for (size_t begin = 0; begin < lines.size(); begin += chunk) {
+        size_t end = std::min(lines.size(), begin + chunk);
+        std::vector<bool> chunkOk(lines.size(), false);
+        try {
+            if (!isConnected()) connect();
+            if (!connection) return;
+            connection->setAutoCommit(false);
+            transferChunk(from_card, lines, begin, end, sName, chunkOk);
+            connection->commit(); connection->setAutoCommit(true);
+            for (size_t i = begin; i < end; i++) ok[i] = chunkOk[i];
+        } catch (sql::SQLException& e) {
+            std::cerr << "Batch Transfer Error: " << e.what() << std::endl;
+            if (connection) try { connection->rollback(); connection->setAutoCommit(true); } catch (...) {}
+        }
+    }
+}
+
 std::string DatabaseManager::getUserName(const std::string& card_number) {
     std::lock_guard<std::recursive_mutex> lock(db_mutex);
     try {
         if (!isConnected()) connect();
         if (!connection) return "";
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement("SELECT u.name FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?"));
+        sql::PreparedStatement* p = statement(kUserName);
         p->setString(1, card_number);
         std::unique_ptr<sql::ResultSet> r(p->executeQuery());
         if (r->next()) return r->getString("name");
@@ -293,31 +1095,45 @@ std::string DatabaseManager::getUserMessages(const std::string& card_number) {
     try {
         if (!isConnected()) connect();
         if (!connection) return "{\"status\":\"error\",\"message\":\"数据库未连接\"}";
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement("SELECT id, sender_name, type, amount, content, is_read, create_time FROM messages WHERE recipient_card = ? ORDER BY create_time DESC"));
+        sql::PreparedStatement* p = statement(kMessages);
         p->setString(1, card_number);
         std::unique_ptr<sql::ResultSet> r(p->executeQuery());
-        std::stringstream ss; ss << "{\"status\":\"success\",\"messages\":[";
+        ArenaString out;
+        out.reserve(4096);
+        out += "{\"status\":\"success\",\"messages\":[";
         bool f = true;
         while (r->next()) {
-            if (!f) ss << ",";
-            ss << "{\"id\":" << r->getInt("id") << ",\"sender_name\":\"" << escapeJson(r->getString("sender_name"))
-               << "\",\"type\":\"" << r->getString("type") << "\",\"amount\":" << r->getDouble("amount")
-               << ",\"content\":\"" << escapeJson(r->getString("content")) << "\",\"is_read\":" << r->getInt("is_read")
-               << ",\"create_time\":\"" << r->getString("create_time") << "\"}";
+            if (!f) out += ',';
+            out += "{\"id\":";
+            appendNumber(out, "%d", (int)r->getInt("id"));
+            out += ",\"sender_name\":\"";
+            appendEscapedJson(out, r->getString("sender_name"));
+            out += "\",\"type\":\"";
+            appendText(out, r->getString("type"));
+            out += "\",\"amount\":";
+            appendNumber(out, "%g", (double)r->getDouble("amount"));
+            out += ",\"content\":\"";
+            appendEscapedJson(out, r->getString("content"));
+            out += "\",\"is_read\":";
+            appendNumber(out, "%d", (int)r->getInt("is_read"));
+            out += ",\"create_time\":\"";
+            appendText(out, r->getString("create_time"));
+            out += "\"}";
             f = false;
         }
-        ss << "]}";
-        return ss.str();
+        out += "]}";
+        return std::string(out.data(), out.size());
     } catch (...) { return "{\"status\":\"error\"}"; }
 }
 
-bool DatabaseManager::markMessageRead(int message_id) {
+bool DatabaseManager::markMessageRead(const std::string& card_number, int message_id) {
     std::lock_guard<std::recursive_mutex> lock(db_mutex);
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement("UPDATE messages SET is_read = 1 WHERE id = ?"));
+        sql::PreparedStatement* p = statement(kMarkRead);
         p->setInt(1, message_id);
+        p->setString(2, card_number);
         return p->executeUpdate() > 0;
     } catch (...) { return false; }
 }
@@ -327,7 +1143,7 @@ bool DatabaseManager::sendSystemMessage(const std::string& to_card, const std::s
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement("INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, '系统通知', 'system', 0, ?)"));
+        sql::PreparedStatement* p = statement(kSystemMessage);
         p->setString(1, to_card); p->setString(2, content);
         return p->executeUpdate() > 0;
     } catch (...) { return false; }
@@ -340,27 +1156,31 @@ bool DatabaseManager::updateUserInfo(const std::string& cardNumber, const std::s
         if (!connection) return false;
 
         // 通过卡号找 user_id
-        std::unique_ptr<sql::PreparedStatement> findUser(
-            connection->prepareStatement("SELECT user_id FROM cards WHERE card_number = ?")
-        );
+        sql::PreparedStatement* findUser = statement(kUserIdByCard);
         findUser->setString(1, cardNumber);
         std::unique_ptr<sql::ResultSet> res(findUser->executeQuery());
         if (!res->next()) return false;
         int userId = res->getInt("user_id");
 
         // 更新 users 表
-        std::unique_ptr<sql::PreparedStatement> update(
-            connection->prepareStatement("UPDATE users SET name = ?, id_card = ?, phone = ?, address = ? WHERE user_id = ?")
-        );
+        sql::PreparedStatement* update = statement(kUpdateUser);
         update->setString(1, name);
         update->setString(2, idCard);
         update->setString(3, phone);
         update->setString(4, address);
         update->setInt(5, userId);
 
-        return update->executeUpdate() > 0;
+        // 资料变了，该用户名下各卡的版本号一起递增，持久化热缓存据此判断是否过期
+        connection->setAutoCommit(false);
+        bool ok = update->executeUpdate() > 0;
+        sql::PreparedStatement* bump = statement(kBumpUserCards);
+        bump->setInt(1, userId);
+        bump->executeUpdate();
+        connection->commit(); connection->setAutoCommit(true);
+        return ok;
     } catch (sql::SQLException& e) {
         std::cerr << "Update User Error: " << e.what() << std::endl;
+        if (connection) try { connection->rollback(); connection->setAutoCommit(true); } catch (...) {}
         return false;
     }
 }
@@ -370,9 +1190,7 @@ bool DatabaseManager::verifyIdentity(const std::string& cardNumber, const std::s
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement(
-            "SELECT c.card_id FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?"
-        ));
+        sql::PreparedStatement* p = statement(kVerifyIdentity);
         p->setString(1, cardNumber); p->setString(2, name); p->setString(3, phone);
         std::unique_ptr<sql::ResultSet> rs(p->executeQuery());
         return rs->next();
@@ -384,7 +1202,7 @@ bool DatabaseManager::updatePassword(const std::string& cardNumber, const std::s
     try {
         if (!isConnected()) connect();
         if (!connection) return false;
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement("UPDATE cards SET password_hash = MD5(?) WHERE card_number = ?"));
+        sql::PreparedStatement* p = statement(kUpdatePassword);
         p->setString(1, newPassword); p->setString(2, cardNumber);
         return p->executeUpdate() > 0;
     } catch (...) { return false; }
@@ -397,9 +1215,7 @@ bool DatabaseManager::checkAccountForDeletion(const std::string& cardNumber, con
         if (!connection) return false;
 
         // 验证卡号、姓名、手机号是否匹配
-        std::unique_ptr<sql::PreparedStatement> p(connection->prepareStatement(
-            "SELECT c.balance FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?"
-        ));
+        sql::PreparedStatement* p = statement(kDeletionCheck);
         p->setString(1, cardNumber);
         p->setString(2, name);
         p->setString(3, phone);
@@ -426,7 +1242,7 @@ bool DatabaseManager::deleteAccount(const std::string& cardNumber) {
         int userId = 0;
         int cardId = 0;
         {
-            std::unique_ptr<sql::PreparedStatement> sel(connection->prepareStatement("SELECT card_id, user_id FROM cards WHERE card_number = ? FOR UPDATE"));
+            sql::PreparedStatement* sel = statement(kLockForDelete);
             sel->setString(1, cardNumber);
             std::unique_ptr<sql::ResultSet> rs(sel->executeQuery());
             if (!rs->next()) throw sql::SQLException("Not Found");
@@ -436,28 +1252,28 @@ bool DatabaseManager::deleteAccount(const std::string& cardNumber) {
 
         // 2. 删除关联的消息
         {
-            std::unique_ptr<sql::PreparedStatement> delMsg(connection->prepareStatement("DELETE FROM messages WHERE recipient_card = ?"));
+            sql::PreparedStatement* delMsg = statement(kDeleteMessages);
             delMsg->setString(1, cardNumber);
             delMsg->executeUpdate();
         }
 
         // 3. 删除关联的交易记录
         {
-            std::unique_ptr<sql::PreparedStatement> delTrans(connection->prepareStatement("DELETE FROM transactions WHERE card_id = ?"));
+            sql::PreparedStatement* delTrans = statement(kDeleteTransactions);
             delTrans->setInt(1, cardId);
             delTrans->executeUpdate();
         }
 
         // 4. 删除卡片
         {
-            std::unique_ptr<sql::PreparedStatement> delCard(connection->prepareStatement("DELETE FROM cards WHERE card_id = ?"));
+            sql::PreparedStatement* delCard = statement(kDeleteCard);
             delCard->setInt(1, cardId);
             delCard->executeUpdate();
         }
 
         // 5. 删除用户 (假定是一人一卡模式，直接删除用户)
         {
-            std::unique_ptr<sql::PreparedStatement> delUser(connection->prepareStatement("DELETE FROM users WHERE user_id = ?"));
+            sql::PreparedStatement* delUser = statement(kDeleteUser);
             delUser->setInt(1, userId);
             delUser->executeUpdate();
         }
@@ -0,0 +1,302 @@
+#include "../include/HotRestart.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace {
+
+// 新进程初始化（建卡号过滤器等）可能比较久，等它就绪的上限
+const int kReadyTimeoutSec = 600;
+const int kRequestTimeoutSec = 5;
+
+bool makeAddress(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "热重启: 控制套接字路径过长: " << path << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    return true;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un addr;
+    if (!makeAddress(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void setTimeout(int fd, int sec) {
+    timeval tv;
+    tv.tv_sec = sec;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        sent += (size_t)n;
+    }
+    return true;
+}
+
+bool readLine(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (line.size() < 64) {
+        ssize_t n = recv(fd, &c, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        if (c == '\n') return true;
+        line += c;
+    }
+    return false;
+}
+
+// 帧格式："长度\n" 后跟正文
+bool sendFrame(int fd, const std::string& payload) {
+    return sendAll(fd, std::to_string(payload.size()) + "\n") && sendAll(fd, payload);
+}
+
+bool readFrame(int fd, std::string& payload) {
+    std::string line;
+    if (!readLine(fd, line) || line.empty() || line.find_first_not_of("0123456789") != std::string::npos) return false;
+    payload.resize(strtoull(line.c_str(), nullptr, 10));
+    size_t got = 0;
+    while (got < payload.size()) {
+        ssize_t n = recv(fd, &payload[got], payload.size() - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        got += (size_t)n;
+    }
+    return true;
+}
+
+bool sendDescriptor(int sock, int fd) {
+    char byte = 'F';
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == 1;
+}
+
+int receiveDescriptor(int sock) {
+    char byte = 0;
+    iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1 || byte != 'F') return -1;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int))) return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+}
+
+HotRestart::Options HotRestart::Options::fromEnv() {
+    Options o;
+    if (const char* v = getenv("BANK_HANDOFF_SOCKET")) {
+        if (*v) o.socketPath = v;
+    }
+    if (const char* v = getenv("BANK_DRAIN_TIMEOUT")) o.drainTimeoutSec = std::max(0, atoi(v));
+    return o;
+}
+
+HotRestart::HotRestart(const Options& options) : options(options) {}
+
+HotRestart::~HotRestart() {
+    shutdown();
+}
+
+int HotRestart::takeover() {
+    peer = connectTo(options.socketPath);
+    if (peer < 0) {
+        std::cerr << "热重启: 无法连接旧进程的控制套接字 " << options.socketPath << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+    setTimeout(peer, kRequestTimeoutSec);
+    int fd = -1;
+    if (sendAll(peer, "TAKEOVER\n")) fd = receiveDescriptor(peer);
+    if (fd < 0) {
+        std::cerr << "热重启: 旧进程没有交出监听套接字" << std::endl;
+        close(peer);
+        peer = -1;
+        return -1;
+    }
+    std::cout << "热重启: 已从旧进程取得监听套接字" << std::endl;
+    return fd;
+}
+
+bool HotRestart::ready(std::string& state) {
+    if (peer < 0) return false;
+    setTimeout(peer, kRequestTimeoutSec);
+    return sendAll(peer, "READY\n") && readFrame(peer, state);
+}
+
+void HotRestart::finish(const Hooks& h, std::function<void(const std::string&, bool)> onFinal) {
+    hooks = h;
+    worker = std::thread([this, onFinal] {
+        std::string state;
+        bool complete = false;
+        if (peer >= 0) {
+            // 旧进程最多等 drainTimeoutSec 秒，再留些余量
+            setTimeout(peer, options.drainTimeoutSec + 30);
+            complete = readFrame(peer, state);
+            close(peer);
+            peer = -1;
+        }
+        onFinal(state, complete);
+        std::cout << "热重启: 交接" << (complete ? "完成" : "未完成，旧进程没有发完状态") << std::endl;
+        if (!closing && bindListener()) serve();
+    });
+}
+
+bool HotRestart::listen(const Hooks& h) {
+    hooks = h;
+    if (!bindListener()) return false;
+    worker = std::thread([this] { serve(); });
+    return true;
+}
+
+bool HotRestart::bindListener() {
+    // 能连上说明已有进程在等，不抢它的路径
+    int probe = connectTo(options.socketPath);
+    if (probe >= 0) {
+        close(probe);
+        std::cerr << "热重启: 控制套接字 " << options.socketPath << " 已被其他进程使用，本进程不接受热重启" << std::endl;
+        return false;
+    }
+    sockaddr_un addr;
+    if (!makeAddress(options.socketPath, addr)) return false;
+    unlink(options.socketPath.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || chmod(options.socketPath.c_str(), 0600) != 0 || ::listen(fd, 4) != 0) {
+        std::cerr << "热重启: 无法建立控制套接字 " << options.socketPath << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    listener = fd;
+    std::cout << "热重启: 控制套接字 " << options.socketPath << std::endl;
+    return true;
+}
+
+void HotRestart::serve() {
+    while (!closing) {
+        pollfd p;
+        p.fd = listener;
+        p.events = POLLIN;
+        p.revents = 0;
+        if (poll(&p, 1, 500) <= 0) continue;
+        int conn = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) continue;
+        // 只接受同一用户的进程
+        ucred cred;
+        socklen_t length = sizeof(cred);
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0 || cred.uid != getuid()) {
+            std::cerr << "热重启: 拒绝其他用户的连接" << std::endl;
+            close(conn);
+            continue;
+        }
+        setTimeout(conn, kRequestTimeoutSec);
+        std::string line;
+        bool done = readLine(conn, line) && line == "TAKEOVER" && handOver(conn);
+        close(conn);
+        if (done) return;
+    }
+}
+
+bool HotRestart::handOver(int conn) {
+    int fd = hooks.listenHandle();
+    if (fd < 0) return false;
+    hooks.begin();
+    if (!sendDescriptor(conn, fd)) return false;
+    std::cout << "热重启: 新进程已取得监听套接字，等待其就绪" << std::endl;
+
+    setTimeout(conn, kReadyTimeoutSec);
+    std::string line;
+    if (!readLine(conn, line) || line != "READY" || !sendFrame(conn, hooks.exportState(false))) {
+        std::cerr << "热重启: 新进程没有就绪，继续服务" << std::endl;
+        return false;
+    }
+    // 会话表送到之后才停止 accept；新进程就绪前若退出，本进程照常服务
+    hooks.stopAccepting();
+    auto begin = std::chrono::steady_clock::now();
+    auto deadline = begin + std::chrono::seconds(options.drainTimeoutSec);
+    size_t open = hooks.connections();
+    while (open > 0 && !closing && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        open = hooks.connections();
+    }
+    std::cout << "热重启: 已停止接受新连接，等待已有连接 "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() << "ms"
+              << (open > 0 ? "，仍有 " + std::to_string(open) + " 个连接未关闭" : "") << std::endl;
+
+    // 路径从此归新进程，不再删除
+    close(listener);
+    listener = -1;
+    handedOver = true;
+    if (!sendFrame(conn, hooks.exportState(true))) std::cerr << "热重启: 最后的状态没有送到新进程" << std::endl;
+    hooks.stop();
+    return true;
+}
+
+void HotRestart::shutdown() {
+    closing = true;
+    if (peer >= 0) ::shutdown(peer, SHUT_RDWR);
+    if (worker.joinable() && worker.get_id() != std::this_thread::get_id()) worker.join();
+    if (listener >= 0) {
+        close(listener);
+        listener = -1;
+        if (!handedOver) unlink(options.socketPath.c_str());
+    }
+}
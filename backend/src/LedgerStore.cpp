@@ -0,0 +1,221 @@
+#include "../include/LedgerStore.h"
+#include "../include/MemoryLedger.h"
+#include "../include/CachedLedger.h"
+#ifdef BANK_WITH_MYSQL
+#include "../include/DatabaseManager.h"
+#endif
+#ifdef BANK_WITH_SQLITE
+#include "../include/SqliteLedger.h"
+#endif
+#include <iostream>
+#include <thread>
+#include <cstdlib>
+
+LedgerStore* LedgerStore::active = nullptr;
+
+namespace {
+
+template <typename S>
+void appendEscaped(S& out, const char* s, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    const char* end = s + length;
+    while (s < end) {
+        // 不需要转义的连续片段整段追加
+        const char* run = s;
+        while (s < end && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20) s++;
+        out.append(run, s);
+        if (s == end) break;
+        char c = *s++;
+        if (c == '"') out += "\\\"";
+        else if (c == '\\') out += "\\\\";
+        else {
+            out += "\\u00";
+            out += hex[(c >> 4) & 15];
+            out += hex[c & 15];
+        }
+    }
+}
+
+}
+
+std::string escapeJson(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    appendEscapedJson(out, s.data(), s.size());
+    return out;
+}
+
+void appendEscapedJson(std::string& out, const char* s, size_t length) {
+    appendEscaped(out, s, length);
+}
+
+void appendEscapedJson(ArenaString& out, const char* s, size_t length) {
+    appendEscaped(out, s, length);
+}
+
+std::string formatUserInfo(const std::string& cardNumber, const AccountProfile& profile) {
+    ArenaString out;
+    out.reserve(256);
+    out += "{\"status\":\"success\",\"name\":\"";
+    appendEscapedJson(out, profile.name);
+    out += "\",\"id_card\":\"";
+    appendEscapedJson(out, profile.idCard);
+    out += "\",\"card_number\":\"";
+    appendText(out, cardNumber);
+    out += "\",\"phone\":\"";
+    appendText(out, profile.phone);
+    out += "\",\"address\":\"";
+    appendEscapedJson(out, profile.address);
+    out += "\",\"balance\":";
+    appendNumber(out, "%.2f", fromCents(profile.balanceCents));
+    out += ",\"create_time\":\"";
+    appendText(out, profile.createTime);
+    out += "\"}";
+    return std::string(out.data(), out.size());
+}
+
+namespace {
+const char* const categoryNames[SpendCategoryCount] = {"deposit", "withdraw", "transfer_in", "transfer_out"};
+
+bool startsWith(const std::string& s, const std::string& prefix) {
+    return s.compare(0, prefix.size(), prefix) == 0;
+}
+}
+
+// 转账流水的摘要由各后端统一写成“转账给 <卡号>”和“收到 <付款人> 转账”
+SpendingCategory spendingCategory(const std::string& type, const std::string& description) {
+    if (type == "deposit" || type == "open") return startsWith(description, "收到 ") ? SpendTransferIn : SpendDeposit;
+    return startsWith(description, "转账给 ") ? SpendTransferOut : SpendWithdraw;
+}
+
+const char* spendingCategoryName(int category) {
+    return categoryNames[category];
+}
+
+int spendingCategoryFromName(const std::string& name) {
+    for (int c = 0; c < SpendCategoryCount; c++) {
+        if (name == categoryNames[c]) return c;
+    }
+    return -1;
+}
+
+std::vector<std::string> LedgerStore::availableBackends() {
+    std::vector<std::string> names;
+#ifdef BANK_WITH_MYSQL
+    names.push_back("mysql");
+#endif
+    names.push_back("memory");
+#ifdef BANK_WITH_MYSQL
+    names.push_back("memory-mirror");
+#endif
+#ifdef BANK_WITH_SQLITE
+    names.push_back("sqlite");
+#endif
+    return names;
+}
+
+namespace {
+
+// 打开指定的存储后端，失败或未编译返回 nullptr
+LedgerStore* openBackend(const std::string& backend) {
+#ifdef BANK_WITH_MYSQL
+    if (backend == "mysql") {
+        return &DatabaseManager::getInstance();
+    }
+#endif
+    if (backend == "memory" || backend == "memory-mirror") {
+        // 进程内账本，memory-mirror 额外异步同步到 MySQL 供报表使用
+        LedgerStore* mirror = nullptr;
+        if (backend == "memory-mirror") {
+#ifdef BANK_WITH_MYSQL
+            mirror = &DatabaseManager::getInstance();
+#else
+            return nullptr;
+#endif
+        }
+        static std::unique_ptr<MemoryLedger> memory;
+        memory.reset(new MemoryLedger(MemoryLedger::Options::fromEnv(), mirror));
+        if (!memory->open()) {
+            memory.reset();
+            return nullptr;
+        }
+        return memory.get();
+    }
+#ifdef BANK_WITH_SQLITE
+    if (backend == "sqlite") {
+        // 单机网点部署，数据库文件路径由 BANK_SQLITE_PATH 指定
+        const char* path = getenv("BANK_SQLITE_PATH");
+        static std::unique_ptr<SqliteLedger> sqlite;
+        sqlite.reset(new SqliteLedger(path && *path ? path : "bank.db"));
+        if (!sqlite->open()) {
+            sqlite.reset();
+            return nullptr;
+        }
+        return sqlite.get();
+    }
+#endif
+    return nullptr;
+}
+
+}
+
+bool LedgerStore::select(const std::string& backend, bool localCache) {
+    LedgerStore* store = openBackend(backend);
+    if (!store) return false;
+
+    // 数据库类后端外面套一层卡片缓存，BANK_CACHE_ENTRIES=0 关闭；内存账本本身无需缓存
+    const char* entries = getenv("BANK_CACHE_ENTRIES");
+    size_t capacity = entries && *entries ? strtoull(entries, nullptr, 10) : 100000;
+    const char* ttl = getenv("BANK_NAME_CACHE_TTL");
+    std::chrono::seconds nameTtl(ttl && *ttl ? atoi(ttl) : 300);
+    if (localCache && capacity > 0 && (backend == "mysql" || backend == "sqlite")) {
+        static std::unique_ptr<CachedLedger> cached;
+        cached.reset(new CachedLedger(*store, capacity, nameTtl));
+        // 卡号过滤器，BANK_CARD_FILTER_CAPACITY=0 关闭；构建失败时存在性检查照常查库
+        const char* filterCapacity = getenv("BANK_CARD_FILTER_CAPACITY");
+        size_t expected = filterCapacity && *filterCapacity ? strtoull(filterCapacity, nullptr, 10) : 1000000;
+        const char* filterThreads = getenv("BANK_CARD_FILTER_THREADS");
+        if (expected > 0) cached->enableCardFilter(expected, filterThreads && *filterThreads ? atoi(filterThreads) : 4);
+        store = cached.get();
+    }
+    active = store;
+    return true;
+}
+
+void LedgerStore::createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) {
+    created.assign(rows.size(), false);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const NewAccount& a = rows[i];
+        created[i] = createAccount(a.name, a.idCard, a.phone, a.address, a.cardNumber, a.password, a.initialDeposit);
+    }
+}
+
+void LedgerStore::transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) {
+    ok.assign(lines.size(), false);
+    for (size_t i = 0; i < lines.size(); i++) {
+        ok[i] = transfer(from_card, lines[i].toCard, lines[i].amount, lines[i].message, is_anonymous);
+    }
+}
+
+void LedgerStore::preload(const std::vector<std::string>& cards, int threads) {
+    if (threads < 1) threads = 1;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([this, &cards, t, threads] {
+            AccountProfile profile;
+            for (size_t i = (size_t)t; i < cards.size(); i += (size_t)threads) {
+                if (loadAccountProfile(cards[i], profile)) getUserName(cards[i]);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+LedgerStore& LedgerStore::getInstance() {
+    // 未显式选择时沿用原来的 MySQL 后端
+    if (!active && !select("mysql")) {
+        std::cerr << "没有可用的存储后端" << std::endl;
+        std::abort();
+    }
+    return *active;
+}
@@ -0,0 +1,900 @@
+#include "../include/MemoryLedger.h"
+#include "../include/Md5.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// 第 2 版在末尾增加了序列表，仍能读取第 1 版快照
+const char kSnapshotMagic[] = "BANKSNAP2";
+const char kSnapshotMagicV1[] = "BANKSNAP1";
+
+std::string nowString() {
+    time_t t = time(nullptr);
+    tm local;
+    localtime_r(&t, &local);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local);
+    return buf;
+}
+
+// 日志记录与快照共用的小端二进制编码
+struct Encoder {
+    std::string out;
+    void u8(uint8_t v) { out += (char)v; }
+    void i64(int64_t v) {
+        for (int i = 0; i < 8; i++) out += (char)((uint64_t)v >> (8 * i));
+    }
+    void str(const std::string& s) {
+        i64((int64_t)s.size());
+        out += s;
+    }
+};
+
+struct Decoder {
+    const std::string& in;
+    size_t pos = 0;
+    explicit Decoder(const std::string& in) : in(in) {}
+
+    void need(size_t n) {
+        if (pos + n > in.size()) throw std::runtime_error("记录被截断");
+    }
+    uint8_t u8() {
+        need(1);
+        return (uint8_t)in[pos++];
+    }
+    int64_t i64() {
+        need(8);
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v |= (uint64_t)(unsigned char)in[pos + i] << (8 * i);
+        pos += 8;
+        return (int64_t)v;
+    }
+    std::string str() {
+        int64_t len = i64();
+        if (len < 0) throw std::runtime_error("长度非法");
+        need((size_t)len);
+        std::string s = in.substr(pos, (size_t)len);
+        pos += (size_t)len;
+        return s;
+    }
+};
+
+bool makeDirs(const std::string& path) {
+    std::string partial;
+    std::stringstream ss(path);
+    std::string part;
+    if (!path.empty() && path[0] == '/') partial = "/";
+    while (std::getline(ss, part, '/')) {
+        if (part.empty()) continue;
+        partial += part + "/";
+        if (mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+bool writeFileDurably(const std::string& dir, const std::string& name, const std::string& data) {
+    std::string tmp = dir + "/" + name + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, p, left);
+        if (n < 0) {
+            ::close(fd);
+            return false;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || rename(tmp.c_str(), (dir + "/" + name).c_str()) != 0) return false;
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+}
+
+MemoryLedger::Options MemoryLedger::Options::fromEnv() {
+    Options o;
+    if (const char* v = getenv("BANK_DATA_DIR")) o.dataDir = v;
+    if (const char* v = getenv("BANK_SNAPSHOT_INTERVAL")) o.snapshotIntervalSec = atoi(v);
+    if (const char* v = getenv("BANK_SNAPSHOT_RECORDS")) o.snapshotEveryRecords = strtoull(v, nullptr, 10);
+    return o;
+}
+
+MemoryLedger::MemoryLedger(const Options& options, LedgerStore* mirror)
+    : options(options), mirror(mirror), wal(new WriteAheadLog(options.dataDir)) {}
+
+MemoryLedger::~MemoryLedger() {
+    {
+        std::lock_guard<std::mutex> a(backgroundMutex);
+        std::lock_guard<std::mutex> b(mirrorMutex);
+        stopping = true;
+    }
+    backgroundCv.notify_all();
+    mirrorCv.notify_all();
+    if (snapshotThread.joinable()) snapshotThread.join();
+    if (mirrorThread.joinable()) mirrorThread.join();
+    // 正常退出时补一次快照，下次启动不必重放整段日志
+    if (opened && recordsSinceSnapshot > 0) takeSnapshot();
+    wal->close();
+}
+
+// ---------------- 恢复与快照 ----------------
+
+bool MemoryLedger::open() {
+    if (!makeDirs(options.dataDir)) {
+        std::cerr << "无法创建数据目录 " << options.dataDir << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (!loadSnapshot()) return false;
+
+    size_t replayed = 0;
+    uint64_t lastLsn;
+    try {
+        lastLsn = wal->replay(snapshotLsn, [&](uint64_t, const std::string& payload) {
+            Decoder d(payload);
+            Record r;
+            r.op = (Op)d.u8();
+            r.card = d.str(); r.otherCard = d.str();
+            r.name = d.str(); r.idCard = d.str(); r.phone = d.str(); r.address = d.str();
+            r.text = d.str(); r.passwordHash = d.str(); r.time = d.str();
+            r.cents = d.i64(); r.id = d.i64();
+            apply(r);
+            replayed++;
+        });
+    } catch (std::exception& e) {
+        std::cerr << "WAL 重放失败: " << e.what() << std::endl;
+        return false;
+    }
+    if (!wal->open(lastLsn + 1)) return false;
+    recordsSinceSnapshot = replayed;
+    opened = true;
+
+    std::cout << "内存账本恢复完成: " << accounts.size() << " 张卡, 快照 LSN " << snapshotLsn
+              << ", 重放 " << replayed << " 条日志" << std::endl;
+
+    snapshotThread = std::thread(&MemoryLedger::snapshotLoop, this);
+    if (mirror) mirrorThread = std::thread(&MemoryLedger::mirrorLoop, this);
+    return true;
+}
+
+bool MemoryLedger::loadSnapshot() {
+    std::ifstream in(options.dataDir + "/snapshot.bin", std::ios::binary);
+    if (!in.is_open()) return true;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bool v1 = data.compare(0, sizeof(kSnapshotMagicV1) - 1, kSnapshotMagicV1) == 0;
+    if (data.size() < sizeof(kSnapshotMagic) + 4 || (!v1 && data.compare(0, sizeof(kSnapshotMagic) - 1, kSnapshotMagic) != 0)) {
+        std::cerr << "快照文件格式错误" << std::endl;
+        return false;
+    }
+    std::string body = data.substr(0, data.size() - 4);
+    uint32_t crc = 0;
+    for (int i = 0; i < 4; i++) crc |= (uint32_t)(unsigned char)data[body.size() + i] << (8 * i);
+    if (WriteAheadLog::checksum(body.data(), body.size()) != crc) {
+        std::cerr << "快照文件校验失败" << std::endl;
+        return false;
+    }
+
+    try {
+        Decoder d(body);
+        d.pos = sizeof(kSnapshotMagic) - 1;
+        snapshotLsn = (uint64_t)d.i64();
+        nextCardId = (int)d.i64();
+        nextMessageId = (int)d.i64();
+        int64_t accountCount = d.i64();
+        for (int64_t i = 0; i < accountCount; i++) {
+            std::string card = d.str();
+            Account a;
+            a.cardId = (int)d.i64();
+            a.name = d.str(); a.idCard = d.str(); a.phone = d.str(); a.address = d.str();
+            a.passwordHash = d.str();
+            a.balance = d.i64();
+            a.status = d.str();
+            a.createTime = d.str();
+            int64_t txCount = d.i64();
+            a.history.reserve((size_t)txCount);
+            for (int64_t j = 0; j < txCount; j++) {
+                Transaction t;
+                t.type = d.str();
+                t.amount = d.i64();
+                t.balanceAfter = d.i64();
+                t.description = d.str();
+                t.createTime = d.str();
+                appendHistory(a, std::move(t));
+            }
+            idCardOwner[a.idCard] = card;
+            accounts.emplace(card, std::move(a));
+        }
+        int64_t inboxCount = d.i64();
+        for (int64_t i = 0; i < inboxCount; i++) {
+            std::string card = d.str();
+            int64_t msgCount = d.i64();
+            auto& inbox = inboxes[card];
+            for (int64_t j = 0; j < msgCount; j++) {
+                Message m;
+                m.id = (int)d.i64();
+                m.senderName = d.str();
+                m.type = d.str();
+                m.amount = d.i64();
+                m.content = d.str();
+                m.isRead = d.u8() != 0;
+                m.createTime = d.str();
+                messageOwner[m.id] = card;
+                inbox.push_back(std::move(m));
+            }
+        }
+        int64_t sequenceCount = v1 ? 0 : d.i64();
+        for (int64_t i = 0; i < sequenceCount; i++) {
+            std::string name = d.str();
+            sequences[name] = d.i64();
+        }
+    } catch (std::exception& e) {
+        std::cerr << "快照解析失败: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string MemoryLedger::serializeState(uint64_t lsn) const {
+    Encoder e;
+    e.out.append(kSnapshotMagic, sizeof(kSnapshotMagic) - 1);
+    e.i64((int64_t)lsn);
+    e.i64(nextCardId);
+    e.i64(nextMessageId);
+    e.i64((int64_t)accounts.size());
+    for (const auto& kv : accounts) {
+        const Account& a = kv.second;
+        e.str(kv.first);
+        e.i64(a.cardId);
+        e.str(a.name); e.str(a.idCard); e.str(a.phone); e.str(a.address);
+        e.str(a.passwordHash);
+        e.i64(a.balance);
+        e.str(a.status);
+        e.str(a.createTime);
+        e.i64((int64_t)a.history.size());
+        for (const auto& t : a.history) {
+            e.str(t.type);
+            e.i64(t.amount);
+            e.i64(t.balanceAfter);
+            e.str(t.description);
+            e.str(t.createTime);
+        }
+    }
+    e.i64((int64_t)inboxes.size());
+    for (const auto& kv : inboxes) {
+        e.str(kv.first);
+        e.i64((int64_t)kv.second.size());
+        for (const auto& m : kv.second) {
+            e.i64(m.id);
+            e.str(m.senderName);
+            e.str(m.type);
+            e.i64(m.amount);
+            e.str(m.content);
+            e.u8(m.isRead ? 1 : 0);
+            e.str(m.createTime);
+        }
+    }
+    e.i64((int64_t)sequences.size());
+    for (const auto& kv : sequences) {
+        e.str(kv.first);
+        e.i64(kv.second);
+    }
+    uint32_t crc = WriteAheadLog::checksum(e.out.data(), e.out.size());
+    for (int i = 0; i < 4; i++) e.out += (char)(crc >> (8 * i));
+    return e.out;
+}
+
+bool MemoryLedger::takeSnapshot() {
+    std::lock_guard<std::mutex> guard(snapshotMutex);
+    std::string data;
+    uint64_t lsn;
+    {
+        // 共享锁挡住所有写入，切换日志段和序列化看到的是同一个 LSN 上的状态
+        std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+        lsn = wal->rotate();
+        data = serializeState(lsn);
+        recordsSinceSnapshot = 0;
+    }
+    if (!writeFileDurably(options.dataDir, "snapshot.bin", data)) {
+        std::cerr << "快照写入失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+    snapshotLsn = lsn;
+    wal->removeOldSegments();
+    return true;
+}
+
+void MemoryLedger::snapshotLoop() {
+    std::unique_lock<std::mutex> lock(backgroundMutex);
+    auto last = std::chrono::steady_clock::now();
+    while (!stopping) {
+        backgroundCv.wait_for(lock, std::chrono::seconds(1));
+        if (stopping) break;
+        auto now = std::chrono::steady_clock::now();
+        uint64_t pendingRecords = recordsSinceSnapshot;
+        bool due = pendingRecords >= options.snapshotEveryRecords ||
+                   (pendingRecords > 0 && now - last >= std::chrono::seconds(options.snapshotIntervalSec));
+        if (!due) continue;
+        lock.unlock();
+        takeSnapshot();
+        lock.lock();
+        last = now;
+    }
+}
+
+// ---------------- MySQL 镜像 ----------------
+
+void MemoryLedger::mirrorLoop() {
+    size_t failures = 0;
+    while (true) {
+        std::function<bool(LedgerStore&)> op;
+        {
+            std::unique_lock<std::mutex> lock(mirrorMutex);
+            mirrorCv.wait(lock, [&] { return stopping || !mirrorQueue.empty(); });
+            if (mirrorQueue.empty()) break;
+            op = std::move(mirrorQueue.front());
+            mirrorQueue.pop_front();
+        }
+        if (!op(*mirror)) {
+            failures++;
+            std::cerr << "镜像同步失败（累计 " << failures << " 次）" << std::endl;
+        }
+    }
+}
+
+// ---------------- 写路径 ----------------
+
+void MemoryLedger::submit(std::unique_lock<std::shared_timed_mutex>& lock, const Record& r, std::function<bool(LedgerStore&)> mirrorOp) {
+    uint64_t lsn = record(r, std::move(mirrorOp));
+    lock.unlock();
+    wal->waitDurable(lsn);
+}
+
+uint64_t MemoryLedger::record(const Record& r, std::function<bool(LedgerStore&)> mirrorOp) {
+    apply(r);
+
+    Encoder e;
+    e.u8((uint8_t)r.op);
+    e.str(r.card); e.str(r.otherCard);
+    e.str(r.name); e.str(r.idCard); e.str(r.phone); e.str(r.address);
+    e.str(r.text); e.str(r.passwordHash); e.str(r.time);
+    e.i64(r.cents); e.i64(r.id);
+    uint64_t lsn = wal->append(e.out);
+    recordsSinceSnapshot++;
+
+    // 仍在写锁内入队，保证镜像端的执行顺序与日志顺序一致
+    if (mirror && mirrorOp) {
+        std::lock_guard<std::mutex> guard(mirrorMutex);
+        mirrorQueue.push_back(std::move(mirrorOp));
+        mirrorCv.notify_one();
+    }
+    return lsn;
+}
+
+void MemoryLedger::appendHistory(Account& a, Transaction t) {
+    int category = spendingCategory(t.type, t.description);
+    SpendingBucket& day = a.dailySpending[t.createTime.substr(0, 10)];
+    SpendingBucket& month = a.monthlySpending[t.createTime.substr(0, 7)];
+    day.cents[category] += t.amount; day.count[category]++;
+    month.cents[category] += t.amount; month.count[category]++;
+    a.history.push_back(std::move(t));
+}
+
+void MemoryLedger::apply(const Record& r) {
+    switch (r.op) {
+    case Op::Create: {
+        Account a;
+        a.cardId = (int)r.id;
+        a.name = r.name; a.idCard = r.idCard; a.phone = r.phone; a.address = r.address;
+        a.passwordHash = r.passwordHash;
+        a.balance = r.cents;
+        a.status = "active";
+        a.createTime = r.time;
+        appendHistory(a, {"open", r.cents, r.cents, "开户", r.time});
+        idCardOwner[r.idCard] = r.card;
+        accounts[r.card] = std::move(a);
+        if (r.id >= nextCardId) nextCardId = (int)r.id + 1;
+        break;
+    }
+    case Op::Deposit: {
+        Account& a = accounts.at(r.card);
+        a.balance += r.cents;
+        appendHistory(a, {"deposit", r.cents, a.balance, "存款", r.time});
+        break;
+    }
+    case Op::Withdraw: {
+        Account& a = accounts.at(r.card);
+        a.balance -= r.cents;
+        appendHistory(a, {"withdraw", r.cents, a.balance, "取款", r.time});
+        break;
+    }
+    case Op::Transfer: {
+        // r.name 为收款方看到的付款人名称（匿名时为“匿名用户”）
+        Account& src = accounts.at(r.card);
+        Account& dst = accounts.at(r.otherCard);
+        src.balance -= r.cents;
+        appendHistory(src, {"withdraw", r.cents, src.balance, "转账给 " + r.otherCard, r.time});
+        dst.balance += r.cents;
+        appendHistory(dst, {"deposit", r.cents, dst.balance, "收到 " + r.name + " 转账", r.time});
+        inboxes[r.otherCard].push_back({(int)r.id, r.name, "transfer", r.cents, r.text, false, r.time});
+        messageOwner[(int)r.id] = r.otherCard;
+        if (r.id >= nextMessageId) nextMessageId = (int)r.id + 1;
+        break;
+    }
+    case Op::SystemMessage:
+        inboxes[r.card].push_back({(int)r.id, "系统通知", "system", 0, r.text, false, r.time});
+        messageOwner[(int)r.id] = r.card;
+        if (r.id >= nextMessageId) nextMessageId = (int)r.id + 1;
+        break;
+    case Op::MarkRead: {
+        auto owner = messageOwner.find((int)r.id);
+        if (owner == messageOwner.end()) break;
+        for (auto& m : inboxes[owner->second]) {
+            if (m.id == r.id) m.isRead = true;
+        }
+        break;
+    }
+    case Op::UpdateUser: {
+        Account& a = accounts.at(r.card);
+        idCardOwner.erase(a.idCard);
+        a.name = r.name; a.idCard = r.idCard; a.phone = r.phone; a.address = r.address;
+        idCardOwner[a.idCard] = r.card;
+        break;
+    }
+    case Op::Password:
+        accounts.at(r.card).passwordHash = r.passwordHash;
+        break;
+    case Op::Sequence: {
+        int64_t& next = sequences[r.name];
+        if (r.cents > next) next = r.cents;
+        break;
+    }
+    case Op::Delete: {
+        auto it = accounts.find(r.card);
+        if (it == accounts.end()) break;
+        idCardOwner.erase(it->second.idCard);
+        accounts.erase(it);
+        auto inbox = inboxes.find(r.card);
+        if (inbox != inboxes.end()) {
+            for (const auto& m : inbox->second) messageOwner.erase(m.id);
+            inboxes.erase(inbox);
+        }
+        break;
+    }
+    }
+}
+
+bool MemoryLedger::deposit(const std::string& cardNumber, double amount) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    if (!accounts.count(cardNumber)) return false;
+    Record r;
+    r.op = Op::Deposit;
+    r.card = cardNumber;
+    r.cents = toCents(amount);
+    r.time = nowString();
+    submit(lock, r, [=](LedgerStore& db) { return db.deposit(cardNumber, amount); });
+    return true;
+}
+
+bool MemoryLedger::withdraw(const std::string& cardNumber, double amount) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end() || it->second.balance < toCents(amount)) return false;
+    Record r;
+    r.op = Op::Withdraw;
+    r.card = cardNumber;
+    r.cents = toCents(amount);
+    r.time = nowString();
+    submit(lock, r, [=](LedgerStore& db) { return db.withdraw(cardNumber, amount); });
+    return true;
+}
+
+bool MemoryLedger::createAccount(const std::string& name, const std::string& idCard,
+                                 const std::string& phone, const std::string& address,
+                                 const std::string& cardNumber, const std::string& password,
+                                 double initialDeposit) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    if (accounts.count(cardNumber) || idCardOwner.count(idCard)) return false;
+    Record r;
+    r.op = Op::Create;
+    r.card = cardNumber;
+    r.name = name; r.idCard = idCard; r.phone = phone; r.address = address;
+    r.passwordHash = md5Hex(password);
+    r.cents = toCents(initialDeposit);
+    r.id = nextCardId;
+    r.time = nowString();
+    submit(lock, r, [=](LedgerStore& db) {
+        return db.createAccount(name, idCard, phone, address, cardNumber, password, initialDeposit);
+    });
+    return true;
+}
+
+void MemoryLedger::createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) {
+    created.assign(rows.size(), false);
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    uint64_t lastLsn = 0;
+    std::string time = nowString();
+    for (size_t i = 0; i < rows.size(); i++) {
+        const NewAccount& a = rows[i];
+        if (accounts.count(a.cardNumber) || idCardOwner.count(a.idCard)) continue;
+        Record r;
+        r.op = Op::Create;
+        r.card = a.cardNumber;
+        r.name = a.name; r.idCard = a.idCard; r.phone = a.phone; r.address = a.address;
+        r.passwordHash = md5Hex(a.password);
+        r.cents = toCents(a.initialDeposit);
+        r.id = nextCardId;
+        r.time = time;
+        lastLsn = record(r, [a](LedgerStore& db) {
+            return db.createAccount(a.name, a.idCard, a.phone, a.address, a.cardNumber, a.password, a.initialDeposit);
+        });
+        created[i] = true;
+    }
+    lock.unlock();
+    // 整批只等一次落盘
+    if (lastLsn) wal->waitDurable(lastLsn);
+}
+
+bool MemoryLedger::transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) {
+    if (from_card == to_card || amount <= 0) return false;
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto src = accounts.find(from_card);
+    if (src == accounts.end() || src->second.balance < toCents(amount)) return false;
+    if (!accounts.count(to_card)) return false;
+    Record r;
+    r.op = Op::Transfer;
+    r.card = from_card;
+    r.otherCard = to_card;
+    r.name = is_anonymous ? "匿名用户" : src->second.name;
+    r.text = message;
+    r.cents = toCents(amount);
+    r.id = nextMessageId;
+    r.time = nowString();
+    submit(lock, r, [=](LedgerStore& db) { return db.transfer(from_card, to_card, amount, message, is_anonymous); });
+    return true;
+}
+
+bool MemoryLedger::reserveSequence(const std::string& name, int64_t count, int64_t& first) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = sequences.find(name);
+    first = it == sequences.end() ? 1 : it->second;
+    Record r;
+    r.op = Op::Sequence;
+    r.name = name;
+    r.cents = first + count; // 记录预留后的下一个值
+    // 号段只在本账本内有效，不做镜像
+    submit(lock, r, nullptr);
+    return true;
+}
+
+void MemoryLedger::transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) {
+    ok.assign(lines.size(), false);
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto src = accounts.find(from_card);
+    if (src == accounts.end()) return;
+    std::string sName = is_anonymous ? "匿名用户" : src->second.name;
+    std::string time = nowString();
+    uint64_t lastLsn = 0;
+    for (size_t i = 0; i < lines.size(); i++) {
+        const TransferLine& line = lines[i];
+        int64_t cents = toCents(line.amount);
+        if (line.toCard == from_card || cents <= 0 || src->second.balance < cents || !accounts.count(line.toCard)) continue;
+        Record r;
+        r.op = Op::Transfer;
+        r.card = from_card;
+        r.otherCard = line.toCard;
+        r.name = sName;
+        r.text = line.message;
+        r.cents = cents;
+        r.id = nextMessageId;
+        r.time = time;
+        double amount = line.amount;
+        std::string to_card = line.toCard, message = line.message;
+        lastLsn = record(r, [=](LedgerStore& db) { return db.transfer(from_card, to_card, amount, message, is_anonymous); });
+        ok[i] = true;
+    }
+    lock.unlock();
+    // 整批只等一次落盘
+    if (lastLsn) wal->waitDurable(lastLsn);
+}
+
+bool MemoryLedger::markMessageRead(const std::string& card_number, int message_id) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto owner = messageOwner.find(message_id);
+    if (owner == messageOwner.end() || owner->second != card_number) return false;
+    Record r;
+    r.op = Op::MarkRead;
+    r.id = message_id;
+    // 镜像端的消息 ID 由 MySQL 自行分配，无法对应，已读状态不做镜像
+    submit(lock, r, nullptr);
+    return true;
+}
+
+bool MemoryLedger::sendSystemMessage(const std::string& to_card, const std::string& title, const std::string& content) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    Record r;
+    r.op = Op::SystemMessage;
+    r.card = to_card;
+    r.text = content;
+    r.id = nextMessageId;
+    r.time = nowString();
+    submit(lock, r, [=](LedgerStore& db) { return db.sendSystemMessage(to_card, title, content); });
+    return true;
+}
+
+bool MemoryLedger::updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end()) return false;
+    auto owner = idCardOwner.find(idCard);
+    if (owner != idCardOwner.end() && owner->second != cardNumber) return false;
+    Record r;
+    r.op = Op::UpdateUser;
+    r.card = cardNumber;
+    r.name = name; r.idCard = idCard; r.phone = phone; r.address = address;
+    submit(lock, r, [=](LedgerStore& db) { return db.updateUserInfo(cardNumber, name, idCard, phone, address); });
+    return true;
+}
+
+bool MemoryLedger::updatePassword(const std::string& cardNumber, const std::string& newPassword) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    if (!accounts.count(cardNumber)) return false;
+    Record r;
+    r.op = Op::Password;
+    r.card = cardNumber;
+    r.passwordHash = md5Hex(newPassword);
+    submit(lock, r, [=](LedgerStore& db) { return db.updatePassword(cardNumber, newPassword); });
+    return true;
+}
+
+bool MemoryLedger::deleteAccount(const std::string& cardNumber) {
+    std::unique_lock<std::shared_timed_mutex> lock(stateMutex);
+    if (!accounts.count(cardNumber)) return false;
+    Record r;
+    r.op = Op::Delete;
+    r.card = cardNumber;
+    submit(lock, r, [=](LedgerStore& db) { return db.deleteAccount(cardNumber); });
+    return true;
+}
+
+// ---------------- 读路径 ----------------
+
+bool MemoryLedger::verifyLogin(const std::string& cardNumber, const std::string& password) {
+    std::string hash = md5Hex(password);
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    return it != accounts.end() && it->second.passwordHash == hash && it->second.status == "active";
+}
+
+std::string MemoryLedger::getUserInfo(const std::string& cardNumber) {
+    AccountProfile profile;
+    if (!loadAccountProfile(cardNumber, profile)) return "{\"status\":\"error\",\"message\":\"用户不存在\"}";
+    return formatUserInfo(cardNumber, profile);
+}
+
+bool MemoryLedger::loadAccountProfile(const std::string& cardNumber, AccountProfile& out) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end()) return false;
+    const Account& a = it->second;
+    out.name = a.name; out.idCard = a.idCard; out.phone = a.phone; out.address = a.address;
+    out.createTime = a.createTime;
+    out.balanceCents = a.balance;
+    return true;
+}
+
+bool MemoryLedger::scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    for (const auto& kv : accounts) {
+        if (kv.second.cardId % partitions == partition) fn(kv.first);
+    }
+    return true;
+}
+
+bool MemoryLedger::scanStatementPartition(int partition, int partitions, const std::string& since,
+                                          const std::function<void(const StatementScanRow&)>& fn) {
+    std::vector<std::string> cards;
+    scanCardNumbers(partition, partitions, [&](const std::string& card) { cards.push_back(card); });
+
+    // 每张卡单独拿一次共享锁，把余额和区间内流水一起拷出来，回调在锁外执行
+    std::vector<StatementScanRow> rows;
+    for (const std::string& card : cards) {
+        rows.clear();
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+            auto it = accounts.find(card);
+            if (it == accounts.end()) continue;
+            const Account& a = it->second;
+            auto first = std::lower_bound(a.history.begin(), a.history.end(), since,
+                [](const Transaction& t, const std::string& time) { return t.createTime < time; });
+            StatementScanRow row;
+            row.cardNumber = card;
+            row.balanceCents = a.balance;
+            row.hasTransaction = false;
+            if (first == a.history.end()) rows.push_back(row);
+            for (auto t = first; t != a.history.end(); ++t) {
+                row.hasTransaction = true;
+                row.txn = {t->type, t->amount, t->balanceAfter, t->description, t->createTime};
+                rows.push_back(row);
+            }
+        }
+        for (const StatementScanRow& row : rows) fn(row);
+    }
+    return true;
+}
+
+bool MemoryLedger::balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) {
+    // 流水按时间追加，二分找到 asOf 之前的最后一条
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end()) return false;
+    const auto& history = it->second.history;
+    auto after = std::upper_bound(history.begin(), history.end(), asOf,
+        [](const std::string& time, const Transaction& t) { return time < t.createTime; });
+    cents = after == history.begin() ? 0 : (after - 1)->balanceAfter;
+    return true;
+}
+
+bool MemoryLedger::loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                                std::vector<SpendingBucket>& out) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end()) return false;
+    const auto& buckets = monthly ? it->second.monthlySpending : it->second.dailySpending;
+    for (auto b = buckets.lower_bound(from); b != buckets.end() && b->first <= to; ++b) {
+        out.push_back(b->second);
+        out.back().period = b->first;
+    }
+    return true;
+}
+
+double MemoryLedger::getBalance(const std::string& cardNumber) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    return it == accounts.end() ? -1.0 : fromCents(it->second.balance);
+}
+
+std::string MemoryLedger::getTransactionHistory(const std::string& cardNumber) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    ArenaString out;
+    out.reserve(4096);
+    out += "{\"status\":\"success\",\"transactions\":[";
+    auto it = accounts.find(cardNumber);
+    if (it != accounts.end()) {
+        const auto& history = it->second.history;
+        size_t shown = 0;
+        for (auto t = history.rbegin(); t != history.rend() && shown < 20; ++t, ++shown) {
+            if (shown > 0) out += ',';
+            out += "{\"type\":\"";
+            appendText(out, t->type);
+            out += "\",\"amount\":";
+            appendNumber(out, "%.2f", fromCents(t->amount));
+            out += ",\"balance_after\":";
+            appendNumber(out, "%.2f", fromCents(t->balanceAfter));
+            out += ",\"description\":\"";
+            appendEscapedJson(out, t->description);
+            out += "\",\"create_time\":\"";
+            appendText(out, t->createTime);
+            out += "\"}";
+        }
+    }
+    out += "]}";
+    return std::string(out.data(), out.size());
+}
+
+class MemoryLedger::HistoryCursor : public TransactionCursor {
+public:
+    HistoryCursor(MemoryLedger& ledger, const std::string& card, const std::string& from, const std::string& to)
+        : ledger(ledger), card(card), from(from), to(to) {}
+
+    bool next(TransactionRow& row) override {
+        if (bufferPos == buffer.size() && !refill()) return false;
+        row = std::move(buffer[bufferPos++]);
+        return true;
+    }
+
+private:
+    static const size_t batch = 256;
+
+    MemoryLedger& ledger;
+    std::string card, from, to;
+    size_t position = 0; // 下一条要读的流水下标
+    std::vector<TransactionRow> buffer;
+    size_t bufferPos = 0;
+
+    bool refill() {
+        buffer.clear();
+        bufferPos = 0;
+        std::shared_lock<std::shared_timed_mutex> lock(ledger.stateMutex);
+        auto it = ledger.accounts.find(card);
+        if (it == ledger.accounts.end()) return false;
+        const auto& history = it->second.history;
+        while (position < history.size() && buffer.size() < batch) {
+            const Transaction& t = history[position++];
+            if (!from.empty() && t.createTime < from) continue;
+            if (!to.empty() && t.createTime > to) return !buffer.empty(); // 流水按时间追加，后面不会再有
+            buffer.push_back({t.type, t.amount, t.balanceAfter, t.description, t.createTime});
+        }
+        return !buffer.empty();
+    }
+};
+
+std::unique_ptr<TransactionCursor> MemoryLedger::openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) {
+    return std::unique_ptr<TransactionCursor>(new HistoryCursor(*this, cardNumber, from, to));
+}
+
+bool MemoryLedger::isCardNumberExists(const std::string& cardNumber) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    return accounts.count(cardNumber) > 0;
+}
+
+std::string MemoryLedger::getUserName(const std::string& card_number) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(card_number);
+    return it == accounts.end() ? "" : it->second.name;
+}
+
+std::string MemoryLedger::getUserMessages(const std::string& card_number) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    ArenaString out;
+    out.reserve(4096);
+    out += "{\"status\":\"success\",\"messages\":[";
+    auto it = inboxes.find(card_number);
+    if (it != inboxes.end()) {
+        bool f = true;
+        for (auto m = it->second.rbegin(); m != it->second.rend(); ++m) {
+            if (!f) out += ',';
+            out += "{\"id\":";
+            appendNumber(out, "%lld", (long long)m->id);
+            out += ",\"sender_name\":\"";
+            appendEscapedJson(out, m->senderName);
+            out += "\",\"type\":\"";
+            appendText(out, m->type);
+            out += "\",\"amount\":";
+            appendNumber(out, "%g", fromCents(m->amount));
+            out += ",\"content\":\"";
+            appendEscapedJson(out, m->content);
+            out += "\",\"is_read\":";
+            out += m->isRead ? '1' : '0';
+            out += ",\"create_time\":\"";
+            appendText(out, m->createTime);
+            out += "\"}";
+            f = false;
+        }
+    }
+    out += "]}";
+    return std::string(out.data(), out.size());
+}
+
+bool MemoryLedger::verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    return it != accounts.end() && it->second.name == name && it->second.phone == phone;
+}
+
+bool MemoryLedger::checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) {
+    std::shared_lock<std::shared_timed_mutex> lock(stateMutex);
+    auto it = accounts.find(cardNumber);
+    if (it == accounts.end() || it->second.name != name || it->second.phone != phone) return false;
+    outBalance = fromCents(it->second.balance);
+    return true;
+}
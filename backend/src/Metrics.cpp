@@ -0,0 +1,68 @@
+#include "../include/Metrics.h"
+#include <sstream>
+#include <iomanip>
+#include <set>
+#include <map>
+
+Metrics& Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+void Metrics::add(const std::string& name, const std::string& help, const std::string& type, std::function<double()> read) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.push_back({name, help, type, std::move(read)});
+}
+
+std::string Metrics::render() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << std::setprecision(15);
+    std::set<std::string> described;
+    for (const auto& e : entries) {
+        // 同名不同标签的指标只输出一次 HELP/TYPE
+        std::string base = e.name.substr(0, e.name.find('{'));
+        if (described.insert(base).second) {
+            out << "# HELP " << base << " " << e.help << "\n";
+            out << "# TYPE " << base << " " << e.type << "\n";
+        }
+        out << e.name << " " << e.read() << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::merge(const std::vector<std::string>& texts, const std::string& label) {
+    // 按指标名首次出现的顺序输出，每个名字下先是 HELP/TYPE，再是各进程的样本
+    std::vector<std::string> order;
+    std::map<std::string, std::pair<std::string, std::string>> families;
+    for (size_t i = 0; i < texts.size(); i++) {
+        std::string tag = label + "=\"" + std::to_string(i) + "\"";
+        std::istringstream in(texts[i]);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            bool comment = line[0] == '#';
+            size_t start = comment ? line.find(' ', 2) + 1 : 0;
+            if (comment && start == 0) continue;
+            std::string base = line.substr(start, line.find_first_of("{ ", start) - start);
+            auto it = families.find(base);
+            if (it == families.end()) {
+                order.push_back(base);
+                it = families.emplace(base, std::make_pair(std::string(), std::string())).first;
+            }
+            if (comment) {
+                if (it->second.first.find(line) == std::string::npos) it->second.first += line + "\n";
+                continue;
+            }
+            size_t brace = base.size();
+            if (brace < line.size() && line[brace] == '{') {
+                it->second.second += line.substr(0, brace + 1) + tag + "," + line.substr(brace + 1) + "\n";
+            } else {
+                it->second.second += base + "{" + tag + "}" + line.substr(brace) + "\n";
+            }
+        }
+    }
+    std::string out;
+    for (const std::string& base : order) out += families[base].first + families[base].second;
+    return out;
+}
@@ -0,0 +1,35 @@
+#include "../include/PeriodicJob.h"
+#include <chrono>
+
+PeriodicJob::PeriodicJob(std::function<bool(int64_t& rows)> step, int intervalSec)
+    : step(std::move(step)), intervalSec(intervalSec < 1 ? 1 : intervalSec) {}
+
+PeriodicJob::~PeriodicJob() {
+    stop();
+}
+
+void PeriodicJob::start() {
+    worker = std::thread(&PeriodicJob::loop, this);
+}
+
+void PeriodicJob::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void PeriodicJob::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        // 执行期间不持锁，stop() 最多等一次 step 做完
+        lock.unlock();
+        int64_t rows = 0;
+        if (step(rows)) rowsWritten += (uint64_t)rows;
+        else failures++;
+        lock.lock();
+        cv.wait_for(lock, std::chrono::seconds(intervalSec), [this] { return stopping; });
+    }
+}
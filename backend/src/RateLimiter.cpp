@@ -0,0 +1,94 @@
+#include "../include/RateLimiter.h"
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const uint64_t kTokenBits = 24;
+const uint64_t kTokenMask = (1ull << kTokenBits) - 1;
+
+uint64_t pack(uint64_t ms, uint64_t tokens) {
+    return (ms << kTokenBits) | tokens;
+}
+
+}
+
+RateLimiter::RateLimiter(size_t slotCount, double burst, double perSecond)
+    : start(std::chrono::steady_clock::now()) {
+    size_t n = 1;
+    while (n < slotCount) n <<= 1;
+    slots.reset(new Slot[n]);
+    mask = n - 1;
+    capacity = std::min<uint64_t>(kTokenMask, (uint64_t)(std::max(burst, 1.0) * kScale));
+    refillPerMs = std::max(perSecond, 0.001) * kScale / 1000.0;
+}
+
+uint64_t RateLimiter::nowMs() const {
+    // 从 1 开始，保证打包后的状态不会是 0
+    return 1 + (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t RateLimiter::refill(uint64_t state, uint64_t now) const {
+    if (state == 0) return capacity;
+    uint64_t last = state >> kTokenBits;
+    uint64_t tokens = state & kTokenMask;
+    if (now > last) tokens += (uint64_t)((now - last) * refillPerMs);
+    return std::min(tokens, capacity);
+}
+
+int RateLimiter::take(Slot& slot) {
+    uint64_t now = nowMs();
+    uint64_t cur = slot.state.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t tokens = refill(cur, now);
+        if (tokens < kScale) {
+            rejected++;
+            return std::max(1, (int)std::ceil((kScale - tokens) / refillPerMs / 1000.0));
+        }
+        if (slot.state.compare_exchange_weak(cur, pack(now, tokens - kScale), std::memory_order_relaxed)) {
+            allowed++;
+            return 0;
+        }
+    }
+}
+
+int RateLimiter::acquire(const std::string& key) {
+    uint64_t h = std::hash<std::string>()(key);
+    if (h == 0) h = 1;
+    // 先在整个探测范围里找这个键：sweep 清空的位置不留标记，键可能排在空位后面，
+    // 见到空位就占会给已经耗尽的键新开一个满桶
+    for (int probe = 0; probe < kProbe; probe++) {
+        Slot& slot = slots[(h + probe) & mask];
+        if (slot.key.load(std::memory_order_acquire) == h) return take(slot);
+    }
+    for (int probe = 0; probe < kProbe; probe++) {
+        Slot& slot = slots[(h + probe) & mask];
+        uint64_t k = slot.key.load(std::memory_order_acquire);
+        if (k == 0 && slot.key.compare_exchange_strong(k, h, std::memory_order_acq_rel)) {
+            keys++;
+            return take(slot); // 新占的位置 state 为 0，即满桶
+        }
+        if (k == h) return take(slot); // 别的线程刚为同一个键占上
+    }
+    overflow++;
+    allowed++;
+    return 0;
+}
+
+int64_t RateLimiter::sweep() {
+    // 与并发的 acquire 竞争时最多让一次判定按满桶处理，换取整个表无锁
+    uint64_t now = nowMs();
+    int64_t cleared = 0;
+    for (size_t i = 0; i <= mask; i++) {
+        Slot& slot = slots[i];
+        uint64_t k = slot.key.load(std::memory_order_acquire);
+        if (k == 0 || refill(slot.state.load(std::memory_order_relaxed), now) < capacity) continue;
+        slot.state.store(0, std::memory_order_relaxed);
+        if (slot.key.compare_exchange_strong(k, 0, std::memory_order_acq_rel)) {
+            keys--;
+            cleared++;
+        }
+    }
+    return cleared;
+}
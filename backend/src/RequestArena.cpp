@@ -0,0 +1,123 @@
+#include "../include/RequestArena.h"
+#include <algorithm>
+#include <new>
+
+namespace {
+
+// 单个请求的上限，默认 4 MB；流水导出这类大响应本来就是流式写的，不会走到这里
+size_t limitBytes = 4 * 1024 * 1024;
+
+char* alignUp(char* p, size_t align) {
+    uintptr_t v = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char*>((v + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+}
+
+const size_t RequestArena::kBlockBytes;
+const size_t RequestArena::kKeepBytes;
+
+std::atomic<uint64_t> RequestArena::requests{0};
+std::atomic<uint64_t> RequestArena::arenaBytes{0};
+std::atomic<uint64_t> RequestArena::heapFallbacks{0};
+std::atomic<uint64_t> RequestArena::heapFallbackBytes{0};
+std::atomic<uint64_t> RequestArena::peakBytes{0};
+
+RequestArena& RequestArena::local() {
+    static thread_local RequestArena arena;
+    return arena;
+}
+
+void RequestArena::setLimit(size_t bytes) {
+    limitBytes = bytes;
+}
+
+RequestArena::~RequestArena() {
+    for (const Block& b : blocks) ::operator delete(b.data);
+}
+
+void RequestArena::begin() {
+    end();
+    inRequest = true;
+}
+
+void RequestArena::end() {
+    if (!inRequest) return;
+    inRequest = false;
+    requests++;
+    arenaBytes += bytes;
+    if (fallbacks > 0) {
+        heapFallbacks += fallbacks;
+        heapFallbackBytes += fallbackBytes;
+    }
+    uint64_t peak = peakBytes.load();
+    while (bytes > peak && !peakBytes.compare_exchange_weak(peak, bytes)) {}
+    bytes = fallbacks = fallbackBytes = 0;
+    current = 0;
+    used = 0;
+    last = nullptr;
+
+    // 前面的块留着，累计超过 kKeepBytes 的还回去
+    size_t kept = 0, keep = 0;
+    while (keep < blocks.size() && kept + blocks[keep].size <= kKeepBytes) kept += blocks[keep++].size;
+    for (size_t i = keep; i < blocks.size(); i++) ::operator delete(blocks[i].data);
+    blocks.resize(keep);
+}
+
+void* RequestArena::allocate(size_t n, size_t align) {
+    if (inRequest && bytes + n <= limitBytes && current < blocks.size()) {
+        Block& b = blocks[current];
+        char* p = alignUp(b.data + used, align);
+        if (p + n <= b.data + b.size) {
+            used = (size_t)(p + n - b.data);
+            bytes += n;
+            last = p;
+            return p;
+        }
+    }
+    return allocateSlow(n, align);
+}
+
+void* RequestArena::allocateSlow(size_t n, size_t align) {
+    if (!inRequest) return ::operator new(n);
+    if (bytes + n > limitBytes) {
+        fallbacks++;
+        fallbackBytes += n;
+        return ::operator new(n);
+    }
+    // 当前块放不下，换到下一块；下一块也放不下时新分配一块插在它前面
+    size_t need = n + align;
+    size_t next = blocks.empty() ? 0 : current + 1;
+    if (next >= blocks.size() || blocks[next].size < need) {
+        size_t size = std::max(kBlockBytes, need);
+        blocks.insert(blocks.begin() + (std::ptrdiff_t)next, Block{static_cast<char*>(::operator new(size)), size});
+    }
+    current = next;
+    Block& b = blocks[current];
+    char* p = alignUp(b.data, align);
+    used = (size_t)(p + n - b.data);
+    bytes += n;
+    last = p;
+    return p;
+}
+
+void RequestArena::deallocate(void* p, size_t n) {
+    (void)n;
+    if (p == nullptr) return;
+    if (p == last) {
+        // 最后一次分配的（常见于用完即弃的临时字符串）退回去
+        used = (size_t)(last - blocks[current].data);
+        last = nullptr;
+        return;
+    }
+    if (!owns(p)) ::operator delete(p);
+}
+
+bool RequestArena::owns(const void* p) const {
+    uintptr_t v = reinterpret_cast<uintptr_t>(p);
+    for (const Block& b : blocks) {
+        uintptr_t begin = reinterpret_cast<uintptr_t>(b.data);
+        if (v >= begin && v < begin + b.size) return true;
+    }
+    return false;
+}
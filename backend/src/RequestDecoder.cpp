@@ -0,0 +1,265 @@
+#include "../include/RequestDecoder.h"
+#include <cstdlib>
+#include <cmath>
+
+namespace {
+
+// 嵌套太深的请求体直接拒绝，跳过未知字段时不会递归爆栈
+const int kMaxDepth = 32;
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+template <typename S>
+void appendUtf8(S& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3F));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+}
+
+JsonScanner::JsonScanner(const std::string& text) : p(text.data()), end(text.data() + text.size()) {}
+
+void JsonScanner::skipSpace() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+}
+
+bool JsonScanner::consume(char c) {
+    skipSpace();
+    if (p < end && *p == c) {
+        p++;
+        return true;
+    }
+    return false;
+}
+
+bool JsonScanner::atEnd() {
+    skipSpace();
+    return p == end;
+}
+
+bool JsonScanner::fail(const std::string& m) {
+    if (message.empty()) message = m;
+    return false;
+}
+
+bool JsonScanner::typeError(const char* field) {
+    return fail(std::string("字段 ") + field + " 类型错误");
+}
+
+bool JsonScanner::readString(std::string& out) {
+    if (!consume('"')) return false;
+    // 没有转义时整段一次拷贝
+    const char* start = p;
+    while (p < end && *p != '"' && *p != '\\') {
+        if ((unsigned char)*p < 0x20) return fail("JSON 格式错误");
+        p++;
+    }
+    if (p < end && *p == '"') {
+        out.assign(start, p);
+        p++;
+        return true;
+    }
+    ArenaString scratch(start, p);
+    if (!unescape(scratch)) return false;
+    out.assign(scratch.data(), scratch.size());
+    return true;
+}
+
+template <typename S>
+bool JsonScanner::unescape(S& out) {
+    while (p < end && *p != '"') {
+        char c = *p++;
+        if ((unsigned char)c < 0x20) return fail("JSON 格式错误");
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (p == end) break;
+        switch (*p++) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t cp = 0;
+                for (int round = 0; round < 2; round++) {
+                    if (end - p < 4) return fail("JSON 格式错误");
+                    uint32_t unit = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int h = hexValue(p[i]);
+                        if (h < 0) return fail("JSON 格式错误");
+                        unit = unit << 4 | (uint32_t)h;
+                    }
+                    p += 4;
+                    if (round == 0) {
+                        cp = unit;
+                        // 高位代理后面必须跟 \u 低位代理
+                        if (unit < 0xD800 || unit > 0xDBFF) break;
+                        if (end - p < 2 || p[0] != '\\' || p[1] != 'u') return fail("JSON 格式错误");
+                        p += 2;
+                    } else {
+                        if (unit < 0xDC00 || unit > 0xDFFF) return fail("JSON 格式错误");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (unit - 0xDC00);
+                    }
+                }
+                if (cp >= 0xDC00 && cp <= 0xDFFF) return fail("JSON 格式错误");
+                appendUtf8(out, cp);
+                break;
+            }
+            default:
+                return fail("JSON 格式错误");
+        }
+    }
+    if (p == end) return fail("JSON 格式错误");
+    p++;
+    return true;
+}
+
+bool JsonScanner::readKey(const char*& key, size_t& length) {
+    skipSpace();
+    if (p == end || *p != '"') return false;
+    const char* start = p + 1;
+    const char* q = start;
+    while (q < end && *q != '"' && *q != '\\') q++;
+    if (q < end && *q == '"') {
+        key = start;
+        length = (size_t)(q - start);
+        p = q + 1;
+        return true;
+    }
+    keyBuffer.clear();
+    p = start;
+    if (!unescape(keyBuffer)) return false;
+    key = keyBuffer.data();
+    length = keyBuffer.size();
+    return true;
+}
+
+bool JsonScanner::scanNumber(const char*& begin, bool& fractional) {
+    skipSpace();
+    begin = p;
+    fractional = false;
+    const char* q = p;
+    if (q < end && *q == '-') q++;
+    if (q == end || *q < '0' || *q > '9') return false;
+    if (*q == '0') {
+        q++;
+    } else {
+        while (q < end && *q >= '0' && *q <= '9') q++;
+    }
+    if (q < end && *q == '.') {
+        fractional = true;
+        q++;
+        if (q == end || *q < '0' || *q > '9') return false;
+        while (q < end && *q >= '0' && *q <= '9') q++;
+    }
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        fractional = true;
+        q++;
+        if (q < end && (*q == '+' || *q == '-')) q++;
+        if (q == end || *q < '0' || *q > '9') return false;
+        while (q < end && *q >= '0' && *q <= '9') q++;
+    }
+    p = q;
+    return true;
+}
+
+bool JsonScanner::readNumber(double& out) {
+    const char* begin;
+    bool fractional;
+    if (!scanNumber(begin, fractional)) return false;
+    // 前面已按 JSON 语法确认过，strtod 不会越过数字本身；std::string 保证末尾有 '\0'
+    out = strtod(begin, nullptr);
+    return std::isfinite(out);
+}
+
+bool JsonScanner::readInteger(int64_t& out) {
+    const char* begin;
+    bool fractional;
+    if (!scanNumber(begin, fractional) || fractional) return false;
+    bool negative = *begin == '-';
+    uint64_t v = 0;
+    for (const char* q = begin + (negative ? 1 : 0); q < p; q++) {
+        uint64_t d = (uint64_t)(*q - '0');
+        if (v > (UINT64_MAX - d) / 10) return false;
+        v = v * 10 + d;
+    }
+    if (v > (uint64_t)INT64_MAX + (negative ? 1 : 0)) return false;
+    out = negative ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
+bool JsonScanner::readBool(bool& out) {
+    skipSpace();
+    if (end - p >= 4 && memcmp(p, "true", 4) == 0) {
+        out = true;
+        p += 4;
+        return true;
+    }
+    if (end - p >= 5 && memcmp(p, "false", 5) == 0) {
+        out = false;
+        p += 5;
+        return true;
+    }
+    return false;
+}
+
+bool JsonScanner::skipValue() {
+    skipSpace();
+    if (p == end) return fail("JSON 格式错误");
+    char c = *p;
+    if (c == '"') {
+        const char* key;
+        size_t length;
+        return readKey(key, length) || fail("JSON 格式错误");
+    }
+    if (c == '{' || c == '[') {
+        if (++depth > kMaxDepth) return fail("JSON 嵌套过深");
+        p++;
+        char close = c == '{' ? '}' : ']';
+        if (!consume(close)) {
+            do {
+                if (c == '{') {
+                    const char* key;
+                    size_t length;
+                    if (!readKey(key, length) || !consume(':')) return fail("JSON 格式错误");
+                }
+                if (!skipValue()) return false;
+            } while (consume(','));
+            if (!consume(close)) return fail("JSON 格式错误");
+        }
+        depth--;
+        return true;
+    }
+    if (end - p >= 4 && memcmp(p, "null", 4) == 0) {
+        p += 4;
+        return true;
+    }
+    bool b;
+    if (readBool(b)) return true;
+    const char* begin;
+    bool fractional;
+    return scanNumber(begin, fractional) || fail("JSON 格式错误");
+}
@@ -0,0 +1,216 @@
+#include "../include/SessionStore.h"
+#include <functional>
+#include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <sys/random.h>
+
+SessionStore::SessionStore(int ttlSec)
+    : ttlSec(ttlSec < 1 ? 1 : ttlSec), start(std::chrono::steady_clock::now()) {}
+
+uint64_t SessionStore::now() const {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+SessionStore::Shard& SessionStore::shardFor(const std::string& token) {
+    return shards[std::hash<std::string>()(token) % kShards];
+}
+
+std::string SessionStore::create(const std::string& cardNumber) {
+    unsigned char bytes[16];
+    size_t got = 0;
+    while (got < sizeof(bytes)) {
+        ssize_t n = getrandom(bytes + got, sizeof(bytes) - got, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return "";
+        }
+        got += (size_t)n;
+    }
+    static const char hex[] = "0123456789abcdef";
+    std::string token;
+    token.reserve(32);
+    for (unsigned char b : bytes) {
+        token += hex[b >> 4];
+        token += hex[b & 15];
+    }
+
+    Shard& shard = shardFor(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    uint64_t deadline = now() + ttlSec;
+    shard.sessions[token] = {cardNumber, deadline};
+    schedule(shard, token, deadline);
+    active++;
+    created++;
+    return token;
+}
+
+bool SessionStore::validate(const std::string& token, std::string& cardNumber) {
+    if (token.size() != 32) return false;
+    Shard& shard = shardFor(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(token);
+    uint64_t t = now();
+    if (it == shard.sessions.end() || it->second.expiresAt <= t) return false;
+    it->second.expiresAt = t + ttlSec; // 时间轮里的条目不动，到期检查时再顺延
+    cardNumber = it->second.cardNumber;
+    return true;
+}
+
+void SessionStore::revoke(const std::string& token) {
+    {
+        std::lock_guard<std::mutex> lock(handoffMutex);
+        if (tracking) revokedTokens.insert(token);
+    }
+    Shard& shard = shardFor(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.sessions.erase(token)) active--;
+}
+
+void SessionStore::revokeCard(const std::string& cardNumber, const std::string& exceptToken) {
+    {
+        std::lock_guard<std::mutex> lock(handoffMutex);
+        if (tracking) revokedCards.emplace_back(cardNumber, exceptToken);
+    }
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            if (it->second.cardNumber == cardNumber && it->first != exceptToken) {
+                it = shard.sessions.erase(it);
+                active--;
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void SessionStore::schedule(Shard& shard, const std::string& token, uint64_t deadline) {
+    if (deadline < shard.tick) deadline = shard.tick;
+    uint64_t delta = deadline - shard.tick;
+    if (delta < kNearSlots) {
+        shard.nearWheel[deadline % kNearSlots].push_back(token);
+        return;
+    }
+    // 超出第二级范围的先挂在最远的槽，降级时发现没到期会再挂一次
+    uint64_t block = deadline / kNearSlots;
+    uint64_t lastBlock = shard.tick / kNearSlots + kFarSlots - 1;
+    if (block > lastBlock) block = lastBlock;
+    shard.farWheel[block % kFarSlots].push_back(token);
+}
+
+int64_t SessionStore::advance(Shard& shard, uint64_t until) {
+    int64_t removed = 0;
+    uint64_t checked = 0;
+    std::vector<std::string> due;
+    while (shard.tick <= until) {
+        // 进入新的 256 秒区间时，把第二级对应槽的条目降到第一级
+        if (shard.tick % kNearSlots == 0) {
+            due.swap(shard.farWheel[(shard.tick / kNearSlots) % kFarSlots]);
+            for (const std::string& token : due) {
+                auto it = shard.sessions.find(token);
+                if (it != shard.sessions.end()) schedule(shard, token, it->second.expiresAt);
+            }
+            checked += due.size();
+            due.clear();
+        }
+        due.swap(shard.nearWheel[shard.tick % kNearSlots]);
+        for (const std::string& token : due) {
+            auto it = shard.sessions.find(token);
+            if (it == shard.sessions.end()) continue; // 已注销
+            if (it->second.expiresAt <= shard.tick) {
+                shard.sessions.erase(it);
+                removed++;
+            } else {
+                schedule(shard, token, it->second.expiresAt); // 期间被使用过，按新的到期时间重新挂入
+            }
+        }
+        checked += due.size();
+        due.clear();
+        shard.tick++;
+    }
+    sweepEntries += checked;
+    return removed;
+}
+
+int64_t SessionStore::sweep() {
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t until = now();
+    int64_t removed = 0;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        removed += advance(shard, until);
+    }
+    active -= removed;
+    expired += (uint64_t)removed;
+    sweepNanos += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    return removed;
+}
+
+void SessionStore::beginHandoff() {
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    tracking = true;
+}
+
+void SessionStore::endHandoff() {
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    tracking = false;
+    revokedTokens.clear();
+    revokedCards.clear();
+}
+
+std::string SessionStore::exportState() {
+    std::string out;
+    uint64_t t = now();
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& e : shard.sessions) {
+            if (e.second.expiresAt <= t) continue;
+            out += "S " + e.first + " " + e.second.cardNumber + " " + std::to_string(e.second.expiresAt - t) + "\n";
+        }
+    }
+    std::lock_guard<std::mutex> lock(handoffMutex);
+    for (const auto& token : revokedTokens) out += "T " + token + "\n";
+    // 保留的令牌为空时写 "-"，保证每行字段数固定
+    for (const auto& r : revokedCards) out += "C " + r.first + " " + (r.second.empty() ? "-" : r.second) + "\n";
+    return out;
+}
+
+size_t SessionStore::importState(const std::string& state) {
+    size_t added = 0;
+    std::istringstream in(state);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string tag, a, b;
+        fields >> tag >> a;
+        if (tag == "T") {
+            revoke(a);
+            continue;
+        }
+        if (tag == "C" && fields >> b) {
+            revokeCard(a, b == "-" ? "" : b);
+            continue;
+        }
+        uint64_t remaining = 0;
+        if (tag != "S" || a.size() != 32 || !(fields >> b >> remaining) || remaining == 0) continue;
+        {
+            std::lock_guard<std::mutex> lock(handoffMutex);
+            if (revokedTokens.count(a)) continue;
+            bool cardRevoked = false;
+            for (const auto& r : revokedCards) {
+                if (r.first == b && r.second != a) cardRevoked = true;
+            }
+            if (cardRevoked) continue;
+        }
+        Shard& shard = shardFor(a);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.sessions.count(a)) continue;
+        uint64_t deadline = now() + std::min<uint64_t>(remaining, (uint64_t)ttlSec);
+        shard.sessions[a] = {b, deadline};
+        schedule(shard, a, deadline);
+        active++;
+        added++;
+    }
+    return added;
+}
@@ -0,0 +1,1174 @@
+#include "../include/SqliteLedger.h"
+#include "../include/Md5.h"
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace {
+
+// 与 MySQL 版本保持同样的表结构；金额列以“分”为单位存整数，避免浮点累计误差
+const char* kSchema =
+    "CREATE TABLE IF NOT EXISTS users ("
+    "  user_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  name TEXT NOT NULL,"
+    "  id_card TEXT UNIQUE NOT NULL,"
+    "  phone TEXT NOT NULL,"
+    "  address TEXT,"
+    "  create_time DATETIME DEFAULT (datetime('now','localtime')));"
+    "CREATE TABLE IF NOT EXISTS cards ("
+    "  card_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  user_id INTEGER NOT NULL REFERENCES users(user_id) ON DELETE CASCADE,"
+    "  card_number TEXT UNIQUE NOT NULL,"
+    "  password_hash TEXT NOT NULL,"
+    "  balance INTEGER DEFAULT 0,"
+    "  status TEXT DEFAULT 'active' CHECK (status IN ('active','inactive','cancelled')),"
+    "  create_time DATETIME DEFAULT (datetime('now','localtime')),"
+    "  version INTEGER NOT NULL DEFAULT 0);"
+    "CREATE TABLE IF NOT EXISTS transactions ("
+    "  transaction_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  card_id INTEGER NOT NULL REFERENCES cards(card_id) ON DELETE CASCADE,"
+    "  type TEXT NOT NULL,"
+    "  amount INTEGER NOT NULL,"
+    "  balance_after INTEGER NOT NULL,"
+    "  description TEXT,"
+    "  create_time DATETIME DEFAULT (datetime('now','localtime')));"
+    "CREATE INDEX IF NOT EXISTS idx_transactions_card ON transactions(card_id, create_time);"
+    "CREATE TABLE IF NOT EXISTS messages ("
+    "  id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "  recipient_card TEXT NOT NULL,"
+    "  sender_name TEXT,"
+    "  type TEXT NOT NULL,"
+    "  amount INTEGER DEFAULT 0,"
+    "  content TEXT,"
+    "  is_read INTEGER DEFAULT 0,"
+    "  create_time DATETIME DEFAULT (datetime('now','localtime')));"
+    "CREATE INDEX IF NOT EXISTS idx_messages_recipient ON messages(recipient_card, create_time);"
+    "CREATE TABLE IF NOT EXISTS sequences ("
+    "  name TEXT PRIMARY KEY,"
+    "  next_value INTEGER NOT NULL);"
+    "CREATE INDEX IF NOT EXISTS idx_transactions_time ON transactions(create_time);"
+    "CREATE TABLE IF NOT EXISTS daily_balances ("
+    "  card_id INTEGER NOT NULL REFERENCES cards(card_id) ON DELETE CASCADE,"
+    "  snapshot_date TEXT NOT NULL,"
+    "  balance INTEGER NOT NULL,"
+    "  PRIMARY KEY (card_id, snapshot_date));"
+    "CREATE TABLE IF NOT EXISTS spending_rollups ("
+    "  card_id INTEGER NOT NULL REFERENCES cards(card_id) ON DELETE CASCADE,"
+    "  granularity TEXT NOT NULL,"
+    "  period TEXT NOT NULL,"
+    "  category TEXT NOT NULL,"
+    "  total INTEGER NOT NULL,"
+    "  count INTEGER NOT NULL,"
+    "  PRIMARY KEY (card_id, granularity, period, category));"
+    "CREATE TABLE IF NOT EXISTS statements ("
+    "  card_number TEXT NOT NULL,"
+    "  period TEXT NOT NULL,"
+    "  opening_balance INTEGER NOT NULL,"
+    "  closing_balance INTEGER NOT NULL,"
+    "  total_credit INTEGER NOT NULL,"
+    "  total_debit INTEGER NOT NULL,"
+    "  transaction_count INTEGER NOT NULL,"
+    "  create_time DATETIME DEFAULT (datetime('now','localtime')),"
+    "  PRIMARY KEY (card_number, period));";
+
+// 让 SQL 里可以像 MySQL 一样写 MD5(?)
+void md5Function(sqlite3_context* ctx, int, sqlite3_value** argv) {
+    const unsigned char* text = sqlite3_value_text(argv[0]);
+    if (!text) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    std::string hex = md5Hex(std::string((const char*)text, sqlite3_value_bytes(argv[0])));
+    sqlite3_result_text(ctx, hex.c_str(), (int)hex.size(), SQLITE_TRANSIENT);
+}
+
+// 请求路径上的语句，按编号取 SQL。每条连接打开时全部预编译进它的语句缓存，请求直接复用；表结构不对时立刻暴露
+enum StatementId {
+    kVerifyLogin,
+    kReserveInit,
+    kReserveRead,
+    kReserveUpdate,
+    kAccountProfile,
+    kBalance,
+    kDepositUpdate,
+    kCardBalance,
+    kDepositLog,
+    kWithdrawCheck,
+    kDebitCard,
+    kWithdrawLog,
+    kHistory,
+    kCardId,
+    kSnapshotBefore,
+    kBalanceAfter,
+    kSpending,
+    kCreateUser,
+    kCreateCard,
+    kOpenLog,
+    kCreditCard,
+    kTransactionLog,
+    kTransferMessage,
+    kUserName,
+    kMessages,
+    kMarkRead,
+    kSystemMessage,
+    kUpdateUser,
+    kBumpUserCards,
+    kVerifyIdentity,
+    kUpdatePassword,
+    kDeletionCheck,
+    kCardUser,
+    kDeleteMessages,
+    kDeleteTransactions,
+    kDeleteCard,
+    kDeleteUser,
+    kStatementCount
+};
+
+const char* const kStatements[kStatementCount] = {
+    "SELECT card_id FROM cards WHERE card_number = ? AND password_hash = MD5(?) AND status = 'active'",
+    "INSERT OR IGNORE INTO sequences (name, next_value) VALUES (?, 1)",
+    "SELECT next_value FROM sequences WHERE name = ?",
+    "UPDATE sequences SET next_value = ? WHERE name = ?",
+    "SELECT u.name, u.id_card, u.phone, u.address, c.balance, c.create_time FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?",
+    "SELECT balance FROM cards WHERE card_number = ?",
+    "UPDATE cards SET balance = balance + ?, version = version + 1 WHERE card_number = ?",
+    "SELECT card_id, balance FROM cards WHERE card_number = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'deposit', ?, ?, '存款')",
+    "SELECT balance, card_id FROM cards WHERE card_number = ?",
+    "UPDATE cards SET balance = balance - ?, version = version + 1 WHERE card_id = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'withdraw', ?, ?, '取款')",
+    "SELECT t.type, t.amount, t.balance_after, t.description, t.create_time FROM transactions t JOIN cards c ON t.card_id = c.card_id WHERE c.card_number = ? ORDER BY t.create_time DESC, t.transaction_id DESC LIMIT 20",
+    "SELECT card_id FROM cards WHERE card_number = ?",
+    "SELECT snapshot_date, balance FROM daily_balances WHERE card_id = ? AND snapshot_date < ? ORDER BY snapshot_date DESC LIMIT 1",
+    "SELECT balance_after FROM transactions WHERE card_id = ? AND create_time > ? AND create_time <= ? ORDER BY create_time DESC, transaction_id DESC LIMIT 1",
+    "SELECT c.card_id, r.period, r.category, r.total, r.count FROM cards c LEFT JOIN spending_rollups r ON r.card_id = c.card_id AND r.granularity = ? AND r.period >= ? AND r.period <= ? WHERE c.card_number = ? ORDER BY r.period",
+    "INSERT INTO users (name, id_card, phone, address) VALUES (?, ?, ?, ?)",
+    "INSERT INTO cards (user_id, card_number, password_hash, balance) VALUES (?, ?, MD5(?), ?)",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, 'open', ?, ?, '开户')",
+    "UPDATE cards SET balance = balance + ?, version = version + 1 WHERE card_id = ?",
+    "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES (?, ?, ?, ?, ?)",
+    "INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, ?, 'transfer', ?, ?)",
+    "SELECT u.name FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number = ?",
+    "SELECT id, sender_name, type, amount, content, is_read, create_time FROM messages WHERE recipient_card = ? ORDER BY create_time DESC, id DESC",
+    "UPDATE messages SET is_read = 1 WHERE id = ? AND recipient_card = ?",
+    "INSERT INTO messages (recipient_card, sender_name, type, amount, content) VALUES (?, '系统通知', 'system', 0, ?)",
+    "UPDATE users SET name = ?, id_card = ?, phone = ?, address = ? WHERE user_id = (SELECT user_id FROM cards WHERE card_number = ?)",
+    "UPDATE cards SET version = version + 1 WHERE user_id = (SELECT user_id FROM cards WHERE card_number = ?)",
+    "SELECT c.card_id FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?",
+    "UPDATE cards SET password_hash = MD5(?) WHERE card_number = ?",
+    "SELECT c.balance FROM cards c JOIN users u ON c.user_id = u.user_id WHERE c.card_number = ? AND u.name = ? AND u.phone = ?",
+    "SELECT card_id, user_id FROM cards WHERE card_number = ?",
+    "DELETE FROM messages WHERE recipient_card = ?",
+    "DELETE FROM transactions WHERE card_id = ?",
+    "DELETE FROM cards WHERE card_id = ?",
+    "DELETE FROM users WHERE user_id = ?",
+};
+
+// 按卡号批量查询时每条语句带的卡号个数；不足一批时用最后一个卡号补齐，语句只编译一次
+const size_t kCardBatch = 200;
+
+std::string withCardList(const std::string& head) {
+    std::string sql = head + " IN (";
+    for (size_t i = 0; i < kCardBatch; i++) sql += i ? ",?" : "?";
+    return sql + ")";
+}
+
+// 批量导入时每条多行 INSERT 写入的行数；users 每行 4 个参数，共 800 个，不超过旧版 SQLite 的 999 个上限
+const size_t kImportBatch = 200;
+
+// n 个 group 以逗号相连，用来拼多行 VALUES 和 IN 列表
+std::string repeated(const std::string& group, size_t n) {
+    std::string out;
+    for (size_t i = 0; i < n; i++) out += (i ? ", " : "") + group;
+    return out;
+}
+
+// 借用缓存中的预编译语句，析构时复位以便下次复用
+class Query {
+public:
+    Query(SqliteLedger::Connection& conn, const std::string& sql) : db(conn.db), stmt(conn.prepare(sql)) {}
+    Query(SqliteLedger::Connection& conn, StatementId id) : db(conn.db), stmt(conn.prepare(id)) {}
+    ~Query() {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    Query& bind(int idx, const std::string& v) {
+        sqlite3_bind_text(stmt, idx, v.data(), (int)v.size(), SQLITE_TRANSIENT);
+        return *this;
+    }
+    Query& bind(int idx, int64_t v) {
+        sqlite3_bind_int64(stmt, idx, v);
+        return *this;
+    }
+
+    // 有下一行返回 true，执行出错抛异常
+    bool next() {
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) return true;
+        if (rc == SQLITE_DONE) return false;
+        throw std::runtime_error(sqlite3_errmsg(db));
+    }
+    // 执行写语句，返回影响行数
+    int execute() {
+        while (next()) {}
+        return sqlite3_changes(db);
+    }
+
+    std::string text(int col) {
+        const unsigned char* p = sqlite3_column_text(stmt, col);
+        return p ? std::string((const char*)p, sqlite3_column_bytes(stmt, col)) : "";
+    }
+    int64_t integer(int col) { return sqlite3_column_int64(stmt, col); }
+    bool isNull(int col) { return sqlite3_column_type(stmt, col) == SQLITE_NULL; }
+
+private:
+    sqlite3* db;
+    sqlite3_stmt* stmt;
+};
+
+// BEGIN IMMEDIATE 一开始就拿写锁，避免读锁升级时的死锁；未提交则析构时回滚
+class Transaction {
+public:
+    explicit Transaction(SqliteLedger::Connection& conn) : conn(conn) { conn.exec("BEGIN IMMEDIATE"); }
+    ~Transaction() {
+        if (!committed) {
+            try { conn.exec("ROLLBACK"); } catch (...) {}
+        }
+    }
+    void commit() {
+        conn.exec("COMMIT");
+        committed = true;
+    }
+
+private:
+    SqliteLedger::Connection& conn;
+    bool committed = false;
+};
+
+// 导出游标用一条独立的只读连接，整个导出期间看到同一个 WAL 快照
+class SqliteTransactionCursor : public TransactionCursor {
+public:
+    ~SqliteTransactionCursor() {
+        if (stmt) sqlite3_finalize(stmt);
+        if (db) sqlite3_close(db);
+    }
+
+    bool open(const std::string& path, const std::string& cardNumber, const std::string& from, const std::string& to) {
+        if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) return false;
+        sqlite3_busy_timeout(db, 5000);
+        const char* sql =
+            "SELECT t.type, t.amount, t.balance_after, t.description, t.create_time FROM transactions t JOIN cards c ON t.card_id = c.card_id "
+            "WHERE c.card_number = ?1 AND (?2 = '' OR t.create_time >= ?2) AND (?3 = '' OR t.create_time <= ?3) "
+            "ORDER BY t.create_time, t.transaction_id";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return false;
+        sqlite3_bind_text(stmt, 1, cardNumber.data(), (int)cardNumber.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, from.data(), (int)from.size(), SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 3, to.data(), (int)to.size(), SQLITE_TRANSIENT);
+        return true;
+    }
+
+    bool next(TransactionRow& row) override {
+        if (sqlite3_step(stmt) != SQLITE_ROW) return false;
+        row.type = column(0);
+        row.amountCents = sqlite3_column_int64(stmt, 1);
+        row.balanceAfterCents = sqlite3_column_int64(stmt, 2);
+        row.description = column(3);
+        row.createTime = column(4);
+        return true;
+    }
+
+private:
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+
+    std::string column(int col) {
+        const unsigned char* p = sqlite3_column_text(stmt, col);
+        return p ? std::string((const char*)p, sqlite3_column_bytes(stmt, col)) : "";
+    }
+};
+
+}
+
+SqliteLedger::Connection::~Connection() {
+    for (sqlite3_stmt* stmt : byId) sqlite3_finalize(stmt);
+    for (auto& kv : bySql) sqlite3_finalize(kv.second);
+    if (db) sqlite3_close(db);
+}
+
+sqlite3_stmt* SqliteLedger::Connection::prepare(int id) {
+    if (byId.empty()) byId.assign(kStatementCount, nullptr);
+    sqlite3_stmt*& stmt = byId[id];
+    if (!stmt && sqlite3_prepare_v2(db, kStatements[id], -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error(sqlite3_errmsg(db));
+    }
+    return stmt;
+}
+
+sqlite3_stmt* SqliteLedger::Connection::prepare(const std::string& sql) {
+    auto it = bySql.find(sql);
+    if (it != bySql.end()) return it->second;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql.c_str(), (int)sql.size() + 1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error(sqlite3_errmsg(db));
+    }
+    bySql.emplace(sql, stmt);
+    return stmt;
+}
+
+void SqliteLedger::Connection::exec(const char* sql) {
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::string msg = err ? err : "sqlite error";
+        sqlite3_free(err);
+        throw std::runtime_error(msg);
+    }
+}
+
+SqliteLedger::SqliteLedger(const std::string& path) : path(path) {}
+
+SqliteLedger::Connection& SqliteLedger::connection() {
+    // 每个线程第一次访问时打开自己的连接（I/O 线程启动时由 prepareAll 打开），线程退出时关闭
+    thread_local std::unique_ptr<Connection> conn;
+    if (!conn) {
+        std::unique_ptr<Connection> fresh(new Connection());
+        if (sqlite3_open_v2(path.c_str(), &fresh->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+            throw std::runtime_error(fresh->db ? sqlite3_errmsg(fresh->db) : "sqlite open failed");
+        }
+        sqlite3_busy_timeout(fresh->db, 5000);
+        sqlite3_create_function(fresh->db, "md5", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, nullptr, md5Function, nullptr, nullptr);
+        fresh->exec("PRAGMA journal_mode=WAL; PRAGMA synchronous=FULL; PRAGMA foreign_keys=ON;");
+        conn = std::move(fresh);
+        // 建表之前（open 里第一次打开）语句还编译不了，留给 prepareAll
+        if (opened) {
+            for (int id = 0; id < kStatementCount; id++) conn->prepare(id);
+        }
+    }
+    return *conn;
+}
+
+bool SqliteLedger::open() {
+    try {
+        Connection& conn = connection();
+        conn.exec(kSchema);
+        // 旧库的 cards 表没有 version 列时补上
+        bool hasVersion = false;
+        {
+            Query q(conn, "SELECT name FROM pragma_table_info('cards')");
+            while (q.next()) hasVersion = hasVersion || q.text(0) == "version";
+        }
+        if (!hasVersion) conn.exec("ALTER TABLE cards ADD COLUMN version INTEGER NOT NULL DEFAULT 0");
+        opened = true;
+        std::cout << "SQLite 数据库已打开: " << path << std::endl;
+    } catch (std::exception& e) {
+        std::cerr << "SQLite 打开失败: " << e.what() << std::endl;
+    }
+    return opened;
+}
+
+bool SqliteLedger::verifyLogin(const std::string& cardNumber, const std::string& password) {
+    try {
+        Query q(connection(), kVerifyLogin);
+        q.bind(1, cardNumber).bind(2, password);
+        return q.next();
+    } catch (...) { return false; }
+}
+
+std::string SqliteLedger::getUserInfo(const std::string& cardNumber) {
+    try {
+        AccountProfile profile;
+        if (readProfile(cardNumber, profile)) return formatUserInfo(cardNumber, profile);
+        return "{\"status\":\"error\",\"message\":\"用户不存在\"}";
+    } catch (...) { return "{\"status\":\"error\",\"message\":\"数据库错误\"}"; }
+}
+
+bool SqliteLedger::loadAccountProfile(const std::string& cardNumber, AccountProfile& out) {
+    try {
+        return readProfile(cardNumber, out);
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::prepareAll() {
+    try {
+        Connection& conn = connection();
+        for (int id = 0; id < kStatementCount; id++) conn.prepare(id);
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "SQLite 预编译失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::recentCards(size_t limit, std::vector<std::string>& out) {
+    // 只看最近 limit 的几倍条流水，不扫全表
+    try {
+        Query q(connection(),
+                "SELECT c.card_number FROM (SELECT card_id, MAX(transaction_id) AS last_id FROM "
+                "(SELECT card_id, transaction_id FROM transactions ORDER BY transaction_id DESC LIMIT ?) GROUP BY card_id) r "
+                "JOIN cards c ON c.card_id = r.card_id ORDER BY r.last_id DESC LIMIT ?");
+        q.bind(1, (int64_t)limit * 4).bind(2, (int64_t)limit);
+        while (q.next()) out.push_back(q.text(0));
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::loadVersionedProfiles(const std::vector<std::string>& cards, std::vector<VersionedProfile>& out) {
+    static const std::string sql = withCardList(
+        "SELECT c.card_number, c.card_id, c.version, u.name, u.id_card, u.phone, u.address, c.balance, c.create_time "
+        "FROM users u JOIN cards c ON u.user_id = c.user_id WHERE c.card_number");
+    try {
+        for (size_t begin = 0; begin < cards.size(); begin += kCardBatch) {
+            Query q(connection(), sql.c_str());
+            for (size_t i = 0; i < kCardBatch; i++) q.bind((int)i + 1, cards[std::min(begin + i, cards.size() - 1)]);
+            while (q.next()) {
+                VersionedProfile v;
+                v.row.cardNumber = q.text(0);
+                v.row.cardId = q.integer(1);
+                v.row.version = q.integer(2);
+                v.profile.name = q.text(3); v.profile.idCard = q.text(4); v.profile.phone = q.text(5); v.profile.address = q.text(6);
+                v.profile.balanceCents = q.integer(7);
+                v.profile.createTime = q.text(8);
+                out.push_back(std::move(v));
+            }
+        }
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::loadCardVersions(const std::vector<std::string>& cards, std::vector<CardVersion>& out) {
+    static const std::string sql = withCardList("SELECT card_number, card_id, version FROM cards WHERE card_number");
+    try {
+        for (size_t begin = 0; begin < cards.size(); begin += kCardBatch) {
+            Query q(connection(), sql.c_str());
+            for (size_t i = 0; i < kCardBatch; i++) q.bind((int)i + 1, cards[std::min(begin + i, cards.size() - 1)]);
+            while (q.next()) {
+                CardVersion v;
+                v.cardNumber = q.text(0);
+                v.cardId = q.integer(1);
+                v.version = q.integer(2);
+                out.push_back(std::move(v));
+            }
+        }
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::scanCardNumbers(int partition, int partitions, const std::function<void(const std::string&)>& fn) {
+    // 每个扫描线程用自己的连接，WAL 模式下读互不阻塞
+    try {
+        Query q(connection(), "SELECT card_number FROM cards WHERE card_id % ? = ?");
+        q.bind(1, (int64_t)partitions).bind(2, (int64_t)partition);
+        while (q.next()) fn(q.text(0));
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::reserveSequence(const std::string& name, int64_t count, int64_t& first) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        {
+            Query init(conn, kReserveInit);
+            init.bind(1, name);
+            init.execute();
+        }
+        {
+            Query sel(conn, kReserveRead);
+            sel.bind(1, name);
+            if (!sel.next()) return false;
+            first = sel.integer(0);
+        }
+        Query upd(conn, kReserveUpdate);
+        upd.bind(1, first + count).bind(2, name);
+        upd.execute();
+        txn.commit();
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::readProfile(const std::string& cardNumber, AccountProfile& out) {
+    Query q(connection(), kAccountProfile);
+    q.bind(1, cardNumber);
+    if (!q.next()) return false;
+    out.name = q.text(0); out.idCard = q.text(1); out.phone = q.text(2); out.address = q.text(3);
+    out.balanceCents = q.integer(4);
+    out.createTime = q.text(5);
+    return true;
+}
+
+double SqliteLedger::getBalance(const std::string& cardNumber) {
+    try {
+        Query q(connection(), kBalance);
+        q.bind(1, cardNumber);
+        if (q.next()) return fromCents(q.integer(0));
+        return -1.0;
+    } catch (...) { return -1.0; }
+}
+
+bool SqliteLedger::deposit(const std::string& cardNumber, double amount) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        int64_t cardId = 0, newBalance = 0;
+        {
+            Query upd(conn, kDepositUpdate);
+            upd.bind(1, toCents(amount)).bind(2, cardNumber);
+            if (upd.execute() == 0) return false;
+        }
+        {
+            Query sel(conn, kCardBalance);
+            sel.bind(1, cardNumber);
+            sel.next();
+            cardId = sel.integer(0);
+            newBalance = sel.integer(1);
+        }
+        Query log(conn, kDepositLog);
+        log.bind(1, cardId).bind(2, toCents(amount)).bind(3, newBalance);
+        log.execute();
+        txn.commit();
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::withdraw(const std::string& cardNumber, double amount) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        int64_t cardId = 0, balance = 0;
+        {
+            Query check(conn, kWithdrawCheck);
+            check.bind(1, cardNumber);
+            if (!check.next()) return false;
+            balance = check.integer(0);
+            cardId = check.integer(1);
+        }
+        if (balance < toCents(amount)) return false;
+        {
+            Query upd(conn, kDebitCard);
+            upd.bind(1, toCents(amount)).bind(2, cardId);
+            upd.execute();
+        }
+        Query log(conn, kWithdrawLog);
+        log.bind(1, cardId).bind(2, toCents(amount)).bind(3, balance - toCents(amount));
+        log.execute();
+        txn.commit();
+        return true;
+    } catch (...) { return false; }
+}
+
+std::string SqliteLedger::getTransactionHistory(const std::string& cardNumber) {
+    try {
+        Query q(connection(), kHistory);
+        q.bind(1, cardNumber);
+        // 逐行拼进请求内存，最后一次拷贝
+        ArenaString out;
+        out.reserve(4096);
+        out += "{\"status\":\"success\",\"transactions\":[";
+        bool f = true;
+        while (q.next()) {
+            if (!f) out += ',';
+            out += "{\"type\":\"";
+            appendText(out, q.text(0));
+            out += "\",\"amount\":";
+            appendNumber(out, "%.2f", fromCents(q.integer(1)));
+            out += ",\"balance_after\":";
+            appendNumber(out, "%.2f", fromCents(q.integer(2)));
+            out += ",\"description\":\"";
+            appendEscapedJson(out, q.text(3));
+            out += "\",\"create_time\":\"";
+            appendText(out, q.text(4));
+            out += "\"}";
+            f = false;
+        }
+        out += "]}";
+        return std::string(out.data(), out.size());
+    } catch (...) { return "{\"status\":\"error\"}"; }
+}
+
+std::unique_ptr<TransactionCursor> SqliteLedger::openTransactionCursor(const std::string& cardNumber, const std::string& from, const std::string& to) {
+    std::unique_ptr<SqliteTransactionCursor> cursor(new SqliteTransactionCursor());
+    if (!cursor->open(path, cardNumber, from, to)) return nullptr;
+    return cursor;
+}
+
+bool SqliteLedger::scanStatementPartition(int partition, int partitions, const std::string& since,
+                                          const std::function<void(const StatementScanRow&)>& fn) {
+    // 每个工作线程用自己的连接；单条语句本身就在同一个 WAL 快照里读，不需要写锁
+    try {
+        Connection& conn = connection();
+        Query q(conn,
+            "SELECT c.card_number, c.balance, t.type, t.amount, t.balance_after, t.description, t.create_time "
+            "FROM cards c LEFT JOIN transactions t ON t.card_id = c.card_id AND t.create_time >= ? "
+            "WHERE c.card_id % ? = ? ORDER BY c.card_id, t.create_time, t.transaction_id");
+        q.bind(1, since).bind(2, (int64_t)partitions).bind(3, (int64_t)partition);
+        StatementScanRow row;
+        while (q.next()) {
+            row.cardNumber = q.text(0);
+            row.balanceCents = q.integer(1);
+            row.hasTransaction = !q.isNull(2);
+            if (row.hasTransaction) {
+                row.txn.type = q.text(2);
+                row.txn.amountCents = q.integer(3);
+                row.txn.balanceAfterCents = q.integer(4);
+                row.txn.description = q.text(5);
+                row.txn.createTime = q.text(6);
+            }
+            fn(row);
+        }
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "对账单扫描失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::saveStatementSummaries(const std::vector<StatementSummary>& rows) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        for (const StatementSummary& r : rows) {
+            Query upsert(conn,
+                "INSERT OR REPLACE INTO statements (card_number, period, opening_balance, closing_balance, total_credit, total_debit, transaction_count) "
+                "VALUES (?, ?, ?, ?, ?, ?, ?)");
+            upsert.bind(1, r.cardNumber).bind(2, r.period).bind(3, r.openingCents).bind(4, r.closingCents)
+                  .bind(5, r.creditCents).bind(6, r.debitCents).bind(7, r.count);
+            upsert.execute();
+        }
+        txn.commit();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "写入对账单汇总失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::rollDailyBalances(const std::string& today, int64_t& rows) {
+    rows = 0;
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        // 从最后一个快照日的次日做起，每张卡每天取当天最后一条流水的余额
+        std::string from = "0000-00-00";
+        {
+            Query last(conn, "SELECT date(MAX(snapshot_date), '+1 day') FROM daily_balances");
+            if (last.next() && !last.isNull(0)) from = last.text(0);
+        }
+        Query roll(conn,
+            "INSERT OR REPLACE INTO daily_balances (card_id, snapshot_date, balance) "
+            "SELECT t.card_id, date(t.create_time), t.balance_after FROM transactions t "
+            "JOIN (SELECT MAX(transaction_id) AS id FROM transactions WHERE create_time >= ? AND create_time < ? "
+            "      GROUP BY card_id, date(create_time)) last ON t.transaction_id = last.id");
+        roll.bind(1, from).bind(2, today);
+        rows = roll.execute();
+        txn.commit();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "日终余额快照失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::balanceAsOf(const std::string& cardNumber, const std::string& asOf, int64_t& cents) {
+    try {
+        Connection& conn = connection();
+        int64_t cardId = 0;
+        {
+            Query card(conn, kCardId);
+            card.bind(1, cardNumber);
+            if (!card.next()) return false;
+            cardId = card.integer(0);
+        }
+        // asOf 当天的快照是日终余额，只能用前一天及更早的
+        std::string after = "0000-00-00 00:00:00";
+        cents = 0;
+        {
+            Query snap(conn, kSnapshotBefore);
+            snap.bind(1, cardId).bind(2, asOf.substr(0, 10));
+            if (snap.next()) {
+                after = snap.text(0) + " 23:59:59";
+                cents = snap.integer(1);
+            }
+        }
+        Query delta(conn, kBalanceAfter);
+        delta.bind(1, cardId).bind(2, after).bind(3, asOf);
+        if (delta.next()) cents = delta.integer(0);
+        return true;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::rollupSpending(int64_t& rows) {
+    const int64_t batch = 10000;
+    rows = 0;
+    try {
+        Connection& conn = connection();
+        for (;;) {
+            // 写事务串行提交，transaction_id 的顺序就是提交顺序，按编号追尾不会漏；
+            // 进度和统计在同一个事务里更新
+            Transaction txn(conn);
+            int64_t next = 1;
+            {
+                Query sel(conn, "SELECT next_value FROM sequences WHERE name = 'spending_rollup'");
+                if (sel.next()) next = sel.integer(0);
+            }
+            std::map<std::tuple<int64_t, char, std::string, int>, std::pair<int64_t, int64_t>> sums;
+            int64_t seen = 0;
+            {
+                Query tail(conn, "SELECT transaction_id, card_id, type, amount, description, create_time FROM transactions "
+                                 "WHERE transaction_id >= ? ORDER BY transaction_id LIMIT ?");
+                tail.bind(1, next).bind(2, batch);
+                while (tail.next()) {
+                    next = tail.integer(0) + 1;
+                    int category = spendingCategory(tail.text(2), tail.text(4));
+                    std::string time = tail.text(5);
+                    for (char g : {'D', 'M'}) {
+                        auto& sum = sums[std::make_tuple(tail.integer(1), g, time.substr(0, g == 'D' ? 10 : 7), category)];
+                        sum.first += tail.integer(3);
+                        sum.second++;
+                    }
+                    seen++;
+                }
+            }
+            if (seen == 0) return true;
+            for (const auto& kv : sums) {
+                Query upsert(conn,
+                    "INSERT INTO spending_rollups (card_id, granularity, period, category, total, count) VALUES (?, ?, ?, ?, ?, ?) "
+                    "ON CONFLICT (card_id, granularity, period, category) DO UPDATE SET "
+                    "total = total + excluded.total, count = count + excluded.count");
+                upsert.bind(1, std::get<0>(kv.first)).bind(2, std::string(1, std::get<1>(kv.first))).bind(3, std::get<2>(kv.first))
+                      .bind(4, std::string(spendingCategoryName(std::get<3>(kv.first))))
+                      .bind(5, kv.second.first).bind(6, kv.second.second);
+                upsert.execute();
+            }
+            {
+                Query progress(conn, "INSERT OR REPLACE INTO sequences (name, next_value) VALUES ('spending_rollup', ?)");
+                progress.bind(1, next);
+                progress.execute();
+            }
+            txn.commit();
+            rows += seen;
+            if (seen < batch) return true;
+        }
+    } catch (std::exception& e) {
+        std::cerr << "消费统计汇总失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::loadSpending(const std::string& cardNumber, bool monthly, const std::string& from, const std::string& to,
+                                std::vector<SpendingBucket>& out) {
+    try {
+        Connection& conn = connection();
+        Query q(conn, kSpending);
+        q.bind(1, std::string(monthly ? "M" : "D")).bind(2, from).bind(3, to).bind(4, cardNumber);
+        bool found = false;
+        while (q.next()) {
+            found = true;
+            if (q.isNull(1)) continue;
+            std::string period = q.text(1);
+            int category = spendingCategoryFromName(q.text(2));
+            if (category < 0) continue;
+            if (out.empty() || out.back().period != period) {
+                out.emplace_back();
+                out.back().period = period;
+            }
+            out.back().cents[category] = q.integer(3);
+            out.back().count[category] = q.integer(4);
+        }
+        return found;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::isCardNumberExists(const std::string& cardNumber) {
+    try {
+        Query q(connection(), kCardId);
+        q.bind(1, cardNumber);
+        return q.next();
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::createAccount(const std::string& name, const std::string& idCard,
+                                 const std::string& phone, const std::string& address,
+                                 const std::string& cardNumber, const std::string& password,
+                                 double initialDeposit) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        NewAccount a;
+        a.name = name; a.idCard = idCard; a.phone = phone; a.address = address;
+        a.cardNumber = cardNumber; a.password = password; a.initialDeposit = initialDeposit;
+        if (!insertAccount(conn, a)) return false;
+        txn.commit();
+        return true;
+    } catch (...) { return false; }
+}
+
+void SqliteLedger::createAccounts(const std::vector<NewAccount>& rows, std::vector<bool>& created) {
+    const size_t chunk = 5000;
+    created.assign(rows.size(), false);
+    try {
+        Connection& conn = connection();
+        for (size_t begin = 0; begin < rows.size(); begin += chunk) {
+            size_t end = std::min(rows.size(), begin + chunk);
+            // 一块一个事务，块内每 kImportBatch 行一条多行 INSERT；整批失败（通常是卡号或身份证号已存在）时
+            // 回滚这一批再逐行重试，每行用保存点隔开，坏行只回滚自己。凑不满一批的尾部直接逐行写
+            Transaction txn(conn);
+            std::vector<bool> ok(end - begin, false);
+            auto insertRows = [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; i++) {
+                    conn.exec("SAVEPOINT import_row");
+                    try {
+                        ok[i - begin] = insertAccount(conn, rows[i]);
+                    } catch (...) {}
+                    if (!ok[i - begin]) conn.exec("ROLLBACK TO import_row");
+                    conn.exec("RELEASE import_row");
+                }
+            };
+            size_t i = begin;
+            for (; i + kImportBatch <= end; i += kImportBatch) {
+                conn.exec("SAVEPOINT import_batch");
+                bool batched = false;
+                try {
+                    insertAccountBatch(conn, rows, i);
+                    batched = true;
+                } catch (...) {}
+                if (!batched) conn.exec("ROLLBACK TO import_batch");
+                conn.exec("RELEASE import_batch");
+                if (batched) std::fill(ok.begin() + (i - begin), ok.begin() + (i - begin + kImportBatch), true);
+                else insertRows(i, i + kImportBatch);
+            }
+            insertRows(i, end);
+            txn.commit();
+            std::copy(ok.begin(), ok.end(), created.begin() + begin);
+        }
+    } catch (...) {}
+}
+
+bool SqliteLedger::insertAccount(Connection& conn, const NewAccount& a) {
+    if (isCardNumberExists(a.cardNumber)) return false;
+    {
+        Query user(conn, kCreateUser);
+        user.bind(1, a.name).bind(2, a.idCard).bind(3, a.phone).bind(4, a.address);
+        user.execute();
+    }
+    int64_t uid = sqlite3_last_insert_rowid(conn.db);
+    {
+        Query card(conn, kCreateCard);
+        card.bind(1, uid).bind(2, a.cardNumber).bind(3, a.password).bind(4, toCents(a.initialDeposit));
+        card.execute();
+    }
+    int64_t cid = sqlite3_last_insert_rowid(conn.db);
+    Query trans(conn, kOpenLog);
+    trans.bind(1, cid).bind(2, toCents(a.initialDeposit)).bind(3, toCents(a.initialDeposit));
+    trans.execute();
+    return true;
+}
+
+void SqliteLedger::insertAccountBatch(Connection& conn, const std::vector<NewAccount>& rows, size_t begin) {
+    static const std::string usersSql = "INSERT INTO users (name, id_card, phone, address) VALUES " + repeated("(?, ?, ?, ?)", kImportBatch);
+    static const std::string userIdsSql = "SELECT user_id, id_card FROM users WHERE id_card IN (" + repeated("?", kImportBatch) + ")";
+    static const std::string cardsSql = "INSERT INTO cards (user_id, card_number, password_hash, balance) VALUES " + repeated("(?, ?, MD5(?), ?)", kImportBatch);
+    static const std::string cardIdsSql = "SELECT card_id, card_number FROM cards WHERE card_number IN (" + repeated("?", kImportBatch) + ")";
+    static const std::string openSql = "INSERT INTO transactions (card_id, type, amount, balance_after, description) VALUES " + repeated("(?, 'open', ?, ?, '开户')", kImportBatch);
+    {
+        Query users(conn, usersSql);
+        for (size_t i = 0; i < kImportBatch; i++) {
+            const NewAccount& a = rows[begin + i];
+            users.bind((int)i * 4 + 1, a.name).bind((int)i * 4 + 2, a.idCard).bind((int)i * 4 + 3, a.phone).bind((int)i * 4 + 4, a.address);
+        }
+        users.execute();
+    }
+    // 与 MySQL 版本一样按唯一键查回自增 ID，不依赖多行插入的 ID 连续
+    std::unordered_map<std::string, int64_t> userIds;
+    {
+        Query sel(conn, userIdsSql);
+        for (size_t i = 0; i < kImportBatch; i++) sel.bind((int)i + 1, rows[begin + i].idCard);
+        while (sel.next()) userIds[sel.text(1)] = sel.integer(0);
+    }
+    {
+        Query cards(conn, cardsSql);
+        for (size_t i = 0; i < kImportBatch; i++) {
+            const NewAccount& a = rows[begin + i];
+            cards.bind((int)i * 4 + 1, userIds.at(a.idCard)).bind((int)i * 4 + 2, a.cardNumber).bind((int)i * 4 + 3, a.password).bind((int)i * 4 + 4, toCents(a.initialDeposit));
+        }
+        cards.execute();
+    }
+    std::unordered_map<std::string, int64_t> cardIds;
+    {
+        Query sel(conn, cardIdsSql);
+        for (size_t i = 0; i < kImportBatch; i++) sel.bind((int)i + 1, rows[begin + i].cardNumber);
+        while (sel.next()) cardIds[sel.text(1)] = sel.integer(0);
+    }
+    Query trans(conn, openSql);
+    for (size_t i = 0; i < kImportBatch; i++) {
+        const NewAccount& a = rows[begin + i];
+        trans.bind((int)i * 3 + 1, cardIds.at(a.cardNumber)).bind((int)i * 3 + 2, toCents(a.initialDeposit)).bind((int)i * 3 + 3, toCents(a.initialDeposit));
+    }
+    trans.execute();
+}
+
+bool SqliteLedger::transfer(const std::string& from_card, const std::string& to_card, double amount, const std::string& message, bool is_anonymous) {
+    if (from_card == to_card || amount <= 0) return false;
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        int64_t cents = toCents(amount);
+        int64_t srcId = 0, dstId = 0, srcBalance = 0, dstBalance = 0;
+        {
+            Query src(conn, kCardBalance);
+            src.bind(1, from_card);
+            if (!src.next()) throw std::runtime_error("付款人不存在");
+            srcId = src.integer(0);
+            srcBalance = src.integer(1);
+        }
+        if (srcBalance < cents) throw std::runtime_error("余额不足");
+        {
+            Query dst(conn, kCardBalance);
+            dst.bind(1, to_card);
+            if (!dst.next()) throw std::runtime_error("收款人不存在");
+            dstId = dst.integer(0);
+            dstBalance = dst.integer(1);
+        }
+        {
+            Query upd(conn, kCreditCard);
+            upd.bind(1, -cents).bind(2, srcId);
+            upd.execute();
+        }
+        {
+            Query upd(conn, kCreditCard);
+            upd.bind(1, cents).bind(2, dstId);
+            upd.execute();
+        }
+        std::string sName = is_anonymous ? "匿名用户" : lookupUserName(from_card);
+        {
+            Query log(conn, kTransactionLog);
+            log.bind(1, srcId).bind(2, std::string("withdraw")).bind(3, cents).bind(4, srcBalance - cents).bind(5, "转账给 " + to_card);
+            log.execute();
+        }
+        {
+            Query log(conn, kTransactionLog);
+            log.bind(1, dstId).bind(2, std::string("deposit")).bind(3, cents).bind(4, dstBalance + cents).bind(5, "收到 " + sName + " 转账");
+            log.execute();
+        }
+        Query msg(conn, kTransferMessage);
+        msg.bind(1, to_card).bind(2, sName).bind(3, cents).bind(4, message);
+        msg.execute();
+        txn.commit();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "Transfer Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void SqliteLedger::transferBatch(const std::string& from_card, const std::vector<TransferLine>& lines, bool is_anonymous, std::vector<bool>& ok) {
+    const size_t chunk = 1000;
+    ok.assign(lines.size(), false);
+    std::string sName = is_anonymous ? "匿名用户" : lookupUserName(from_card);
+    try {
+        Connection& conn = connection();
+        for (size_t begin = 0; begin < lines.size(); begin += chunk) {
+            size_t end = std::min(lines.size(), begin + chunk);
+            Transaction txn(conn);
+            int64_t srcId = 0, srcBalance = 0;
+            {
+                Query src(conn, kCardBalance);
+                src.bind(1, from_card);
+                if (!src.next()) return;
+                srcId = src.integer(0);
+                srcBalance = src.integer(1);
+            }
+            // 付款卡在块末只扣一次，收款卡逐行入账
+            int64_t debit = 0;
+            std::vector<bool> chunkOk(end - begin, false);
+            for (size_t i = begin; i < end; i++) {
+                const TransferLine& line = lines[i];
+                int64_t cents = toCents(line.amount);
+                if (line.toCard == from_card || cents <= 0 || srcBalance - debit < cents) continue;
+                int64_t dstId = 0, dstBalance = 0;
+                {
+                    Query dst(conn, kCardBalance);
+                    dst.bind(1, line.toCard);
+                    if (!dst.next()) continue;
+                    dstId = dst.integer(0);
+                    dstBalance = dst.integer(1);
+                }
+                debit += cents;
+                {
+                    Query upd(conn, kCreditCard);
+                    upd.bind(1, cents).bind(2, dstId);
+                    upd.execute();
+                }
+                {
+                    Query log(conn, kTransactionLog);
+                    log.bind(1, srcId).bind(2, std::string("withdraw")).bind(3, cents).bind(4, srcBalance - debit).bind(5, "转账给 " + line.toCard);
+                    log.execute();
+                }
+                {
+                    Query log(conn, kTransactionLog);
+                    log.bind(1, dstId).bind(2, std::string("deposit")).bind(3, cents).bind(4, dstBalance + cents).bind(5, "收到 " + sName + " 转账");
+                    log.execute();
+                }
+                Query msg(conn, kTransferMessage);
+                msg.bind(1, line.toCard).bind(2, sName).bind(3, cents).bind(4, line.message);
+                msg.execute();
+                chunkOk[i - begin] = true;
+            }
+            if (debit) {
+                Query upd(conn, kCreditCard);
+                upd.bind(1, -debit).bind(2, srcId);
+                upd.execute();
+            }
+            txn.commit();
+            std::copy(chunkOk.begin(), chunkOk.end(), ok.begin() + begin);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Batch Transfer Error: " << e.what() << std::endl;
+    }
+}
+
+std::string SqliteLedger::getUserName(const std::string& card_number) {
+    try {
+        Query q(connection(), kUserName);
+        q.bind(1, card_number);
+        if (q.next()) return q.text(0);
+        return "";
+    } catch (...) { return ""; }
+}
+
+std::string SqliteLedger::getUserMessages(const std::string& card_number) {
+    try {
+        Query q(connection(), kMessages);
+        q.bind(1, card_number);
+        ArenaString out;
+        out.reserve(4096);
+        out += "{\"status\":\"success\",\"messages\":[";
+        bool f = true;
+        while (q.next()) {
+            if (!f) out += ',';
+            out += "{\"id\":";
+            appendNumber(out, "%lld", (long long)q.integer(0));
+            out += ",\"sender_name\":\"";
+            appendEscapedJson(out, q.text(1));
+            out += "\",\"type\":\"";
+            appendText(out, q.text(2));
+            out += "\",\"amount\":";
+            appendNumber(out, "%g", fromCents(q.integer(3)));
+            out += ",\"content\":\"";
+            appendEscapedJson(out, q.text(4));
+            out += "\",\"is_read\":";
+            appendNumber(out, "%lld", (long long)q.integer(5));
+            out += ",\"create_time\":\"";
+            appendText(out, q.text(6));
+            out += "\"}";
+            f = false;
+        }
+        out += "]}";
+        return std::string(out.data(), out.size());
+    } catch (...) { return "{\"status\":\"error\"}"; }
+}
+
+bool SqliteLedger::markMessageRead(const std::string& card_number, int message_id) {
+    try {
+        Query q(connection(), kMarkRead);
+        q.bind(1, (int64_t)message_id).bind(2, card_number);
+        return q.execute() > 0;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::sendSystemMessage(const std::string& to_card, const std::string&, const std::string& content) {
+    try {
+        Query q(connection(), kSystemMessage);
+        q.bind(1, to_card).bind(2, content);
+        return q.execute() > 0;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::updateUserInfo(const std::string& cardNumber, const std::string& name, const std::string& idCard, const std::string& phone, const std::string& address) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        {
+            Query q(conn, kUpdateUser);
+            q.bind(1, name).bind(2, idCard).bind(3, phone).bind(4, address).bind(5, cardNumber);
+            if (q.execute() == 0) return false;
+        }
+        // 该用户名下各卡的资料都变了，版本号一起递增
+        Query bump(conn, kBumpUserCards);
+        bump.bind(1, cardNumber);
+        bump.execute();
+        txn.commit();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "Update User Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool SqliteLedger::verifyIdentity(const std::string& cardNumber, const std::string& name, const std::string& phone) {
+    try {
+        Query q(connection(), kVerifyIdentity);
+        q.bind(1, cardNumber).bind(2, name).bind(3, phone);
+        return q.next();
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::updatePassword(const std::string& cardNumber, const std::string& newPassword) {
+    try {
+        Query q(connection(), kUpdatePassword);
+        q.bind(1, newPassword).bind(2, cardNumber);
+        return q.execute() > 0;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::checkAccountForDeletion(const std::string& cardNumber, const std::string& name, const std::string& phone, double& outBalance) {
+    try {
+        Query q(connection(), kDeletionCheck);
+        q.bind(1, cardNumber).bind(2, name).bind(3, phone);
+        if (q.next()) {
+            outBalance = fromCents(q.integer(0));
+            return true;
+        }
+        return false;
+    } catch (...) { return false; }
+}
+
+bool SqliteLedger::deleteAccount(const std::string& cardNumber) {
+    try {
+        Connection& conn = connection();
+        Transaction txn(conn);
+        int64_t cardId = 0, userId = 0;
+        {
+            Query sel(conn, kCardUser);
+            sel.bind(1, cardNumber);
+            if (!sel.next()) throw std::runtime_error("Not Found");
+            cardId = sel.integer(0);
+            userId = sel.integer(1);
+        }
+        {
+            Query q(conn, kDeleteMessages);
+            q.bind(1, cardNumber);
+            q.execute();
+        }
+        {
+            Query q(conn, kDeleteTransactions);
+            q.bind(1, cardId);
+            q.execute();
+        }
+        {
+            Query q(conn, kDeleteCard);
+            q.bind(1, cardId);
+            q.execute();
+        }
+        {
+            Query q(conn, kDeleteUser);
+            q.bind(1, userId);
+            q.execute();
+        }
+        txn.commit();
+        return true;
+    } catch (std::exception& e) {
+        std::cerr << "Delete Error: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,250 @@
+#include "../include/StatementJob.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+const size_t summaryFlushRows = 5000; // 攒够这么多条汇总写一次库
+
+bool makeDirs(const std::string& path) {
+    std::string partial;
+    std::stringstream ss(path);
+    std::string part;
+    if (!path.empty() && path[0] == '/') partial = "/";
+    while (std::getline(ss, part, '/')) {
+        if (part.empty()) continue;
+        partial += part + "/";
+        if (mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+void appendCents(std::string& out, int64_t cents) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%lld.%02lld", cents < 0 ? "-" : "", (long long)std::llabs(cents) / 100, (long long)std::llabs(cents) % 100);
+    out += buf;
+}
+
+// 存入和开户记为收入，其余（取款、销户）记为支出
+bool isCredit(const std::string& type) {
+    return type == "deposit" || type == "open";
+}
+
+// 对账单一行一条记录，字段用 | 分隔，摘要里的分隔符和换行替换成空格
+void appendField(std::string& out, const std::string& v) {
+    out += '|';
+    for (char c : v) out += (c == '|' || c == '\n' || c == '\r') ? ' ' : c;
+}
+
+// 一张卡在扫描过程中的累计状态
+struct CardState {
+    std::string card;
+    int64_t balance = 0;
+    int64_t afterDelta = 0; // 期末之后发生的净变动，用来从当前余额倒推期末余额
+    int64_t credit = 0, debit = 0;
+    std::vector<TransactionRow> lines;
+};
+
+}
+
+StatementJob::StatementJob(LedgerStore& store, const std::string& dir, int threads)
+    : store(store), dir(dir), threads(threads < 1 ? 1 : threads) {}
+
+bool StatementJob::periodRange(const std::string& period, std::string& begin, std::string& end) {
+    if (period.size() != 7 || period[4] != '-') return false;
+    for (size_t i = 0; i < 7; i++) {
+        if (i != 4 && (period[i] < '0' || period[i] > '9')) return false;
+    }
+    int year = atoi(period.substr(0, 4).c_str());
+    int month = atoi(period.substr(5, 2).c_str());
+    if (month < 1 || month > 12) return false;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04d-%02d-01 00:00:00", year, month);
+    begin = buf;
+    if (++month > 12) { month = 1; year++; }
+    snprintf(buf, sizeof(buf), "%04d-%02d-01 00:00:00", year, month);
+    end = buf;
+    return true;
+}
+
+bool StatementJob::loadCheckpoint(const std::string& path, int& partitions, std::set<int>& done) {
+    std::ifstream in(path);
+    if (!in.is_open()) return false;
+    std::string key;
+    int n = 0;
+    if (!(in >> key >> n) || key != "partitions" || n <= 0) return false;
+    partitions = n;
+    int p;
+    while (in >> p) {
+        if (p >= 0 && p < n) done.insert(p);
+    }
+    return true;
+}
+
+bool StatementJob::markDone(const std::string& path, int partition) {
+    std::lock_guard<std::mutex> lock(checkpointMutex);
+    int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (fd < 0) return false;
+    std::string line = std::to_string(partition) + "\n";
+    bool ok = ::write(fd, line.data(), line.size()) == (ssize_t)line.size() && fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool StatementJob::runPartition(int partition, int partitions, const std::string& period, const std::string& outDir,
+                                const std::string& begin, const std::string& end, size_t& cards, size_t& transactions) {
+    char name[32];
+    snprintf(name, sizeof(name), "part-%04d", partition);
+    std::string finalPath = outDir + "/" + name;
+    std::string tmpPath = finalPath + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "w");
+    if (!out) return false;
+    std::vector<char> fileBuffer(1 << 20);
+    setvbuf(out, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    std::vector<StatementSummary> summaries;
+    bool ok = true;
+    std::string text;
+    CardState cur;
+
+    auto flushSummaries = [&]() {
+        if (!summaries.empty() && !store.saveStatementSummaries(summaries)) ok = false;
+        summaries.clear();
+    };
+
+    // 一张卡的流水都到齐后才知道期初期末，先写汇总行再写明细
+    auto finishCard = [&]() {
+        if (cur.card.empty()) return;
+        StatementSummary s;
+        s.cardNumber = cur.card;
+        s.period = period;
+        s.closingCents = cur.balance - cur.afterDelta;
+        s.openingCents = s.closingCents - cur.credit + cur.debit;
+        s.creditCents = cur.credit;
+        s.debitCents = cur.debit;
+        s.count = (int64_t)cur.lines.size();
+
+        text.clear();
+        text += "S";
+        appendField(text, s.cardNumber);
+        appendField(text, period);
+        text += '|'; appendCents(text, s.openingCents);
+        text += '|'; appendCents(text, s.closingCents);
+        text += '|'; appendCents(text, s.creditCents);
+        text += '|'; appendCents(text, s.debitCents);
+        text += '|'; text += std::to_string(s.count);
+        text += '\n';
+        for (const TransactionRow& t : cur.lines) {
+            text += "L";
+            appendField(text, t.createTime);
+            appendField(text, t.type);
+            text += '|'; appendCents(text, t.amountCents);
+            text += '|'; appendCents(text, t.balanceAfterCents);
+            appendField(text, t.description);
+            text += '\n';
+        }
+        fwrite(text.data(), 1, text.size(), out);
+
+        cards++;
+        transactions += cur.lines.size();
+        summaries.push_back(std::move(s));
+        if (summaries.size() >= summaryFlushRows) flushSummaries();
+        cur.card.clear();
+        cur.lines.clear();
+        cur.afterDelta = cur.credit = cur.debit = 0;
+    };
+
+    bool scanned = store.scanStatementPartition(partition, partitions, begin, [&](const StatementScanRow& row) {
+        if (row.cardNumber != cur.card) {
+            finishCard();
+            cur.card = row.cardNumber;
+            cur.balance = row.balanceCents;
+        }
+        if (!row.hasTransaction) return;
+        const TransactionRow& t = row.txn;
+        int64_t delta = isCredit(t.type) ? t.amountCents : -t.amountCents;
+        if (t.createTime >= end) {
+            cur.afterDelta += delta;
+        } else {
+            if (delta > 0) cur.credit += delta; else cur.debit -= delta;
+            cur.lines.push_back(t);
+        }
+    });
+    finishCard();
+    flushSummaries();
+
+    ok = ok && scanned && !ferror(out) && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    fclose(out);
+    if (!ok || rename(tmpPath.c_str(), finalPath.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool StatementJob::run(const std::string& period, Report& report) {
+    std::string begin, end;
+    if (!periodRange(period, begin, end)) return false;
+    auto start = std::chrono::steady_clock::now();
+
+    std::string outDir = dir + "/" + period;
+    if (!makeDirs(outDir)) {
+        std::cerr << "无法创建对账单目录: " << outDir << std::endl;
+        return false;
+    }
+
+    // 重跑时沿用上次的分片数，已完成的分片直接跳过
+    std::string checkpoint = outDir + "/checkpoint";
+    int partitions = threads * 4;
+    std::set<int> done;
+    if (!loadCheckpoint(checkpoint, partitions, done)) {
+        std::ofstream init(checkpoint, std::ios::trunc);
+        init << "partitions " << partitions << "\n";
+        if (!init.good()) {
+            std::cerr << "无法写入 checkpoint: " << checkpoint << std::endl;
+            return false;
+        }
+    }
+    report.partitions = partitions;
+    report.skipped = (int)done.size();
+
+    std::atomic<int> nextPartition{0};
+    std::atomic<int> failed{0};
+    std::atomic<size_t> cards{0}, transactions{0};
+    auto worker = [&]() {
+        for (;;) {
+            int p = nextPartition.fetch_add(1);
+            if (p >= partitions) return;
+            if (done.count(p)) continue;
+            size_t c = 0, t = 0;
+            if (runPartition(p, partitions, period, outDir, begin, end, c, t) && markDone(checkpoint, p)) {
+                cards += c;
+                transactions += t;
+            } else {
+                std::cerr << "对账单分片 " << p << " 生成失败，重跑时会重试" << std::endl;
+                failed++;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    int n = std::min(threads, partitions);
+    for (int i = 0; i < n; i++) workers.emplace_back(worker);
+    for (auto& w : workers) w.join();
+
+    report.failed = failed;
+    report.cards = cards;
+    report.transactions = transactions;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
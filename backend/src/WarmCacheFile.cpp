@@ -0,0 +1,178 @@
+#include "../include/WarmCacheFile.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char kMagic[4] = {'B', 'W', 'C', '1'};
+const int kTextFields = 5;
+
+// 取出以 '\0' 分隔的下一个字段
+std::string nextField(const char*& p, const char* end) {
+    const char* start = p;
+    while (p < end && *p) p++;
+    std::string field(start, p);
+    if (p < end) p++;
+    return field;
+}
+
+// 写满 size 字节，出错返回 false
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = (const char*)data;
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+}
+
+const size_t WarmCacheFile::kCardBytes;
+
+WarmCacheFile::~WarmCacheFile() {
+    if (mapped) munmap(mapped, mappedBytes);
+}
+
+bool WarmCacheFile::write(const std::string& path, std::vector<VersionedProfile> rows) {
+    rows.erase(std::remove_if(rows.begin(), rows.end(), [](const VersionedProfile& v) {
+        return v.row.cardNumber.empty() || v.row.cardNumber.size() > kCardBytes;
+    }), rows.end());
+    std::sort(rows.begin(), rows.end(), [](const VersionedProfile& a, const VersionedProfile& b) {
+        return a.row.cardNumber < b.row.cardNumber;
+    });
+    rows.erase(std::unique(rows.begin(), rows.end(), [](const VersionedProfile& a, const VersionedProfile& b) {
+        return a.row.cardNumber == b.row.cardNumber;
+    }), rows.end());
+
+    std::vector<Entry> index(rows.size());
+    std::string strings;
+    for (size_t i = 0; i < rows.size(); i++) {
+        const VersionedProfile& v = rows[i];
+        Entry& e = index[i];
+        memset(&e, 0, sizeof(e));
+        memcpy(e.card, v.row.cardNumber.data(), v.row.cardNumber.size());
+        e.cardId = v.row.cardId;
+        e.version = v.row.version;
+        e.balanceCents = v.profile.balanceCents;
+        e.textOffset = strings.size();
+        for (const std::string* field : {&v.profile.name, &v.profile.idCard, &v.profile.phone, &v.profile.address, &v.profile.createTime}) {
+            strings.append(field->c_str());
+            strings += '\0';
+        }
+        e.textLength = (uint32_t)(strings.size() - e.textOffset);
+    }
+    Header header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.count = (uint32_t)index.size();
+    header.textBytes = strings.size();
+
+    // 临时文件名带上 pid，热重启时新旧进程可能同时在写。
+    // 改名前先把内容落盘、改名后再同步目录，否则掉电后可能留下改了名却没有内容的文件
+    std::string temp = path + ".tmp." + std::to_string(getpid());
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && writeAll(fd, &header, sizeof(header)) &&
+              writeAll(fd, index.data(), index.size() * sizeof(Entry)) &&
+              writeAll(fd, strings.data(), strings.size()) && fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!ok) {
+        std::cerr << "热缓存文件写入失败: " << temp << ": " << strerror(errno) << std::endl;
+        unlink(temp.c_str());
+        return false;
+    }
+    if (rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "热缓存文件改名失败: " << path << ": " << strerror(errno) << std::endl;
+        unlink(temp.c_str());
+        return false;
+    }
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int dirFd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+bool WarmCacheFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+    size_t bytes = (size_t)st.st_size;
+    void* region = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) return false;
+
+    const Header* header = (const Header*)region;
+    if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+        || sizeof(Header) + (uint64_t)header->count * sizeof(Entry) + header->textBytes != bytes) {
+        std::cerr << "热缓存文件格式不对，忽略: " << path << std::endl;
+        munmap(region, bytes);
+        return false;
+    }
+    mapped = region;
+    mappedBytes = bytes;
+    count = header->count;
+    textBytes = header->textBytes;
+    entries = (const Entry*)((const char*)region + sizeof(Header));
+    text = (const char*)(entries + count);
+    // 启动后马上会顺序核对全部索引项
+    madvise(region, bytes, MADV_WILLNEED);
+    return true;
+}
+
+std::string WarmCacheFile::cardNumber(size_t i) const {
+    const char* card = entries[i].card;
+    return std::string(card, strnlen(card, kCardBytes));
+}
+
+bool WarmCacheFile::read(size_t i, VersionedProfile& out) const {
+    const Entry& e = entries[i];
+    if (e.textOffset > textBytes || e.textLength > textBytes - e.textOffset) return false;
+    out.row.cardNumber = cardNumber(i);
+    out.row.cardId = e.cardId;
+    out.row.version = e.version;
+    out.profile.balanceCents = e.balanceCents;
+    const char* p = text + e.textOffset;
+    const char* end = p + e.textLength;
+    std::string* fields[kTextFields] = {&out.profile.name, &out.profile.idCard, &out.profile.phone, &out.profile.address, &out.profile.createTime};
+    for (std::string* field : fields) *field = nextField(p, end);
+    return true;
+}
+
+int WarmCacheFile::compare(size_t i, const std::string& cardNumber) const {
+    const char* card = entries[i].card;
+    size_t length = strnlen(card, kCardBytes);
+    int c = memcmp(card, cardNumber.data(), std::min(length, cardNumber.size()));
+    if (c != 0) return c;
+    return length < cardNumber.size() ? -1 : (length > cardNumber.size() ? 1 : 0);
+}
+
+bool WarmCacheFile::find(const std::string& cardNumber, VersionedProfile& out) const {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = compare(mid, cardNumber);
+        if (c == 0) return read(mid, out);
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return false;
+}
@@ -0,0 +1,174 @@
+#include "../include/WorkerSupervisor.h"
+#include "../include/Metrics.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+namespace {
+
+// 信号处理函数里只能用这些
+volatile sig_atomic_t stopping = 0;
+volatile pid_t children[WorkerSupervisor::kMaxWorkers];
+int childCount = 0;
+
+void onStopSignal(int) {
+    stopping = 1;
+    for (int i = 0; i < childCount; i++) {
+        if (children[i] > 0) kill(children[i], SIGTERM);
+    }
+}
+
+// 启动后这么久之内就退出的算作启动失败，重启间隔翻倍
+const auto kHealthyUptime = std::chrono::seconds(5);
+const int kMaxBackoffSec = 30;
+
+}
+
+const int WorkerSupervisor::kMaxWorkers;
+const size_t WorkerSupervisor::kSlotBytes;
+
+WorkerSupervisor::WorkerSupervisor(int workers)
+    : workers(std::min(std::max(workers, 1), kMaxWorkers)), supervisorPid(getpid()) {
+    void* region = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        std::cerr << "无法建立进程间共享内存: " << strerror(errno) << std::endl;
+        return;
+    }
+    shared = new (region) Shared();
+}
+
+WorkerSupervisor::~WorkerSupervisor() {
+    if (shared) munmap(shared, sizeof(Shared));
+}
+
+pid_t WorkerSupervisor::spawn() {
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    // 工作进程：恢复默认信号处理（Crow 会自己接管 SIGINT/SIGTERM），看护进程没了就跟着退出
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != supervisorPid) _exit(1);
+    return 0;
+}
+
+int WorkerSupervisor::run() {
+    if (!shared) return -1;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; // 不自动重启 waitpid，收到信号时马上回到循环里检查
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::vector<std::chrono::steady_clock::time_point> started(workers);
+    std::vector<int> backoff(workers, 1);
+    childCount = workers;
+    for (int i = 0; i < workers; i++) {
+        pid_t pid = spawn();
+        if (pid == 0) return i;
+        if (pid < 0) {
+            std::cerr << "无法创建工作进程 " << i << ": " << strerror(errno) << std::endl;
+            onStopSignal(SIGTERM);
+            break;
+        }
+        children[i] = pid;
+        started[i] = std::chrono::steady_clock::now();
+        shared->alive++;
+    }
+    std::cout << "多进程模式: 看护进程 " << getpid() << ", 工作进程 " << shared->alive.load() << " 个" << std::endl;
+
+    while (shared->alive.load() > 0) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break; // 没有子进程了
+        }
+        int index = -1;
+        for (int i = 0; i < workers; i++) {
+            if (children[i] == pid) index = i;
+        }
+        if (index < 0) continue;
+        children[index] = 0;
+        shared->alive--;
+        if (stopping) continue;
+
+        if (WIFSIGNALED(status)) {
+            std::cerr << "工作进程 " << index << "（pid " << pid << "）被信号 " << WTERMSIG(status) << " 终止" << std::endl;
+        } else {
+            std::cerr << "工作进程 " << index << "（pid " << pid << "）退出，状态 " << WEXITSTATUS(status) << std::endl;
+        }
+        // 刚启动就退出说明多半是配置或后端问题，拉长重启间隔，避免空转
+        if (std::chrono::steady_clock::now() - started[index] < kHealthyUptime) {
+            backoff[index] = std::min(backoff[index] * 2, kMaxBackoffSec);
+        } else {
+            backoff[index] = 1;
+        }
+        for (int waited = 0; waited < backoff[index] && !stopping; waited++) sleep(1);
+        if (stopping) continue;
+
+        pid_t fresh = spawn();
+        if (fresh == 0) return index;
+        if (fresh < 0) {
+            std::cerr << "无法重启工作进程 " << index << ": " << strerror(errno) << std::endl;
+            continue;
+        }
+        children[index] = fresh;
+        started[index] = std::chrono::steady_clock::now();
+        shared->alive++;
+        shared->restarts++;
+    }
+    std::cout << "所有工作进程已退出" << std::endl;
+    return -1;
+}
+
+void WorkerSupervisor::publish(int index, const std::string& metrics) {
+    if (!shared || index < 0 || index >= workers) return;
+    Slot& slot = shared->slots[index];
+    size_t length = std::min(metrics.size(), kSlotBytes);
+    // 截断时退回到最后一个完整的行
+    if (length < metrics.size()) {
+        size_t newline = metrics.rfind('\n', length - 1);
+        length = newline == std::string::npos ? 0 : newline + 1;
+    }
+    slot.seq.fetch_add(1, std::memory_order_acq_rel);
+    memcpy(slot.text, metrics.data(), length);
+    slot.length = (uint32_t)length;
+    slot.seq.fetch_add(1, std::memory_order_release);
+}
+
+std::string WorkerSupervisor::collect() const {
+    if (!shared) return "";
+    std::vector<std::string> texts(workers);
+    for (int i = 0; i < workers; i++) {
+        const Slot& slot = shared->slots[i];
+        for (int attempt = 0; attempt < 100; attempt++) {
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            texts[i].assign(slot.text, std::min<size_t>(slot.length, kSlotBytes));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before) break;
+            texts[i].clear();
+        }
+    }
+    std::string out = Metrics::merge(texts, "worker");
+    out += "# HELP bank_workers_alive 存活的工作进程数\n# TYPE bank_workers_alive gauge\n";
+    out += "bank_workers_alive " + std::to_string(shared->alive.load()) + "\n";
+    out += "# HELP bank_worker_restarts_total 工作进程被重新拉起的次数\n# TYPE bank_worker_restarts_total counter\n";
+    out += "bank_worker_restarts_total " + std::to_string(shared->restarts.load()) + "\n";
+    return out;
+}
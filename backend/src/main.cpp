@@ -1,10 +1,25 @@
 #include "../include/crow_all.h"
-#include "../include/DatabaseManager.h"
+#include "../include/LedgerStore.h"
+#include "../include/Metrics.h"
+#include "../include/CardAllocator.h"
+#include "../include/AccountImporter.h"
+#include "../include/StatementJob.h"
+#include "../include/PeriodicJob.h"
+#include "../include/SessionStore.h"
+#include "../include/RateLimiter.h"
+#include "../include/AdmissionControl.h"
+#include "../include/ApiRequests.h"
+#include "../include/ApiResponse.h"
+#include "../include/WorkerSupervisor.h"
+#include "../include/HotRestart.h"
+#include "../include/CpuPlacement.h"
+#include "../include/RequestArena.h"
 #include <iostream>
 #include <unistd.h>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <cstring>
 
 // 获取项目绝对路径
 std::string getProjectRoot() {
@@ -31,15 +46,459 @@ std::string readFile(const std::string& path) {
     return buffer.str();
 }
 
-int main() {
-    crow::SimpleApp app;
+// 解析启动参数中的存储后端：--storage=<name>，其次读环境变量 BANK_STORAGE，默认 mysql
+std::string parseStorageBackend(int argc, char* argv[]) {
+    std::string backend = "mysql";
+    const char* env = getenv("BANK_STORAGE");
+    if (env && *env) backend = env;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 10, "--storage=") == 0) backend = arg.substr(10);
+    }
+    return backend;
+}
+
+// 取 --name=value 形式的启动参数，没有时返回空串
+std::string parseOption(int argc, char* argv[], const std::string& name) {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0) return arg.substr(prefix.size());
+    }
+    return "";
+}
+
+// 是否带了 --name 开关
+bool hasFlag(int argc, char* argv[], const std::string& name) {
+    std::string flag = "--" + name;
+    for (int i = 1; i < argc; i++) {
+        if (flag == argv[i]) return true;
+    }
+    return false;
+}
+
+// 批量导入的块大小和校验线程数：BANK_IMPORT_CHUNK（默认 1000 行）、BANK_IMPORT_THREADS（默认 CPU 核数）
+AccountImporter makeImporter(CardAllocator& allocator) {
+    const char* chunk = getenv("BANK_IMPORT_CHUNK");
+    const char* threads = getenv("BANK_IMPORT_THREADS");
+    return AccountImporter(LedgerStore::getInstance(), &allocator,
+                           chunk && *chunk ? strtoull(chunk, nullptr, 10) : 1000,
+                           threads && *threads ? atoi(threads) : (int)std::thread::hardware_concurrency());
+}
+
+// 时间参数（导出区间、历史余额）：接受 YYYY-MM-DD 或 YYYY-MM-DD HH:MM:SS（也可用 T 分隔），只有日期时按整天补全。
+// 格式不对返回 false
+bool parseTimeParam(const char* value, bool endOfDay, std::string& out) {
+    out.clear();
+    if (!value || !*value) return true;
+    std::string v = value;
+    if (v.size() > 10 && v[10] == 'T') v[10] = ' ';
+    const char* pattern = "dddd-dd-dd dd:dd:dd";
+    if (v.size() != 10 && v.size() != 19) return false;
+    for (size_t i = 0; i < v.size(); i++) {
+        if (pattern[i] == 'd' ? (v[i] < '0' || v[i] > '9') : v[i] != pattern[i]) return false;
+    }
+    out = v.size() == 10 ? v + (endOfDay ? " 23:59:59" : " 00:00:00") : v;
+    return true;
+}
+
+// 本地日期 YYYY-MM-DD，往前推 daysAgo 天或 monthsAgo 个月，与流水的 create_time 同一时区
+std::string localDate(int daysAgo, int monthsAgo) {
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    if (monthsAgo) local.tm_mday = 1;
+    local.tm_mday -= daysAgo;
+    local.tm_mon -= monthsAgo;
+    local.tm_isdst = -1;
+    mktime(&local);
+    char buf[16];
+    strftime(buf, sizeof(buf), "%Y-%m-%d", &local);
+    return buf;
+}
+
+// 取出 Authorization: Bearer <令牌>，没有时返回空串
+std::string bearerToken(const crow::request& req) {
+    const std::string& header = req.get_header_value("Authorization");
+    const std::string prefix = "Bearer ";
+    return header.compare(0, prefix.size(), prefix) == 0 ? header.substr(prefix.size()) : "";
+}
+
+// 读取 name 对应的环境变量，没有设置时返回 def
+double envNumber(const char* name, double def) {
+    const char* v = getenv(name);
+    return v && *v ? atof(v) : def;
+}
+
+// 在访问数据库之前限流：先按客户端 IP，再按卡号（card 为空时不检查），超限时填好 429 响应返回 true
+bool throttled(RateLimiter& ipLimiter, RateLimiter& cardLimiter, const crow::request& req, const std::string& card, crow::response& out) {
+    int retry = ipLimiter.acquire(req.remote_ip_address);
+    if (!retry && !card.empty()) retry = cardLimiter.acquire(card);
+    if (!retry) return false;
+    out = responses::tooManyRequests().make();
+    out.set_header("Retry-After", std::to_string(retry));
+    return true;
+}
+
+// 请求体解码失败时的 400 响应，message 为具体哪个字段出了问题
+crow::response invalidRequest(const std::string& error) {
+    return JsonResponse().add("status", "error").add("message", error).make(400);
+}
+
+// 各接口专用的固定响应，启动时序列化一次
+const ConstResponse loginFailed(200, "{\"status\":\"error\",\"message\":\"卡号或密码错误\"}");
+const ConstResponse loginRequired(401, "{\"status\":\"error\",\"message\":\"请先登录\"}");
+const ConstResponse sessionMismatch(403, "{\"status\":\"error\",\"message\":\"卡号与登录会话不符\"}");
+const ConstResponse wrongOldPassword(200, "{\"status\":\"error\",\"message\":\"旧密码错误\"}");
+const ConstResponse identityMismatch(200, "{\"status\":\"error\",\"message\":\"身份信息验证失败\"}");
+const ConstResponse infoMismatch(200, "{\"status\":\"error\",\"message\":\"信息不匹配\"}");
+const ConstResponse depositSucceeded(200, "{\"status\":\"success\",\"message\":\"存款成功\"}");
+const ConstResponse depositFailed(200, "{\"status\":\"error\",\"message\":\"存款失败\"}");
+const ConstResponse withdrawSucceeded(200, "{\"status\":\"success\",\"message\":\"取款成功\"}");
+const ConstResponse withdrawFailed(200, "{\"status\":\"error\",\"message\":\"余额不足或操作失败\"}");
+const ConstResponse transferSucceeded(200, "{\"status\":\"success\",\"message\":\"转账成功\"}");
+const ConstResponse transferFailed(200, "{\"status\":\"error\",\"message\":\"转账失败：余额不足或卡号无效\"}");
+const ConstResponse cardAvailable(200, "{\"status\":\"success\",\"available\":true}");
+const ConstResponse cardTaken(200, "{\"status\":\"success\",\"available\":false}");
+const ConstResponse allocateFailed(200, "{\"status\":\"error\",\"message\":\"卡号分配失败\"}");
+const ConstResponse registerFailed(200, "{\"status\":\"error\",\"message\":\"开户失败，请检查信息\"}");
+const ConstResponse userNotFound(200, "{\"status\":\"error\",\"message\":\"用户不存在\"}");
+const ConstResponse exportNotFound(404, "{\"status\":\"error\",\"message\":\"用户不存在\"}");
+const ConstResponse exportFailed(500, "{\"status\":\"error\",\"message\":\"导出失败\"}");
+const ConstResponse serviceReady(200, "{\"status\":\"ready\"}");
+const ConstResponse serviceWarming(503, "{\"status\":\"warming\"}");
+const ConstResponse backendDown(503, "{\"status\":\"unavailable\",\"message\":\"存储后端未连接\"}");
+
+// 按卡号操作的接口先查会话：要带 Authorization: Bearer <令牌>，且令牌所属卡号与请求里的卡号一致，
+// 否则填好 401/403 响应返回 true。enabled 为 false（多进程不发令牌）时不检查
+bool unauthorized(SessionStore& sessions, bool enabled, const crow::request& req, const std::string& card, crow::response& out) {
+    if (!enabled) return false;
+    std::string token = bearerToken(req);
+    std::string owner;
+    if (token.empty()) {
+        out = loginRequired.make();
+    } else if (!sessions.validate(token, owner)) {
+        out = responses::sessionExpired().make();
+    } else if (owner != card) {
+        out = sessionMismatch.make();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// 分为单位的金额格式化成两位小数
+std::string formatCents(int64_t cents) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%lld.%02lld", cents < 0 ? "-" : "", (long long)std::llabs(cents) / 100, (long long)std::llabs(cents) % 100);
+    return buf;
+}
+
+// CSV 字段含逗号、引号或换行时加引号
+std::string csvField(const std::string& v) {
+    if (v.find_first_of(",\"\r\n") == std::string::npos) return v;
+    std::string out = "\"";
+    for (char c : v) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// 按路径给接口分优先级
+RequestClass classifyRequest(const std::string& url) {
+    auto starts = [&url](const char* prefix) { return url.compare(0, strlen(prefix), prefix) == 0; };
+    if (starts("/api/transfer") || starts("/api/deposit") || starts("/api/withdraw")) return ClassPosting;
+    if (starts("/api/transactions/")) return url.size() >= 7 && url.compare(url.size() - 7, 7, "/export") == 0 ? ClassExport : ClassHistory;
+    if (starts("/api/admin/")) return ClassExport;
+    if (starts("/api/messages") || starts("/api/analytics/")) return ClassHistory;
+    if (starts("/api/balance/") || starts("/api/userinfo/") || starts("/api/user/name/")) return ClassBalance;
+    return ClassAuth; // 登录、密码、开户销户、资料修改等
+}
+
+// 流式响应占用的准入名额，析构时归还
+struct AdmissionSlot {
+    AdmissionControl* control;
+    RequestClass cls;
+    std::chrono::steady_clock::time_point started;
+
+    AdmissionSlot(AdmissionControl* control, RequestClass cls, std::chrono::steady_clock::time_point started)
+        : control(control), cls(cls), started(started) {}
+    ~AdmissionSlot() { control->release(cls, std::chrono::steady_clock::now() - started); }
+    AdmissionSlot(const AdmissionSlot&) = delete;
+    AdmissionSlot& operator=(const AdmissionSlot&) = delete;
+};
+
+// /api/ 下的接口都会访问存储后端，按优先级经过并发限制；/health、/metrics 和静态文件不受影响
+struct AdmissionMiddleware {
+    struct context {
+        bool admitted = false;
+        RequestClass cls = ClassAuth;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    AdmissionControl* control = nullptr;
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx) {
+        if (!control || req.url.compare(0, 5, "/api/") != 0) return;
+        ctx.cls = classifyRequest(req.url);
+        if (!control->acquire(ctx.cls)) {
+            res = responses::busy().make();
+            res.set_header("Retry-After", "1");
+            res.end();
+            return;
+        }
+        ctx.admitted = true;
+        ctx.started = std::chrono::steady_clock::now();
+    }
+
+    void after_handle(crow::request&, crow::response& res, context& ctx) {
+        if (!ctx.admitted) return;
+        if (!res.is_chunked_type()) {
+            control->release(ctx.cls, std::chrono::steady_clock::now() - ctx.started);
+            return;
+        }
+        // 流式响应（导出）在 after_handle 之后才开始写出，名额交给生产者持有，连接写完或断开、生产者被释放时归还
+        auto slot = std::make_shared<AdmissionSlot>(control, ctx.cls, ctx.started);
+        auto producer = std::move(res.body_producer);
+        res.body_producer = [slot, producer](std::string& out) { return producer(out); };
+    }
+};
+
+// 请求内临时内存的作用域：处理前打开本线程的 RequestArena，响应生成后整体复位。
+// 排在准入控制前面，被拒绝的请求同样会复位
+struct RequestArenaMiddleware {
+    struct context {};
+
+    void before_handle(crow::request&, crow::response&, context&) { RequestArena::local().begin(); }
+    void after_handle(crow::request&, crow::response&, context&) { RequestArena::local().end(); }
+};
+
+int main(int argc, char* argv[]) {
+    crow::App<RequestArenaMiddleware, AdmissionMiddleware> app;
 
     std::string project_root = getProjectRoot();
     std::cout << "项目根目录: " << project_root << std::endl;
 
     std::cout << "银行系统后端服务启动中..." << std::endl;
-    // 确保数据库连接初始化
-    DatabaseManager::getInstance();
+    // 选择存储后端并确保连接初始化
+    std::string backend = parseStorageBackend(argc, argv);
+
+    // 多进程模式：--workers=N（或 BANK_WORKERS）大于 1 时由看护进程拉起 N 个工作进程，以 SO_REUSEPORT 共用端口。
+    // 必须在连接数据库、启动任何线程之前 fork；导入、对账单等一次性任务仍在单进程里执行
+    std::string workersOption = parseOption(argc, argv, "workers");
+    int workers = !workersOption.empty() ? atoi(workersOption.c_str()) : (int)envNumber("BANK_WORKERS", 1);
+    bool oneShot = !parseOption(argc, argv, "import").empty() || !parseOption(argc, argv, "statements").empty();
+    // 线程放置：--io-threads / --db-threads / --io-cpus / --background-cpus，也可以用对应的 BANK_* 环境变量（见 CpuPlacement）。
+    // fork 之前检查参数，各工作进程再按自己的编号分到 I/O CPU 中的一段
+    CpuPlacement::Options placementOptions = CpuPlacement::Options::fromEnv();
+    std::string placementOption;
+    if (!(placementOption = parseOption(argc, argv, "io-threads")).empty()) placementOptions.ioThreads = std::max(0, atoi(placementOption.c_str()));
+    if (!(placementOption = parseOption(argc, argv, "db-threads")).empty()) placementOptions.dbThreads = std::max(0, atoi(placementOption.c_str()));
+    if (!(placementOption = parseOption(argc, argv, "io-cpus")).empty()) placementOptions.ioCpus = placementOption;
+    if (!(placementOption = parseOption(argc, argv, "background-cpus")).empty()) placementOptions.backgroundCpus = placementOption;
+    CpuPlacement placement(placementOptions);
+    std::string placementError;
+    if (!placement.init(placementError)) {
+        std::cerr << "线程放置参数错误: " << placementError << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<WorkerSupervisor> supervisor;
+    int workerIndex = 0;
+    if (workers > 1 && !oneShot) {
+        if (backend == "memory" || backend == "memory-mirror") {
+            std::cerr << "memory 后端的账本在进程内存里，不能多进程运行" << std::endl;
+            return 1;
+        }
+        supervisor.reset(new WorkerSupervisor(workers));
+        workerIndex = supervisor->run();
+        if (workerIndex < 0) return 0;
+        std::cout << "工作进程 " << workerIndex << " 启动, pid " << getpid() << std::endl;
+    }
+    bool multiProcess = supervisor != nullptr;
+    // 之后创建的后端、定时任务等线程都继承后台 CPU 的范围
+    if (!oneShot) {
+        if (multiProcess) placement.restrictToWorker(workerIndex, supervisor->workerCount());
+        placement.pinBackground();
+    }
+
+    // 热重启：--takeover 时先向正在运行的旧进程（控制套接字 BANK_HANDOFF_SOCKET）要监听套接字，
+    // 旧进程照常服务到本进程准备好为止。要在连接数据库之前拿到：旧进程从这时起记录新开的卡号，
+    // 本进程建卡号过滤器时漏掉的由它最后补上
+    HotRestart handoff(HotRestart::Options::fromEnv());
+    bool takeover = hasFlag(argc, argv, "takeover");
+    int inheritedFd = -1;
+    if (takeover) {
+        if (multiProcess || oneShot || backend == "memory" || backend == "memory-mirror") {
+            std::cerr << "热重启只支持单进程运行的数据库后端" << std::endl;
+            return 1;
+        }
+        inheritedFd = handoff.takeover();
+        if (inheritedFd < 0) return 1;
+    }
+
+    // 多进程时各进程的缓存互相看不到对方的写入，直接查库
+    if (!LedgerStore::select(backend, !multiProcess)) {
+        std::cerr << "未知或未编译的存储后端: " << backend << "，可用后端:";
+        for (const auto& name : LedgerStore::availableBackends()) std::cerr << " " << name;
+        std::cerr << std::endl;
+        return 1;
+    }
+    std::cout << "存储后端: " << LedgerStore::getInstance().backendName() << std::endl;
+    // 旧进程退出前仍在写库，交接完成前不用本进程的缓存
+    if (takeover) LedgerStore::getInstance().beginHandoff(true);
+
+    // 服务端卡号分配，BIN 由 BANK_CARD_BIN 指定（默认 622202），每次预留 BANK_CARD_BLOCK 个号（默认 1000）
+    const char* binEnv = getenv("BANK_CARD_BIN");
+    std::string bin = binEnv && *binEnv ? binEnv : "622202";
+    if (bin.size() < 1 || bin.size() > 12 || bin.find_first_not_of("0123456789") != std::string::npos) {
+        std::cerr << "BANK_CARD_BIN 必须是 1 到 12 位数字" << std::endl;
+        return 1;
+    }
+    const char* blockEnv = getenv("BANK_CARD_BLOCK");
+    CardAllocator allocator(LedgerStore::getInstance(), bin, blockEnv && *blockEnv ? atoll(blockEnv) : 1000);
+    Metrics::getInstance().add("bank_card_allocated_total", "服务端分配的卡号数", "counter", [&allocator] { return (double)allocator.allocated; });
+    Metrics::getInstance().add("bank_card_blocks_reserved_total", "预留的卡号段数", "counter", [&allocator] { return (double)allocator.blocksReserved; });
+    Metrics::getInstance().add("bank_card_allocate_skipped_total", "因卡号已存在而跳过的号", "counter", [&allocator] { return (double)allocator.skipped; });
+
+    // 命令行批量导入：bank_server --import=accounts.csv，导入完即退出
+    std::string importFile = parseOption(argc, argv, "import");
+    if (!importFile.empty()) {
+        std::ifstream csv(importFile);
+        if (!csv.is_open()) {
+            std::cerr << "无法打开导入文件: " << importFile << std::endl;
+            return 1;
+        }
+        AccountImporter::Report report = makeImporter(allocator).run(csv);
+        std::cout << "导入完成: 共 " << report.total << " 行, 成功 " << report.imported << " 行, 拒绝 " << report.rejected
+                  << " 行, 用时 " << report.seconds << "s, " << (long long)report.rowsPerSecond() << " 行/秒" << std::endl;
+        for (const auto& r : report.rejects) std::cout << "  第 " << r.line << " 行: " << r.reason << std::endl;
+        if (report.rejected > report.rejects.size()) std::cout << "  另有 " << report.rejected - report.rejects.size() << " 行未列出" << std::endl;
+        return report.rejected ? 2 : 0;
+    }
+
+    // 月度对账单批处理：bank_server --statements=2026-09，生成完即退出；
+    // 线程数 BANK_STATEMENT_THREADS（默认 8），输出目录 BANK_STATEMENT_DIR（默认 statements）
+    std::string period = parseOption(argc, argv, "statements");
+    if (!period.empty()) {
+        const char* threadsEnv = getenv("BANK_STATEMENT_THREADS");
+        const char* dirEnv = getenv("BANK_STATEMENT_DIR");
+        StatementJob job(LedgerStore::getInstance(), dirEnv && *dirEnv ? dirEnv : "statements",
+                         threadsEnv && *threadsEnv ? atoi(threadsEnv) : 8);
+        StatementJob::Report report;
+        if (!job.run(period, report)) {
+            std::cerr << "对账单任务无法启动，账期格式应为 YYYY-MM: " << period << std::endl;
+            return 1;
+        }
+        std::cout << "对账单完成: 分片 " << report.partitions << " 个（跳过已完成 " << report.skipped << " 个, 失败 " << report.failed
+                  << " 个）, 卡 " << report.cards << " 张, 流水 " << report.transactions << " 条, 用时 " << report.seconds << "s" << std::endl;
+        return report.failed ? 2 : 0;
+    }
+
+    // 日终余额快照，BANK_DAILY_BALANCE_INTERVAL 秒检查一次（默认 3600，0 表示不做）
+    const char* rollEnv = getenv("BANK_DAILY_BALANCE_INTERVAL");
+    int rollInterval = rollEnv && *rollEnv ? atoi(rollEnv) : 3600;
+    PeriodicJob roller([](int64_t& rows) { return LedgerStore::getInstance().rollDailyBalances(localDate(0, 0), rows); }, rollInterval);
+    // 后台汇总任务多进程时只在 0 号工作进程里跑；热重启时等旧进程停掉自己的再启动
+    if (rollInterval > 0 && workerIndex == 0) {
+        if (!takeover) roller.start();
+        Metrics::getInstance().add("bank_daily_balance_rows_total", "写入的日终余额快照行数", "counter", [&roller] { return (double)roller.rowsWritten; });
+        Metrics::getInstance().add("bank_daily_balance_failures_total", "日终余额快照失败次数", "counter", [&roller] { return (double)roller.failures; });
+    }
+
+    // 消费统计追尾，BANK_SPENDING_ROLLUP_INTERVAL 秒一次（默认 10，0 表示不做）
+    const char* rollupEnv = getenv("BANK_SPENDING_ROLLUP_INTERVAL");
+    int rollupInterval = rollupEnv && *rollupEnv ? atoi(rollupEnv) : 10;
+    PeriodicJob spendingRollup([](int64_t& rows) { return LedgerStore::getInstance().rollupSpending(rows); }, rollupInterval);
+    if (rollupInterval > 0 && workerIndex == 0) {
+        if (!takeover) spendingRollup.start();
+        Metrics::getInstance().add("bank_spending_rollup_rows_total", "累加进消费统计的流水条数", "counter", [&spendingRollup] { return (double)spendingRollup.rowsWritten; });
+        Metrics::getInstance().add("bank_spending_rollup_failures_total", "消费统计追尾失败次数", "counter", [&spendingRollup] { return (double)spendingRollup.failures; });
+    }
+
+    // 登录会话，空闲 BANK_SESSION_TTL 秒（默认 1800）后失效，后台每秒清理一次。
+    // 会话只在本进程内存里，多进程时下一个请求可能落到别的进程，因此不发令牌，改密码仍按旧密码验证
+    bool sessionsEnabled = !multiProcess;
+    const char* ttlEnv = getenv("BANK_SESSION_TTL");
+    SessionStore sessions(ttlEnv && *ttlEnv ? atoi(ttlEnv) : 1800);
+    PeriodicJob sessionSweeper([&sessions](int64_t& rows) { rows = sessions.sweep(); return true; }, 1);
+    sessionSweeper.start();
+    Metrics::getInstance().add("bank_sessions_active", "当前有效会话数", "gauge", [&sessions] { return (double)sessions.active; });
+    Metrics::getInstance().add("bank_sessions_created_total", "创建的会话数", "counter", [&sessions] { return (double)sessions.created; });
+    Metrics::getInstance().add("bank_sessions_expired_total", "过期清理的会话数", "counter", [&sessions] { return (double)sessions.expired; });
+    Metrics::getInstance().add("bank_session_sweep_entries_total", "时间轮到期检查的条目数", "counter", [&sessions] { return (double)sessions.sweepEntries; });
+    Metrics::getInstance().add("bank_session_sweep_seconds_total", "会话清理累计耗时", "counter", [&sessions] { return sessions.sweepNanos / 1e9; });
+
+    // 登录、重置密码、卡号查询的限流：每个 IP 默认突发 30 次、每秒 10 次，
+    // 每张卡默认突发 5 次、每分钟 10 次（登录和重置密码）
+    // 多进程时每个进程各有一份限流表，额度按进程数均分，合起来大致等于配置值
+    double share = multiProcess ? supervisor->workerCount() : 1;
+    RateLimiter ipLimiter(1 << 16, std::max(1.0, envNumber("BANK_RATE_IP_BURST", 30) / share), envNumber("BANK_RATE_IP_PER_SEC", 10) / share);
+    RateLimiter cardLimiter(1 << 16, std::max(1.0, envNumber("BANK_RATE_CARD_BURST", 5) / share), envNumber("BANK_RATE_CARD_PER_MIN", 10) / 60.0 / share);
+    PeriodicJob limiterSweeper([&ipLimiter, &cardLimiter](int64_t& rows) { rows = ipLimiter.sweep() + cardLimiter.sweep(); return true; }, 10);
+    limiterSweeper.start();
+    for (auto scope : {std::make_pair("ip", &ipLimiter), std::make_pair("card", &cardLimiter)}) {
+        RateLimiter* limiter = scope.second;
+        std::string label = std::string("{scope=\"") + scope.first + "\"}";
+        Metrics::getInstance().add("bank_rate_limited_total" + label, "被限流拒绝的请求数", "counter", [limiter] { return (double)limiter->rejected; });
+        Metrics::getInstance().add("bank_rate_limit_overflow_total" + label, "限流表无空位而放行的请求数", "counter", [limiter] { return (double)limiter->overflow; });
+        Metrics::getInstance().add("bank_rate_limit_keys" + label, "限流表中的键数", "gauge", [limiter] { return (double)limiter->keys; });
+    }
+
+    // 自适应并发限制，参数见 AdmissionControl::Options::fromEnv；--db-threads 限定同时在存储后端里执行的请求数
+    AdmissionControl::Options admissionOptions = AdmissionControl::Options::fromEnv();
+    if (placement.dbThreads() > 0) {
+        admissionOptions.maxLimit = placement.dbThreads();
+        admissionOptions.minLimit = std::min(admissionOptions.minLimit, admissionOptions.maxLimit);
+        admissionOptions.initialLimit = std::min(admissionOptions.initialLimit, admissionOptions.maxLimit);
+    }
+    AdmissionControl admission(admissionOptions);
+    app.get_middleware<AdmissionMiddleware>().control = &admission;
+    Metrics::getInstance().add("bank_admission_limit", "当前并发上限", "gauge", [&admission] { return admission.limit(); });
+    Metrics::getInstance().add("bank_admission_inflight", "正在执行的请求数", "gauge", [&admission] { return (double)admission.inflight; });
+    Metrics::getInstance().add("bank_admission_baseline_seconds", "耗时基线", "gauge", [&admission] { return admission.baselineSeconds(); });
+    for (int c = 0; c < ClassCount; c++) {
+        const AdmissionControl::ClassStats& st = admission.stats(c);
+        std::string label = std::string("class=\"") + AdmissionControl::className(c) + "\"";
+        Metrics::getInstance().add("bank_admission_rejected_total{" + label + "}", "没有名额被拒绝的请求数", "counter", [&st] { return (double)st.rejected; });
+        Metrics::getInstance().add("bank_requests_total{" + label + "}", "完成的请求数", "counter", [&st] { return (double)st.completed; });
+        Metrics::getInstance().add("bank_request_service_seconds_total{" + label + "}", "请求执行耗时累计", "counter", [&st] { return st.serviceNanos / 1e9; });
+        Metrics::getInstance().add("bank_request_latency_ewma_seconds{" + label + "}", "执行耗时的滑动平均", "gauge", [&st] { return st.latencyEwma.load(); });
+    }
+
+    // 单个请求从 RequestArena 分配的上限（KB），超过的部分走堆；0 表示不用
+    RequestArena::setLimit((size_t)std::max(0.0, envNumber("BANK_REQUEST_ARENA_KB", 4096)) * 1024);
+    Metrics::getInstance().add("bank_request_arena_bytes_total", "从请求内存分配的字节数", "counter", [] { return (double)RequestArena::arenaBytes; });
+    Metrics::getInstance().add("bank_request_arena_fallbacks_total", "请求内存超过上限改走堆的分配次数", "counter", [] { return (double)RequestArena::heapFallbacks; });
+    Metrics::getInstance().add("bank_request_arena_fallback_bytes_total", "请求内存超过上限改走堆的字节数", "counter", [] { return (double)RequestArena::heapFallbackBytes; });
+    Metrics::getInstance().add("bank_request_arena_peak_bytes", "单个请求的请求内存最大用量", "gauge", [] { return (double)RequestArena::peakBytes; });
+
+    // Crow 在多条规则都匹配时取最先注册的，单段路径的接口要放在 /<string> 之前
+    CROW_ROUTE(app, "/health")([](){ return "OK"; });
+
+    // 就绪检查：启动预热完成、后端连接正常且没有在热重启中交出端口时返回 200，负载均衡据此转发流量；
+    // /health 只表示进程还活着
+    std::atomic<bool> ready{false};
+    CROW_ROUTE(app, "/ready")([&ready]() {
+        if (!ready) return serviceWarming.make();
+        if (!LedgerStore::getInstance().isConnected()) return backendDown.make();
+        return serviceReady.make();
+    });
+
+    // 运行指标（Prometheus 文本格式）
+    // 多进程时每秒把本进程的指标发布到共享内存，任一进程都能汇总全部进程
+    PeriodicJob metricsPublisher([&supervisor, workerIndex](int64_t& rows) {
+        supervisor->publish(workerIndex, Metrics::getInstance().render());
+        rows = 0;
+        return true;
+    }, 1);
+    if (multiProcess) metricsPublisher.start();
+    CROW_ROUTE(app, "/metrics")([&supervisor](){
+        crow::response response(200, supervisor ? supervisor->collect() : Metrics::getInstance().render());
+        response.add_header("Content-Type", "text/plain; version=0.0.4");
+        return response;
+    });
 
     // 静态文件服务
     CROW_ROUTE(app, "/")
@@ -85,270 +544,512 @@ int main() {
     // === API 接口 ===
 
     CROW_ROUTE(app, "/api/userinfo/<string>")
-    ([](const std::string& card_number) {
-        std::string userInfo = DatabaseManager::getInstance().getUserInfo(card_number);
-        crow::response response(200, userInfo);
-        response.add_header("Content-Type", "application/json");
-        return response;
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        return jsonResponse(LedgerStore::getInstance().getUserInfo(card_number));
     });
 
     CROW_ROUTE(app, "/api/login").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效的JSON数据");
+    ([&sessions, sessionsEnabled, &ipLimiter, &cardLimiter](const crow::request& req) {
+        LoginRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        const std::string& card_number = body.card_number;
+        crow::response limited;
+        if (throttled(ipLimiter, cardLimiter, req, card_number, limited)) return limited;
 
-        std::string card_number = json["card_number"].s();
-        std::string password = json["password"].s();
+        bool success = LedgerStore::getInstance().verifyLogin(card_number, body.password);
 
-        bool success = DatabaseManager::getInstance().verifyLogin(card_number, password);
+        if (!success) return loginFailed.make();
+        if (!sessionsEnabled) return JsonResponse().add("status", "success").add("message", "登录成功").make();
+        return JsonResponse()
+            .add("status", "success")
+            .add("message", "登录成功")
+            .add("token", sessions.create(card_number))
+            .add("expires_in", sessions.ttl())
+            .make();
+    });
 
-        crow::json::wvalue response;
-        if (success) {
-            response["status"] = "success";
-            response["message"] = "登录成功";
-        } else {
-            response["status"] = "error";
-            response["message"] = "卡号或密码错误";
-        }
-        return crow::response(200, response);
+    CROW_ROUTE(app, "/api/logout").methods("POST"_method)
+    ([&sessions](const crow::request& req) {
+        sessions.revoke(bearerToken(req));
+        return responses::success().make();
     });
 
     // 修改密码 (需验证旧密码)
-    CROW_ROUTE(app, "/api/password/change").methods("POST"_method)([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        std::string card = json["card_number"].s();
-        // 先验证旧密码
-        if(DatabaseManager::getInstance().verifyLogin(card, json["old_password"].s())) {
-            bool ok = DatabaseManager::getInstance().updatePassword(card, json["new_password"].s());
-            return crow::response(200, ok ? "{\"status\":\"success\"}" : "{\"status\":\"error\"}");
+    CROW_ROUTE(app, "/api/password/change").methods("POST"_method)([&sessions, sessionsEnabled](const crow::request& req) {
+        PasswordChangeRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        // 带有效会话令牌时卡号取自会话，不再查库验证旧密码；否则仍按旧密码验证
+        std::string token = sessionsEnabled ? bearerToken(req) : "";
+        std::string card;
+        bool authorized = false;
+        if (!token.empty()) {
+            if (!sessions.validate(token, card)) return responses::sessionExpired().make();
+            if (!body.card_number.empty() && body.card_number != card) {
+                return sessionMismatch.make();
+            }
+            authorized = true;
+        } else {
+            card = body.card_number;
+            authorized = LedgerStore::getInstance().verifyLogin(card, body.old_password);
         }
-        return crow::response(200, "{\"status\":\"error\",\"message\":\"旧密码错误\"}");
+        if (!authorized) return wrongOldPassword.make();
+        bool ok = LedgerStore::getInstance().updatePassword(card, body.new_password);
+        if (ok) sessions.revokeCard(card, token); // 其他设备上的会话随旧密码一起失效
+        return (ok ? responses::success() : responses::error()).make();
     });
 
     // 重置密码 (验证身份信息)
-    CROW_ROUTE(app, "/api/password/reset").methods("POST"_method)([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        std::string card = json["card_number"].s();
-        if(DatabaseManager::getInstance().verifyIdentity(card, json["name"].s(), json["phone"].s())) {
-            bool ok = DatabaseManager::getInstance().updatePassword(card, json["new_password"].s());
-            return crow::response(200, ok ? "{\"status\":\"success\"}" : "{\"status\":\"error\"}");
+    CROW_ROUTE(app, "/api/password/reset").methods("POST"_method)([&sessions, &ipLimiter, &cardLimiter](const crow::request& req) {
+        PasswordResetRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        const std::string& card = body.card_number;
+        crow::response limited;
+        if (throttled(ipLimiter, cardLimiter, req, card, limited)) return limited;
+        if(LedgerStore::getInstance().verifyIdentity(card, body.name, body.phone)) {
+            bool ok = LedgerStore::getInstance().updatePassword(card, body.new_password);
+            if (ok) sessions.revokeCard(card, ""); // 密码被重置，已登录的会话全部作废
+            return (ok ? responses::success() : responses::error()).make();
         }
-        return crow::response(200, "{\"status\":\"error\",\"message\":\"身份信息验证失败\"}");
+        return identityMismatch.make();
     });
 
     // === 新增：销户验证 ===
     CROW_ROUTE(app, "/api/account/check").methods("POST"_method)([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        std::string card = json["card_number"].s();
+        AccountCheckRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
 
         double balance = 0.0;
-        bool ok = DatabaseManager::getInstance().checkAccountForDeletion(
-            card, json["name"].s(), json["phone"].s(), balance
+        bool ok = LedgerStore::getInstance().checkAccountForDeletion(
+            body.card_number, body.name, body.phone, balance
         );
 
-        if (ok) {
-            crow::json::wvalue res;
-            res["status"] = "success";
-            res["balance"] = balance;
-            return crow::response(200, res);
-        }
-        return crow::response(200, "{\"status\":\"error\",\"message\":\"信息不匹配\"}");
+        if (ok) return JsonResponse().add("status", "success").add("balance", Money{toCents(balance)}).make();
+        return infoMismatch.make();
     });
 
     // === 新增：执行销户 ===
-    CROW_ROUTE(app, "/api/account/delete").methods("POST"_method)([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        std::string card = json["card_number"].s();
-        bool success = DatabaseManager::getInstance().deleteAccount(card);
-        return crow::response(200, success ? "{\"status\":\"success\"}" : "{\"status\":\"error\"}");
+    CROW_ROUTE(app, "/api/account/delete").methods("POST"_method)([&sessions, sessionsEnabled](const crow::request& req) {
+        CardRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, body.card_number, denied)) return denied;
+        bool success = LedgerStore::getInstance().deleteAccount(body.card_number);
+        if (success) sessions.revokeCard(body.card_number, "");
+        return (success ? responses::success() : responses::error()).make();
     });
 
     CROW_ROUTE(app, "/api/balance/<string>")
-    ([](const std::string& card_number) {
-        double balance = DatabaseManager::getInstance().getBalance(card_number);
-        crow::json::wvalue response;
-        if (balance >= 0) {
-            response["status"] = "success";
-            response["balance"] = balance;
-        } else {
-            response["status"] = "error";
-            response["message"] = "查询失败";
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        // ?as_of=YYYY-MM-DD[ HH:MM:SS] 查询历史余额，只给日期时取当天日终
+        const char* asOfParam = req.url_params.get("as_of");
+        if (asOfParam) {
+            std::string asOf;
+            if (!parseTimeParam(asOfParam, true, asOf) || asOf.empty()) {
+                return responses::badParameter().make();
+            }
+            int64_t cents = 0;
+            if (!LedgerStore::getInstance().balanceAsOf(card_number, asOf, cents)) {
+                return responses::queryFailed().make();
+            }
+            return JsonResponse().add("status", "success").add("balance", Money{cents}).add("as_of", asOf).make();
         }
-        return crow::response(200, response);
+        double balance = LedgerStore::getInstance().getBalance(card_number);
+        if (balance < 0) return responses::queryFailed().make();
+        return JsonResponse().add("status", "success").add("balance", Money{toCents(balance)}).make();
     });
 
-    CROW_ROUTE(app, "/api/deposit").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效数据");
+    // 消费统计：?period=day|month&from=&to=，只读汇总表；默认最近 30 天或最近 12 个月
+    CROW_ROUTE(app, "/api/analytics/<string>")
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        const char* periodParam = req.url_params.get("period");
+        std::string period = periodParam ? periodParam : "day";
+        if (period != "day" && period != "month") {
+            return responses::badParameter().make();
+        }
+        bool monthly = period == "month";
+        size_t width = monthly ? 7 : 10;
+        const char* fromParam = req.url_params.get("from");
+        const char* toParam = req.url_params.get("to");
+        std::string from = fromParam ? fromParam : (monthly ? localDate(0, 11) : localDate(29, 0)).substr(0, width);
+        std::string to = toParam ? toParam : localDate(0, 0).substr(0, width);
+        std::string fromCheck, toCheck;
+        if (from.size() != width || to.size() != width || from > to ||
+            !parseTimeParam((monthly ? from + "-01" : from).c_str(), false, fromCheck) ||
+            !parseTimeParam((monthly ? to + "-01" : to).c_str(), false, toCheck)) {
+            return responses::badParameter().make();
+        }
 
-        std::string card_number = json["card_number"].s();
-        double amount = json["amount"].d();
+        std::vector<SpendingBucket> buckets;
+        if (!LedgerStore::getInstance().loadSpending(card_number, monthly, from, to, buckets)) {
+            return responses::queryFailed().make();
+        }
+        std::string out = "{\"status\":\"success\",\"period\":\"" + period + "\",\"from\":\"" + from + "\",\"to\":\"" + to + "\",\"buckets\":[";
+        for (size_t i = 0; i < buckets.size(); i++) {
+            if (i) out += ",";
+            out += "{\"period\":\"" + buckets[i].period + "\"";
+            for (int c = 0; c < SpendCategoryCount; c++) {
+                out += std::string(",\"") + spendingCategoryName(c) + "\":{\"amount\":" + formatCents(buckets[i].cents[c])
+                     + ",\"count\":" + std::to_string(buckets[i].count[c]) + "}";
+            }
+            out += "}";
+        }
+        out += "]}";
+        return jsonResponse(std::move(out));
+    });
 
-        bool success = DatabaseManager::getInstance().deposit(card_number, amount);
+    CROW_ROUTE(app, "/api/deposit").methods("POST"_method)
+    ([&sessions, sessionsEnabled](const crow::request& req) {
+        AmountRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, body.card_number, denied)) return denied;
 
-        crow::json::wvalue response;
-        if (success) {
-            response["status"] = "success";
-            response["message"] = "存款成功";
-        } else {
-            response["status"] = "error";
-            response["message"] = "存款失败";
-        }
-        return crow::response(200, response);
+        bool success = LedgerStore::getInstance().deposit(body.card_number, body.amount);
+        return (success ? depositSucceeded : depositFailed).make();
     });
 
     CROW_ROUTE(app, "/api/withdraw").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效数据");
-
-        std::string card_number = json["card_number"].s();
-        double amount = json["amount"].d();
+    ([&sessions, sessionsEnabled](const crow::request& req) {
+        AmountRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, body.card_number, denied)) return denied;
 
-        bool success = DatabaseManager::getInstance().withdraw(card_number, amount);
+        bool success = LedgerStore::getInstance().withdraw(body.card_number, body.amount);
+        return (success ? withdrawSucceeded : withdrawFailed).make();
+    });
 
-        crow::json::wvalue response;
-        if (success) {
-            response["status"] = "success";
-            response["message"] = "取款成功";
-        } else {
-            response["status"] = "error";
-            response["message"] = "余额不足或操作失败";
+    // 全量流水导出：/api/transactions/<card>/export?format=csv|ndjson&from=&to=
+    // 按时间顺序边读边以 chunked 编码发送，内存占用与流水条数无关
+    CROW_ROUTE(app, "/api/transactions/<string>/export")
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        const char* formatParam = req.url_params.get("format");
+        std::string format = formatParam ? formatParam : "csv";
+        std::string from, to;
+        if ((format != "csv" && format != "ndjson") || !parseTimeParam(req.url_params.get("from"), false, from) || !parseTimeParam(req.url_params.get("to"), true, to)) {
+            return responses::badParameter().make();
         }
-        return crow::response(200, response);
+        // 卡号会拼进 Content-Disposition，格式不对的（旧数据里的自选卡号）不导出
+        if (!CardAllocator::wellFormed(card_number)) return responses::badParameter().make();
+        if (!LedgerStore::getInstance().isCardNumberExists(card_number)) {
+            return exportNotFound.make();
+        }
+        std::shared_ptr<TransactionCursor> cursor = LedgerStore::getInstance().openTransactionCursor(card_number, from, to);
+        if (!cursor) return exportFailed.make();
+
+        bool csv = format == "csv";
+        auto headerSent = std::make_shared<bool>(false);
+        crow::response response(200);
+        response.add_header("Content-Type", csv ? "text/csv; charset=utf-8" : "application/x-ndjson");
+        response.add_header("Content-Disposition", "attachment; filename=\"" + card_number + (csv ? "-transactions.csv\"" : "-transactions.ndjson\""));
+        // 每次凑够约 16KB 交给连接写出，写完再取下一块
+        response.set_body_producer([cursor, csv, headerSent](std::string& out) {
+            if (csv && !*headerSent) out += "type,amount,balance_after,description,create_time\n";
+            *headerSent = true;
+            TransactionRow row;
+            while (out.size() < 16384) {
+                if (!cursor->next(row)) return false;
+                if (csv) {
+                    out += row.type + "," + formatCents(row.amountCents) + "," + formatCents(row.balanceAfterCents) + ","
+                         + csvField(row.description) + "," + row.createTime + "\n";
+                } else {
+                    out += "{\"type\":\"" + escapeJson(row.type) + "\",\"amount\":" + formatCents(row.amountCents)
+                         + ",\"balance_after\":" + formatCents(row.balanceAfterCents)
+                         + ",\"description\":\"" + escapeJson(row.description) + "\",\"create_time\":\"" + row.createTime + "\"}\n";
+                }
+            }
+            return true;
+        });
+        return response;
     });
 
     CROW_ROUTE(app, "/api/transactions/<string>")
-    ([](const std::string& card_number) {
-        std::string history = DatabaseManager::getInstance().getTransactionHistory(card_number);
-        crow::response response(200, history);
-        response.add_header("Content-Type", "application/json");
-        return response;
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        return jsonResponse(LedgerStore::getInstance().getTransactionHistory(card_number));
     });
 
     CROW_ROUTE(app, "/api/check-card/<string>")
-    ([](const std::string& card_number) {
-        bool exists = DatabaseManager::getInstance().isCardNumberExists(card_number);
-        crow::json::wvalue response;
-        response["status"] = "success";
-        response["available"] = !exists;
-        return crow::response(200, response);
+    ([&ipLimiter, &cardLimiter](const crow::request& req, const std::string& card_number) {
+        crow::response limited;
+        if (throttled(ipLimiter, cardLimiter, req, "", limited)) return limited;
+        bool exists = LedgerStore::getInstance().isCardNumberExists(card_number);
+        return (exists ? cardTaken : cardAvailable).make();
+    });
+
+    // 分配一个可用卡号，客户端不必再自己编号和逐个检查
+    CROW_ROUTE(app, "/api/card/allocate").methods("POST"_method)
+    ([&allocator, &ipLimiter, &cardLimiter](const crow::request& req) {
+        crow::response limited;
+        if (throttled(ipLimiter, cardLimiter, req, "", limited)) return limited;
+        std::string card_number = allocator.allocate();
+        if (card_number.empty()) return allocateFailed.make();
+        return JsonResponse().add("status", "success").add("card_number", card_number).make();
+    });
+
+    // 管理员批量导入，请求体为 CSV；需要设置 BANK_ADMIN_TOKEN 并在 X-Admin-Token 头里带上
+    CROW_ROUTE(app, "/api/admin/import").methods("POST"_method)
+    ([&allocator](const crow::request& req) {
+        const char* token = getenv("BANK_ADMIN_TOKEN");
+        if (!token || !*token || req.get_header_value("X-Admin-Token") != token) {
+            return responses::forbidden().make();
+        }
+        std::istringstream csv(req.body);
+        AccountImporter::Report report = makeImporter(allocator).run(csv);
+        return jsonResponse(report.toJson());
     });
 
     CROW_ROUTE(app, "/api/register").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效数据");
-
-        std::string name = json["name"].s();
-        std::string id_card = json["id_card"].s();
-        std::string phone = json["phone"].s();
-        std::string address = json["address"].s();
-        std::string card_number = json["card_number"].s();
-        std::string password = json["password"].s();
-        double initial_deposit = json["initial_deposit"].d();
-
-        bool success = DatabaseManager::getInstance().createAccount(
-            name, id_card, phone, address, card_number, password, initial_deposit
-        );
+    ([&allocator](const crow::request& req) {
+        RegisterRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
 
-        crow::json::wvalue response;
-        if (success) {
-            response["status"] = "success";
-            response["message"] = "开户成功";
-            // 发送欢迎消息
-            DatabaseManager::getInstance().sendSystemMessage(card_number, "开户成功", "欢迎使用银行储蓄系统！");
-        } else {
-            response["status"] = "error";
-            response["message"] = "开户失败，请检查信息";
+        // 未填卡号时由服务端分配；分配出的号在开户前被自选卡号抢先占用时换一个号重试
+        std::string& card_number = body.card_number;
+        if (!card_number.empty() && !CardAllocator::wellFormed(card_number)) return invalidRequest("卡号应为16到19位数字");
+        bool allocated = card_number.empty();
+        bool success = false;
+        for (int attempt = 0; attempt < 3; attempt++) {
+            if (allocated) card_number = allocator.allocate();
+            if (card_number.empty()) return allocateFailed.make();
+            success = LedgerStore::getInstance().createAccount(
+                body.name, body.id_card, body.phone, body.address, card_number, body.password, body.initial_deposit
+            );
+            if (success || !allocated || !LedgerStore::getInstance().isCardNumberExists(card_number)) break;
         }
-        return crow::response(200, response);
+
+        if (!success) return registerFailed.make();
+        // 发送欢迎消息
+        LedgerStore::getInstance().sendSystemMessage(card_number, "开户成功", "欢迎使用银行储蓄系统！");
+        return JsonResponse().add("status", "success").add("message", "开户成功").add("card_number", card_number).make();
     });
 
     //查询用户姓名 API
     CROW_ROUTE(app, "/api/user/name/<string>")
-    ([](const std::string& card_number) {
-        std::string name = DatabaseManager::getInstance().getUserName(card_number);
-        crow::json::wvalue response;
-        if (!name.empty()) {
-            response["status"] = "success";
-            response["name"] = name;
-        } else {
-            response["status"] = "error";
-            response["message"] = "用户不存在";
-        }
-        return crow::response(200, response);
+    ([&ipLimiter, &cardLimiter](const crow::request& req, const std::string& card_number) {
+        crow::response limited;
+        if (throttled(ipLimiter, cardLimiter, req, "", limited)) return limited;
+        std::string name = LedgerStore::getInstance().getUserName(card_number);
+        if (name.empty()) return userNotFound.make();
+        return JsonResponse().add("status", "success").add("name", name).make();
     });
 
-    CROW_ROUTE(app, "/api/user/update").methods("POST"_method)([](const crow::request& req) {
-            auto json = crow::json::load(req.body);
-            if(!json) return crow::response(400);
-            bool success = DatabaseManager::getInstance().updateUserInfo(
-                json["card_number"].s(), json["name"].s(), json["id_card"].s(), json["phone"].s(), json["address"].s()
+    CROW_ROUTE(app, "/api/user/update").methods("POST"_method)([&sessions, sessionsEnabled](const crow::request& req) {
+            UserUpdateRequest body;
+            std::string error;
+            if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+            crow::response denied;
+            if (unauthorized(sessions, sessionsEnabled, req, body.card_number, denied)) return denied;
+            bool success = LedgerStore::getInstance().updateUserInfo(
+                body.card_number, body.name, body.id_card, body.phone, body.address
             );
-            return crow::response(200, success ? "{\"status\":\"success\"}" : "{\"status\":\"error\"}");
+            return (success ? responses::success() : responses::error()).make();
         });
 
     //转账 API
     CROW_ROUTE(app, "/api/transfer").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效JSON");
-
-        std::string from_card = json["from_card"].s();
-        std::string to_card = json["to_card"].s();
-        double amount = json["amount"].d();
-
-        // 修复：安全的字符串获取
-        std::string message = "";
-        if (json.has("message")) {
-            // 强制转换为 string
-            std::ostringstream os;
-            os << json["message"].s();
-            message = os.str();
-        }
+    ([&sessions, sessionsEnabled](const crow::request& req) {
+        TransferRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, body.from_card, denied)) return denied;
 
-        bool is_anonymous = false;
-        if (json.has("is_anonymous")) {
-            is_anonymous = json["is_anonymous"].b();
-        }
+        bool success = LedgerStore::getInstance().transfer(body.from_card, body.to_card, body.amount, body.message, body.is_anonymous);
+        return (success ? transferSucceeded : transferFailed).make();
+    });
 
-        bool success = DatabaseManager::getInstance().transfer(from_card, to_card, amount, message, is_anonymous);
+    //批量转账 API（代发工资）：{"from_card", "is_anonymous", "items": [{"to_card", "amount", "message"}]}
+    CROW_ROUTE(app, "/api/transfer/batch").methods("POST"_method)
+    ([&sessions, sessionsEnabled](const crow::request& req) {
+        const size_t maxItems = 10000;
+        BatchTransferRequest batch;
+        std::string error;
+        if (!decodeRequest(req.body, batch, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, batch.from_card, denied)) return denied;
+        if (batch.items.size() > maxItems) return invalidRequest("单批最多 10000 笔");
 
-        crow::json::wvalue response;
-        if (success) {
-            response["status"] = "success";
-            response["message"] = "转账成功";
-        } else {
-            response["status"] = "error";
-            response["message"] = "转账失败：余额不足或卡号无效";
+        const std::vector<TransferLine>& lines = batch.items;
+        std::vector<bool> ok;
+        LedgerStore::getInstance().transferBatch(batch.from_card, lines, batch.is_anonymous, ok);
+
+        size_t succeeded = 0;
+        std::string results = "[";
+        results.reserve(lines.size() * 48 + 2);
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i) results += ",";
+            results += "{\"to_card\":\"";
+            appendEscapedJson(results, lines[i].toCard.data(), lines[i].toCard.size());
+            results += ok[i] ? "\",\"status\":\"success\"}" : "\",\"status\":\"error\"}";
+            if (ok[i]) succeeded++;
         }
-        return crow::response(200, response);
+        results += "]";
+        return JsonResponse(results.size() + 96)
+            .add("status", succeeded == lines.size() ? "success" : "partial")
+            .add("succeeded", succeeded)
+            .add("failed", lines.size() - succeeded)
+            .add("results", RawJson{results})
+            .make();
     });
 
     //获取消息列表 API
     CROW_ROUTE(app, "/api/messages/<string>")
-    ([](const std::string& card_number) {
-        std::string msgs = DatabaseManager::getInstance().getUserMessages(card_number);
-        crow::response response(200, msgs);
-        response.add_header("Content-Type", "application/json");
-        return response;
+    ([&sessions, sessionsEnabled](const crow::request& req, const std::string& card_number) {
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, card_number, denied)) return denied;
+        return jsonResponse(LedgerStore::getInstance().getUserMessages(card_number));
     });
 
     //标记消息已读 API
     CROW_ROUTE(app, "/api/messages/read").methods("POST"_method)
-    ([](const crow::request& req) {
-        auto json = crow::json::load(req.body);
-        if (!json) return crow::response(400, "无效");
-        int msg_id = json["id"].i();
-        DatabaseManager::getInstance().markMessageRead(msg_id);
-        return crow::response(200, "{\"status\":\"success\"}");
+    ([&sessions, sessionsEnabled](const crow::request& req) {
+        MessageReadRequest body;
+        std::string error;
+        if (!decodeRequest(req.body, body, error)) return invalidRequest(error);
+        crow::response denied;
+        if (unauthorized(sessions, sessionsEnabled, req, body.card_number, denied)) return denied;
+        LedgerStore::getInstance().markMessageRead(body.card_number, body.id);
+        return responses::success().make();
     });
 
-    CROW_ROUTE(app, "/health")([](){ return "OK"; });
+
+    // 持久化热缓存：每 BANK_WARM_CACHE_INTERVAL 秒（默认 300，0 表示不用）把缓存中的卡连同版本号写进
+    // BANK_WARM_CACHE_FILE（默认 warm_cache.bin），正常退出时再写一次。启动时映射上次的文件，代替按最近流水预读：
+    // 后台按版本号批量核对，一致的直接放进缓存；核对完之前未命中的卡也先查文件。只在单进程且有缓存层时起作用
+    const char* warmFileEnv = getenv("BANK_WARM_CACHE_FILE");
+    std::string warmCacheFile = warmFileEnv && *warmFileEnv ? warmFileEnv : "warm_cache.bin";
+    int warmCacheInterval = multiProcess ? 0 : (int)envNumber("BANK_WARM_CACHE_INTERVAL", 300);
+    size_t warmFileCards = 0;
+    if (warmCacheInterval > 0 && !takeover) {
+        warmFileCards = LedgerStore::getInstance().openWarmCache(warmCacheFile);
+        if (warmFileCards > 0) std::cout << "热缓存文件: " << warmCacheFile << ", " << warmFileCards << " 张卡待核对" << std::endl;
+    }
+    // 第一次运行核对启动时映射的文件，之后定期重写
+    bool warmFileChecked = warmFileCards == 0;
+    PeriodicJob warmCacheWriter([&warmFileChecked, warmCacheFile](int64_t& rows) {
+        LedgerStore& store = LedgerStore::getInstance();
+        if (warmFileChecked) return store.saveWarmCache(warmCacheFile, rows);
+        auto begin = std::chrono::steady_clock::now();
+        warmFileChecked = store.revalidateWarmCache(rows);
+        if (warmFileChecked) {
+            std::cout << "热缓存文件核对完成: 放入缓存 " << rows << " 张卡, 用时 "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() << "ms" << std::endl;
+        }
+        return warmFileChecked;
+    }, warmCacheInterval);
+    if (warmCacheInterval > 0) {
+        Metrics::getInstance().add("bank_warm_cache_rows_total", "核对放入缓存及写入热缓存文件的卡数", "counter", [&warmCacheWriter] { return (double)warmCacheWriter.rowsWritten; });
+        Metrics::getInstance().add("bank_warm_cache_failures_total", "热缓存文件核对或写入失败次数", "counter", [&warmCacheWriter] { return (double)warmCacheWriter.failures; });
+    }
+
+    // 启动预热：建好连接并预编译请求用到的语句，再用 BANK_WARMUP_THREADS 个线程（默认 4）预读最近有流水的
+    // BANK_WARMUP_CARDS 张卡（默认 10000，0 表示不预读），填进缓存、热起数据库的缓冲池，之后才开始 accept。
+    // 多进程时只由 0 号工作进程预读；热重启时缓存要等交接完成，由旧进程交来的热点卡号预热；有热缓存文件时改由它预热。
+    // 数据库连不上时照常启动，/ready 返回 503，后台每秒重试
+    size_t warmCards = (size_t)envNumber("BANK_WARMUP_CARDS", 10000);
+    int warmThreads = std::max(1, (int)envNumber("BANK_WARMUP_THREADS", 4));
+    auto warmUp = [&ready, warmCards, warmThreads, workerIndex, takeover, warmFileCards]() {
+        auto begin = std::chrono::steady_clock::now();
+        LedgerStore& store = LedgerStore::getInstance();
+        if (!store.prepareAll()) return false;
+        std::vector<std::string> cards;
+        if (warmCards > 0 && workerIndex == 0 && !takeover && warmFileCards == 0 && store.recentCards(warmCards, cards)) store.preload(cards, warmThreads);
+        std::cout << "启动预热完成: 预读 " << cards.size() << " 张卡, 用时 "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count() << "ms" << std::endl;
+        ready = true;
+        return true;
+    };
+    PeriodicJob warmRetry([&ready, &warmUp](int64_t& rows) {
+        rows = 0;
+        return ready || warmUp();
+    }, 1);
+    if (!warmUp()) {
+        std::cerr << "启动预热失败，/ready 返回 503，后台每秒重试" << std::endl;
+        warmRetry.start();
+    }
+    if (warmCacheInterval > 0 && !takeover) warmCacheWriter.start();
+
+    // 热重启交接：被替换时先交出会话表，停止 accept 并处理完已有连接后，
+    // 停掉后台任务，再交出期间的会话变化和缓存热点卡号
+    HotRestart::Hooks hooks;
+    hooks.begin = [] { LedgerStore::getInstance().beginHandoff(false); };
+    hooks.listenHandle = [&app] { return app.listen_handle(); };
+    hooks.stopAccepting = [&app, &ready] {
+        ready = false;
+        app.stop_accepting();
+    };
+    hooks.connections = [&app] { return app.connection_count(); };
+    hooks.exportState = [&sessions, &roller, &spendingRollup, &warmCacheWriter](bool final) {
+        if (!final) {
+            sessions.beginHandoff();
+            return sessions.exportState();
+        }
+        roller.stop();
+        spendingRollup.stop();
+        warmCacheWriter.stop();
+        return sessions.exportState() + LedgerStore::getInstance().exportWarmState();
+    };
+    hooks.stop = [&app] { app.stop(); };
+    if (takeover) {
+        std::string state;
+        sessions.beginHandoff();
+        if (handoff.ready(state)) {
+            std::cout << "热重启: 导入会话 " << sessions.importState(state) << " 个" << std::endl;
+        } else {
+            std::cerr << "热重启: 旧进程没有发来会话表" << std::endl;
+        }
+        app.listen_fd(inheritedFd);
+        handoff.finish(hooks, [&](const std::string& state, bool complete) {
+            sessions.importState(state);
+            sessions.endHandoff();
+            LedgerStore::getInstance().finishHandoff(state, complete);
+            if (rollInterval > 0) roller.start();
+            if (rollupInterval > 0) spendingRollup.start();
+            if (warmCacheInterval > 0) warmCacheWriter.start();
+        });
+    } else if (!multiProcess) {
+        handoff.listen(hooks);
+    }
+
+    // Crow 另用一个线程 accept，请求处理线程数比 concurrency 少一个。
+    // 没有指定时单进程用满 CPU 核数，多进程时各进程分摊
+    int hardware = (int)std::thread::hardware_concurrency();
+    int defaultThreads = multiProcess ? std::max(2, hardware / supervisor->workerCount()) - 1 : hardware - 1;
+    int ioThreads = placement.ioThreads(defaultThreads);
+    std::cout << placement.report(ioThreads, admissionOptions.maxLimit);
+    app.thread_init([&placement](int index) {
+        placement.pinIoThread(index);
+        // SQLite 每个 I/O 线程一条连接，启动时就打开并预编译好，第一批请求不用现场准备语句
+        LedgerStore::getInstance().prepareAll();
+    });
 
     std::cout << "服务启动在端口 18080" << std::endl;
-    app.port(18080).multithreaded().run();
+    app.port(18080).concurrency((uint16_t)std::min(ioThreads + 1, 65535)).reuse_port(multiProcess).run();
+    handoff.shutdown();
+    if (warmCacheInterval > 0) {
+        warmCacheWriter.stop();
+        int64_t rows = 0;
+        if (LedgerStore::getInstance().saveWarmCache(warmCacheFile, rows) && rows > 0) {
+            std::cout << "热缓存文件已写入 " << rows << " 张卡" << std::endl;
+        }
+    }
     return 0;
 }
\ No newline at end of file
@@ -6,6 +6,13 @@ let isBalanceHidden = true;
 let currentMessages = [];
 let snackbarTimer = null;
 
+// 按卡号操作的接口要带登录令牌（多进程部署时登录不发令牌，这里也就不带）
+function authHeaders(headers = {}) {
+    const token = sessionStorage.getItem('sessionToken');
+    if (token) headers['Authorization'] = 'Bearer ' + token;
+    return headers;
+}
+
 document.addEventListener('DOMContentLoaded', function() {
     currentCardNumber = sessionStorage.getItem('cardNumber');
     if (!currentCardNumber) {
@@ -92,7 +99,7 @@ async function initializeDashboard() {
 
 async function loadUserInfo() {
     try {
-        const res = await fetch(`/api/userinfo/${currentCardNumber}`);
+        const res = await fetch(`/api/userinfo/${currentCardNumber}`, { headers: authHeaders() });
         const data = await res.json();
         if (data.status === 'success') document.getElementById('userName').textContent = data.name;
     } catch(e){}
@@ -100,7 +107,7 @@ async function loadUserInfo() {
 
 async function loadBalance() {
     try {
-        const res = await fetch(`/api/balance/${currentCardNumber}`);
+        const res = await fetch(`/api/balance/${currentCardNumber}`, { headers: authHeaders() });
         const data = await res.json();
         if (data.status === 'success') {
             userBalance = parseFloat(data.balance).toFixed(2);
@@ -185,7 +192,7 @@ function renderTransactionItem(t) {
 async function loadRecentTransactions() {
     const container = document.getElementById('recentTransactions');
     try {
-        const res = await fetch(`/api/transactions/${currentCardNumber}`);
+        const res = await fetch(`/api/transactions/${currentCardNumber}`, { headers: authHeaders() });
         const data = await res.json();
 
         if (data.status === 'success' && data.transactions && data.transactions.length > 0) {
@@ -206,7 +213,7 @@ async function showTransactionHistory() {
     container.innerHTML = '<div style="text-align:center; padding:30px; color:var(--anzhiyu-secondtext);">加载中...</div>';
 
     try {
-        const res = await fetch(`/api/transactions/${currentCardNumber}`);
+        const res = await fetch(`/api/transactions/${currentCardNumber}`, { headers: authHeaders() });
         const data = await res.json();
 
         if (data.status === 'success' && data.transactions && data.transactions.length > 0) {
@@ -227,7 +234,7 @@ function closeHistoryModal() { document.getElementById('historyModal').style.dis
 // === 消息系统 ===
 async function loadMessages() {
     try {
-        const res = await fetch(`/api/messages/${currentCardNumber}`);
+        const res = await fetch(`/api/messages/${currentCardNumber}`, { headers: authHeaders() });
         const data = await res.json();
         if (data.status === 'success') {
             currentMessages = data.messages;
@@ -290,7 +297,7 @@ async function openMessageDetail(id) {
         msg.is_read = 1;
         updateMessageBadge();
         if(document.getElementById('messagesModal').style.display === 'flex') showMessagesModal();
-        fetch('/api/messages/read', { method: 'POST', headers:{'Content-Type':'application/json'}, body: JSON.stringify({id}) });
+        fetch('/api/messages/read', { method: 'POST', headers: authHeaders({'Content-Type':'application/json'}), body: JSON.stringify({ card_number: currentCardNumber, id }) });
     }
 
     const box = document.getElementById('msgDetailContentBox');
@@ -432,7 +439,7 @@ async function submitTransfer() {
     document.getElementById('transferConfirmModal').style.display = 'none';
 
     try {
-        const res = await fetch('/api/transfer', { method:'POST', headers:{'Content-Type':'application/json'}, body:JSON.stringify(data) });
+        const res = await fetch('/api/transfer', { method:'POST', headers: authHeaders({'Content-Type':'application/json'}), body:JSON.stringify(data) });
         const ret = await res.json();
         if(ret.status === 'success') {
             showMessage('转账成功！', 'success');
@@ -461,7 +468,7 @@ async function processWithdraw() {
 }
 async function doTrans(url, data) {
     try {
-        const res = await fetch(url, { method:'POST', headers:{'Content-Type':'application/json'}, body:JSON.stringify(data) });
+        const res = await fetch(url, { method:'POST', headers: authHeaders({'Content-Type':'application/json'}), body:JSON.stringify(data) });
         const ret = await res.json();
         showMessage(ret.message, ret.status==='success'?'success':'error');
         if(ret.status === 'success') { loadBalance(); loadRecentTransactions(); }
@@ -471,7 +478,14 @@ async function doTrans(url, data) {
 function logout() { showLogoutModal(); }
 function showLogoutModal() { document.getElementById('logoutModal').style.display = 'flex'; }
 function closeLogoutModal() { document.getElementById('logoutModal').style.display = 'none'; }
-function confirmLogout() { sessionStorage.clear(); window.location.href = '/'; }
+async function confirmLogout() {
+    const token = sessionStorage.getItem('sessionToken');
+    if (token) {
+        try { await fetch('/api/logout', { method: 'POST', headers: { 'Authorization': 'Bearer ' + token } }); } catch (e) {}
+    }
+    sessionStorage.clear();
+    window.location.href = '/';
+}
 function showAccountInfo() { window.location.href = '/profile.html'; }
 
 function showMessage(msg, type) {
@@ -1,5 +1,12 @@
 let deleteTimer = null;
 
+// 按卡号操作的接口要带登录令牌（多进程部署时登录不发令牌，这里也就不带）
+function authHeaders(headers = {}) {
+    const token = sessionStorage.getItem('sessionToken');
+    if (token) headers['Authorization'] = 'Bearer ' + token;
+    return headers;
+}
+
 // 验证并显示确认框
 async function verifyAndDelete() {
     const card = document.getElementById('delCard').value;
@@ -77,7 +84,7 @@ async function executeDelete() {
     try {
         const res = await fetch('/api/account/delete', {
             method: 'POST',
-            headers: { 'Content-Type': 'application/json' },
+            headers: authHeaders({ 'Content-Type': 'application/json' }),
             body: JSON.stringify({ card_number: card })
         });
         const data = await res.json();
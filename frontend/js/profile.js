@@ -3,6 +3,13 @@ let realBalance = 0;
 let isBalanceHidden = true;
 let snackbarTimer = null;
 
+// 按卡号操作的接口要带登录令牌（多进程部署时登录不发令牌，这里也就不带）
+function authHeaders(headers = {}) {
+    const token = sessionStorage.getItem('sessionToken');
+    if (token) headers['Authorization'] = 'Bearer ' + token;
+    return headers;
+}
+
 document.addEventListener('DOMContentLoaded', function() {
     currentCardNumber = sessionStorage.getItem('cardNumber');
     if (!currentCardNumber) { window.location.href = '/'; return; }
@@ -11,7 +18,7 @@ document.addEventListener('DOMContentLoaded', function() {
 
 async function loadProfile() {
     try {
-        const response = await fetch(`/api/userinfo/${currentCardNumber}`);
+        const response = await fetch(`/api/userinfo/${currentCardNumber}`, { headers: authHeaders() });
         const data = await response.json();
         if (data.status === 'success') {
             setInput('infoName', data.name);
@@ -99,7 +106,7 @@ async function submitEdit() {
         address: address
     };
     try {
-        const res = await fetch('/api/user/update', { method: 'POST', headers: {'Content-Type': 'application/json'}, body: JSON.stringify(data) });
+        const res = await fetch('/api/user/update', { method: 'POST', headers: authHeaders({'Content-Type': 'application/json'}), body: JSON.stringify(data) });
         const ret = await res.json();
         showMessage(ret.status==='success'?'保存成功':'保存失败', ret.status==='success'?'success':'error');
     } catch (e) { showMessage('网络错误', 'error'); }
@@ -123,11 +130,21 @@ async function submitChangePwd() {
     if(newP !== cP) return showMessage('两次新密码不一致', 'error');
 
     try {
+        // 有登录令牌时由会话确认身份，否则服务端按旧密码验证
+        const headers = {'Content-Type': 'application/json'};
+        const token = sessionStorage.getItem('sessionToken');
+        if (token) headers['Authorization'] = 'Bearer ' + token;
         const res = await fetch('/api/password/change', {
-            method: 'POST', headers: {'Content-Type': 'application/json'},
+            method: 'POST', headers: headers,
             body: JSON.stringify({ card_number: currentCardNumber, old_password: oldP, new_password: newP })
         });
         const ret = await res.json();
+        if (res.status === 401) {
+            showMessage('登录已过期，请重新登录', 'error');
+            sessionStorage.clear();
+            setTimeout(() => window.location.href = '/', 1200);
+            return;
+        }
 
         if (ret.status === 'success') {
             showMessage('资料修改成功', 'success');
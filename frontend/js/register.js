@@ -1,5 +1,6 @@
 // 全局变量
 let isCardAvailable = false;
+let allocatedCard = ''; // 服务端分配的卡号，开户失败时清掉，下次提交重新分配
 
 // 页面加载初始化
 document.addEventListener('DOMContentLoaded', function() {
@@ -13,6 +14,29 @@ document.addEventListener('DOMContentLoaded', function() {
     document.getElementById('confirm_password').addEventListener('input', checkPasswordMatch);
 });
 
+// 向服务端申请一个可用卡号，提交时卡号留空才调用；成功返回 true
+async function allocateCardNumber() {
+    const cardInput = document.getElementById('card_number');
+
+    try {
+        const response = await fetch('/api/card/allocate', { method: 'POST' });
+        const data = await response.json();
+
+        if (data.status === 'success') {
+            cardInput.value = data.card_number;
+            allocatedCard = data.card_number;
+            isCardAvailable = true;
+            document.getElementById('cardAvailability').innerHTML = '<span class="available">✅ 系统已分配卡号</span>';
+            return true;
+        }
+        showMessage('分配卡号失败: ' + data.message, 'error');
+    } catch (error) {
+        console.error('分配卡号错误:', error);
+        showMessage('网络错误，请重试', 'error');
+    }
+    return false;
+}
+
 // 检查卡号可用性
 async function checkCardAvailability() {
     const cardNumber = document.getElementById('card_number').value.trim();
@@ -78,6 +102,11 @@ function checkPasswordMatch() {
 async function handleRegister(event) {
     event.preventDefault();
 
+    // 卡号留空时先由服务端分配
+    if (!document.getElementById('card_number').value.trim() && !(await allocateCardNumber())) {
+        return;
+    }
+
     // 获取表单数据
     const formData = {
         name: document.getElementById('name').value.trim(),
@@ -172,6 +201,11 @@ async function submitRegistration(formData) {
             }, 3000);
         } else {
             showMessage('开户失败: ' + result.message, 'error');
+            const cardInput = document.getElementById('card_number');
+            if (allocatedCard && cardInput.value.trim() === allocatedCard) {
+                cardInput.value = '';
+                allocatedCard = '';
+            }
         }
     } catch (error) {
         console.error('注册错误:', error);